@@ -27,42 +27,220 @@
 # include "openssl/ec.h"
 # include "openssl/bn.h"
 
+# include <stddef.h>
+# include <stdint.h>
+
 # ifdef  __cplusplus
 extern "C" {
 # endif
 
+/** Number of 64-bit digits in a prime field element. */
+# define FP_DIGS		4
+
+/** The curve parameter |x| = 2^62 + 2^55 + 1, with x < 0. */
+# define X_ABS			0x4080000000000001ULL
+
+/** Most nonzero exponent bits handled with compressed squarings. */
+# define EXP_PCK		16
+
+/** Longest batch inversion whose prefix products are kept on the stack. */
+# define INV_STACK		16
+
+/** Number of bits in the prime group order r. */
+# define ORD_BITS		254
+
+/** Widest Pippenger window, keeping 2^(MSM_WIN - 1) buckets per thread. */
+# define MSM_WIN		15
+
+/** Window width of the fixed-base generator tables, at most 7. */
+# define GEN_WIN		7
+
+/*
+ * Windows, each with its own table, per part of k in a fixed-base
+ * multiplication: G1 splits k in two parts below 2^128 and G2 in four
+ * parts below 2^66.
+ */
+# define G1_GEN_DIGS	((128 + GEN_WIN) / GEN_WIN)
+# define G2_GEN_DIGS	((66 + GEN_WIN) / GEN_WIN)
+
+/** Odd multiples 1, 3, ..., 2^GEN_WIN - 1 kept for each window. */
+# define GEN_TAB		(1 << (GEN_WIN - 1))
+
+/** Room for the w-NAF of a GLV or GLS subscalar, which stays below 2^127. */
+# define GLV_DIGS		129
+
+/** Maximum number of signed digits in the Miller-loop parameter. */
+# define PAR_DIGS		68
+
+/** Prime field element stored in Montgomery form with a fixed number of digits. */
+typedef struct _FP {
+	uint64_t f[FP_DIGS];
+} FP;
+
+/** Double-precision prime field element, used to delay modular reduction. */
+typedef struct _DV {
+	uint64_t f[2 * FP_DIGS];
+} DV;
+
 typedef struct _FP2 {
-	BIGNUM f[2];
+	FP f[2];
 } FP2;
 
+typedef struct _DV2 {
+	DV f[2];
+} DV2;
+
 typedef struct _FP6 {
 	FP2 f[3];
 } FP6;
 
+typedef struct _DV6 {
+	DV2 f[3];
+} DV6;
+
 typedef struct _FP12 {
 	FP6 f[2];
 } FP12;
 
+/** Point on the twist E'(Fp2) in Jacobian coordinates, at infinity if z = 0. */
+typedef struct _G2_POINT {
+	FP2 x;
+	FP2 y;
+	FP2 z;
+} G2_POINT;
+
 /** Stores information regarding the groups involved in pairing computation. */
 struct pairing_group_st {
 	EC_GROUP *ec;
-	BN_MONT_CTX *mont;
-	BN_CTX *bn;
 	BIGNUM *field;
-	BIGNUM *one;
+	FP one;
 	FP2 *g2x;
 	FP2 *g2y;
+	/** Frobenius constants xi^(k(p^j - 1)/6) in row j - 1, column k - 1. */
+	FP2 frb[3][5];
+	/** Miller-loop parameter |6x + 2| in signed digits, most significant first. */
+	signed char par[PAR_DIGS];
+	/** Number of digits in par. */
+	int par_len;
+	/** Cube root of unity with (x, y) -> (beta * x, y) acting as lambda on G1. */
+	FP beta;
+	/** Affine (x, y) of (2e + 1) * 2^(GEN_WIN * j) * g1 at entry GEN_TAB * j + e. */
+	FP (*g1_tab)[2];
+	/** The same for the G2 generator. */
+	FP2 (*g2_tab)[2];
+	/** Pairing of the generators, e(g1, g2). */
+	FP12 gt;
 };
 
 /** Convenient type to manipulate pairing groups. */
 typedef struct pairing_group_st PAIRING_GROUP;
 
+/** Miller-loop line coefficients precomputed for a fixed G2 argument. */
+typedef struct _G2_PRE {
+	/** Three coefficients per line, in the order the Miller loop uses them. */
+	FP2 *l;
+	/** Number of lines stored. */
+	int n;
+} G2_PRE;
+
+/** Curve constants, set up by op_init() and only read afterwards. */
 extern PAIRING_GROUP group;
 
 int op_init(void);
 void op_free(void);
 
+/*
+ * Scalar decomposition for the curve endomorphisms: op_decomp splits k over
+ * an m-dimensional lattice given as polynomials in x, into odd parts if odd
+ * is set, and op_naf writes the width-w NAF of |e|, least significant digit
+ * first, returning its length (or -1 if e does not fit in GLV_DIGS - 2 bits).
+ */
+int op_decomp(const PAIRING_GROUP *group, BIGNUM **e, const BIGNUM *k, const int (*basis)[4], const int (*dual)[4], int m, int odd, BN_CTX *ctx);
+int op_naf(signed char *naf, const BIGNUM *e, int w);
+
+/** Lattice for lambda = p mod r, shared by G2_mul_gls and GT_exp. */
+extern const int op_gls_basis[16][4];
+extern const int op_gls_dual[4][4];
+
+/*
+ * Pippenger helpers: op_msm_read stores k mod n in FP_DIGS words, op_msm_win
+ * picks the window width for n points, and op_msm_dig returns the signed
+ * digit of window w, in [-2^(c - 1), 2^(c - 1)], out of (ORD_BITS + c) / c.
+ */
+int op_msm_read(uint64_t *s, const BIGNUM *k, const BIGNUM *n, BN_CTX *ctx);
+int op_msm_win(size_t n);
+int op_msm_dig(const uint64_t *s, int w, int c);
+
+/*
+ * Bucket schedule shared by G1_msm and G2_msm. Each round queues at most one
+ * affine addition per bucket through put, so that flush completes the round
+ * under a single batched inversion; a point whose bucket is busy waits for a
+ * later round. Points are named by index, with neg set for a negative digit.
+ */
+typedef struct {
+	/* Queues bucket b += +-p[i] in slot k and returns 1, or 0 if nothing was queued. */
+	int (*put)(void *arg, int b, size_t i, int neg, int k);
+	/* Completes the k additions queued for buckets idx[0], ..., idx[k - 1]. */
+	int (*flush)(void *arg, const int *idx, int k);
+	void *arg;
+	int *stamp;
+	int round;
+	int *idx;
+	int *dbk;
+	size_t *dpt;
+} OP_MSM;
+
+int op_msm_init(OP_MSM *m, int nb, int batch);
+void op_msm_free(OP_MSM *m);
+int op_msm_fill(OP_MSM *m, const uint64_t *s, size_t n, int w, int c, int lim);
+
+/*
+ * Splits k into odd parts with op_decomp and recodes part i into len odd
+ * signed digits of GEN_WIN bits at dig[i * len], least significant first,
+ * with the same running time for every part. Fails if a part does not fit.
+ */
+int op_gen_rec(const PAIRING_GROUP *group, signed char *dig, const BIGNUM *k, const int (*basis)[4], const int (*dual)[4], int m, int len, BN_CTX *ctx);
+
 unsigned long long ARCH_cycles(void);
+void ARCH_cpu_name(char *name, int len);
+int ARCH_has_adx(void);
+void ARCH_fp_mul_adx(uint64_t *c, const uint64_t *a, const uint64_t *b);
+void ARCH_fp_sqr_adx(uint64_t *c, const uint64_t *a);
+void ARCH_fp_muln_adx(uint64_t *c, const uint64_t *a, const uint64_t *b);
+void ARCH_fp_rdcn_adx(uint64_t *c, const uint64_t *a);
+void ARCH_dv_add(uint64_t *c, const uint64_t *a, const uint64_t *b);
+void ARCH_dv_sub(uint64_t *c, const uint64_t *a, const uint64_t *b);
+
+void FP_select(int adx);
+
+void FP_copy(FP *r, const FP *a);
+/** Copies a into r if c is nonzero, in constant time. */
+void FP_copy_sec(FP *r, const FP *a, int c);
+void FP_zero(FP *a);
+int FP_is_zero(const FP *a);
+int FP_cmp(const FP *a, const FP *b);
+int FP_rand(FP *a);
+void FP_print(const FP *a);
+int FP_read_bn(FP *r, const BIGNUM *a);
+int FP_write_bn(BIGNUM *r, const FP *a);
+void FP_add(FP *r, const FP *a, const FP *b);
+void FP_sub(FP *r, const FP *a, const FP *b);
+void FP_neg(FP *r, const FP *a);
+void FP_dbl(FP *r, const FP *a);
+void FP_hlv(FP *r, const FP *a);
+void FP_mul(FP *r, const FP *a, const FP *b);
+void FP_sqr(FP *r, const FP *a);
+void FP_mul_unr(DV *r, const FP *a, const FP *b);
+void FP_sqr_unr(DV *r, const FP *a);
+void FP_rdc(FP *r, const DV *a);
+int FP_inv(FP *r, const FP *a);
+int FP_inv_batch(FP *r, const FP *a, int n);
+int FP_inv_batch_buf(FP *r, const FP *a, int n, FP *p);
+
+void DV_copy(DV *r, const DV *a);
+void DV_zero(DV *a);
+void DV_add(DV *r, const DV *a, const DV *b);
+void DV_sub(DV *r, const DV *a, const DV *b);
 
 void FP2_init(FP2 *a);
 void FP2_free(FP2 *a);
@@ -75,18 +253,26 @@ int FP2_is_zero(const FP2 *a);
 int FP2_add(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b);
 int FP2_sub(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b);
 int FP2_neg(const PAIRING_GROUP *group, FP2 *r, const FP2 *a);
-int FP2_mul(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b, BN_CTX *ctx);
-int FP2_mul_frb(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, int i, BN_CTX *ctx);
-int FP2_mul_art(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx);
-int FP2_mul_nor(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx);
-int FP2_sqr(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx);
-int FP2_inv(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx);
+int FP2_hlv(const PAIRING_GROUP *group, FP2 *r, const FP2 *a);
+int FP2_mul(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b);
+int FP2_mul_frb(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, int i);
+int FP2_mul_art(const PAIRING_GROUP *group, FP2 *r, const FP2 *a);
+int FP2_mul_nor(const PAIRING_GROUP *group, FP2 *r, const FP2 *a);
+int FP2_sqr(const PAIRING_GROUP *group, FP2 *r, const FP2 *a);
+int FP2_inv(const PAIRING_GROUP *group, FP2 *r, const FP2 *a);
 int FP2_inv_uni(const PAIRING_GROUP *group, FP2 *r, const FP2 *a);
-int FP2_conv_uni(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx);
-int FP2_inv_sim(const PAIRING_GROUP *group, FP2 *r, FP2 *s, const FP2 *a, const FP2 *b, BN_CTX *ctx);
-int FP2_mul_unr(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b, BN_CTX *ctx);
-int FP2_rdc(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx);
-int FP2_mul2(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b, BN_CTX *ctx);
+int FP2_conv_uni(const PAIRING_GROUP *group, FP2 *r, const FP2 *a);
+int FP2_inv_sim(const PAIRING_GROUP *group, FP2 *r, FP2 *s, const FP2 *a, const FP2 *b);
+int FP2_inv_batch(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, int n);
+int FP2_inv_batch_buf(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, int n, FP2 *p);
+int FP2_mul_unr(const PAIRING_GROUP *group, DV2 *r, const FP2 *a, const FP2 *b);
+int FP2_sqr_unr(const PAIRING_GROUP *group, DV2 *r, const FP2 *a);
+int FP2_rdc(const PAIRING_GROUP *group, FP2 *r, const DV2 *a);
+int FP2_mul2(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b);
+
+void DV2_add(DV2 *r, const DV2 *a, const DV2 *b);
+void DV2_sub(DV2 *r, const DV2 *a, const DV2 *b);
+void DV2_mul_nor(DV2 *r, const DV2 *a);
 
 void FP6_init(FP6 *a);
 void FP6_free(FP6 *a);
@@ -99,14 +285,22 @@ int FP6_is_zero(const FP6 *a);
 int FP6_add(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b);
 int FP6_sub(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b);
 int FP6_neg(const PAIRING_GROUP *group, FP6 *r, const FP6 *a);
-int FP6_mul_unr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_CTX *ctx);
-int FP6_rdc(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx);
-int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_CTX *ctx);
-int FP6_mul_dxs(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_CTX *ctx);
-int FP6_mul_art(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx);
-int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx);
-int FP6_sqr2(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx);
-int FP6_inv(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx);
+int FP6_mul_unr(const PAIRING_GROUP *group, DV6 *r, const FP6 *a, const FP6 *b);
+int FP6_mul_dxs_unr(const PAIRING_GROUP *group, DV6 *r, const FP6 *a, const FP6 *b);
+int FP6_sqr_unr(const PAIRING_GROUP *group, DV6 *r, const FP6 *a);
+int FP6_rdc(const PAIRING_GROUP *group, FP6 *r, const DV6 *a);
+int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b);
+int FP6_mul_dxs(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b);
+int FP6_mul_art(const PAIRING_GROUP *group, FP6 *r, const FP6 *a);
+int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a);
+int FP6_sqr2(const PAIRING_GROUP *group, FP6 *r, const FP6 *a);
+/** Sets r to the adjugate of a and t to its norm to Fp2, so that a^-1 = r / t. */
+int FP6_inv_adj(const PAIRING_GROUP *group, FP6 *r, FP2 *t, const FP6 *a);
+int FP6_inv(const PAIRING_GROUP *group, FP6 *r, const FP6 *a);
+
+void DV6_add(DV6 *r, const DV6 *a, const DV6 *b);
+void DV6_sub(DV6 *r, const DV6 *a, const DV6 *b);
+void DV6_mul_art(DV6 *r, const DV6 *a);
 
 void FP12_init(FP12 *a);
 void FP12_free(FP12 *a);
@@ -120,18 +314,122 @@ int FP12_is_zero(const FP12 *a);
 int FP12_add(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b);
 int FP12_sub(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b);
 int FP12_neg(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
-int FP12_mul(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b, BN_CTX *ctx);
-int FP12_mul_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b, BN_CTX *ctx);
-int FP12_sqr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx);
-int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx);
-int FP12_inv(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx);
-int FP12_inv_uni(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx);
-int FP12_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx);
-int FP12_back(const PAIRING_GROUP *group, FP12 *r, FP12 *s, const FP12 *a, const FP12 *b, BN_CTX *ctx);
-int FP12_frb(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx);
-int FP12_exp_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx);
-
-int op_map(FP12 *r, const EC_POINT *g, const FP2 *x, const FP2 *y);
+int FP12_mul(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b);
+int FP12_mul_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b);
+int FP12_sqr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_mul_lzr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b);
+int FP12_mul_dxs_lzr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b);
+int FP12_sqr_lzr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_mul_dxs_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b);
+int FP12_mul_dxd_lzr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b);
+int FP12_sqr_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_inv(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_inv_uni(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_inv_batch(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, int n);
+int FP12_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_back(const PAIRING_GROUP *group, FP12 *r, FP12 *s, const FP12 *a, const FP12 *b);
+int FP12_back_sim(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, int n);
+int FP12_frb(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_frb2(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_frb3(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_exp_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a);
+int FP12_exp_cyc_gen(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const BIGNUM *e);
+
+int G1_mul_glv(const PAIRING_GROUP *group, EC_POINT *r, const EC_POINT *a, const BIGNUM *k, BN_CTX *ctx);
+/*
+ * Multi-scalar multiplication r = k[0] * p[0] + ... + k[n - 1] * p[n - 1] by
+ * Pippenger's bucket method, with windows spread over the given number of
+ * threads (all online CPUs when threads <= 0).
+ */
+int G1_msm(const PAIRING_GROUP *group, EC_POINT *r, const EC_POINT **p, const BIGNUM **k,
+		size_t n, int threads, BN_CTX *ctx);
+
+/*
+ * Fixed-base multiplication of the generators through the tables built by
+ * G1_gen_table and G2_gen_table, which op_init calls. k is split into odd
+ * parts as in G1_mul_glv and G2_mul_gls, so the tables only cover the bits
+ * of one part and the endomorphism is applied to the running sum instead.
+ * Lookups scan the whole window, so neither the memory accesses nor the
+ * formulas depend on k.
+ */
+int G1_gen_table(PAIRING_GROUP *group, BN_CTX *ctx);
+int G1_mul_gen(const PAIRING_GROUP *group, EC_POINT *r, const BIGNUM *k, BN_CTX *ctx);
+
+void G2_init(G2_POINT *p);
+void G2_free(G2_POINT *p);
+void G2_copy(G2_POINT *r, const G2_POINT *a);
+void G2_set_infty(G2_POINT *p);
+int G2_is_infty(const G2_POINT *p);
+int G2_set_affine(const PAIRING_GROUP *group, G2_POINT *p, const FP2 *x, const FP2 *y);
+int G2_get_affine(const PAIRING_GROUP *group, FP2 *x, FP2 *y, const G2_POINT *p);
+int G2_get_gen(const PAIRING_GROUP *group, G2_POINT *p);
+int G2_rand(const PAIRING_GROUP *group, G2_POINT *p, BN_CTX *ctx);
+int G2_cmp(const PAIRING_GROUP *group, const G2_POINT *a, const G2_POINT *b);
+int G2_is_on_curve(const PAIRING_GROUP *group, const G2_POINT *p);
+/** Checks that p is on the twist and has order r, for input that is not trusted. */
+int G2_is_in_group(const PAIRING_GROUP *group, const G2_POINT *p);
+int G2_neg(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a);
+int G2_dbl(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a);
+int G2_add(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const G2_POINT *b);
+int G2_sub(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const G2_POINT *b);
+int G2_norm(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a);
+int G2_norm_sim(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, int n);
+int G2_frb(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a);
+int G2_mul(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const BIGNUM *k);
+/*
+ * G2_mul_gls splits k through psi, which acts as multiplication by p only on
+ * the order-r subgroup, and G2_msm reduces k modulo r, so both give wrong
+ * results for other points of the twist. Check untrusted points with
+ * G2_is_in_group first.
+ */
+int G2_mul_gls(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const BIGNUM *k, BN_CTX *ctx);
+int G2_msm(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *p, const BIGNUM **k,
+		size_t n, int threads, BN_CTX *ctx);
+int G2_gen_table(PAIRING_GROUP *group);
+int G2_mul_gen(const PAIRING_GROUP *group, G2_POINT *r, const BIGNUM *k, BN_CTX *ctx);
+
+/*
+ * The pairing of the generators, which op_init computes once, and its
+ * powers. GT_exp_gen goes through GT_exp on the cached value.
+ */
+int GT_get_gen(const PAIRING_GROUP *group, FP12 *r);
+int GT_exp_gen(const PAIRING_GROUP *group, FP12 *r, const BIGNUM *k, BN_CTX *ctx);
+/** Raises a in GT to k, splitting k in base p over the Frobenius. */
+int GT_exp(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const BIGNUM *k, BN_CTX *ctx);
+
+/*
+ * The pairing functions only read the global group, so they may run
+ * concurrently as long as each thread passes its own BN_CTX (or NULL to
+ * have a temporary one allocated per call).
+ */
+int op_map(FP12 *r, const EC_POINT *g, const FP2 *x, const FP2 *y, BN_CTX *ctx);
+int op_map_sim(FP12 *r, const EC_POINT **g, const FP2 **x, const FP2 **y, int n, BN_CTX *ctx);
+void G2_PRE_init(G2_PRE *t);
+void G2_PRE_free(G2_PRE *t);
+int op_precompute_g2(G2_PRE *t, const FP2 *x, const FP2 *y);
+int op_map_pre(FP12 *r, const EC_POINT *g, const G2_PRE *t, BN_CTX *ctx);
+
+/** Final exponentiation, split into the easy and hard parts for benchmarking. */
+int op_exp_easy(FP12 *r, const FP12 *a);
+int op_exp_hard(FP12 *r, const FP12 *a);
+
+/*
+ * Computes out[k] = e(g[k], (x[k], y[k])) for k < n on a pool of worker
+ * threads (all online CPUs when threads <= 0). With OpenSSL 1.0 the caller
+ * must have installed the CRYPTO locking callbacks.
+ */
+int op_map_batch(FP12 *out, const EC_POINT **g, const FP2 **x, const FP2 **y, size_t n, int threads);
+
+/** Number of online CPUs, at least one. */
+int op_cpus(void);
+
+/*
+ * Runs fn on arg, arg + size, ..., arg + (jobs - 1) * size, one thread per
+ * job with the calling thread taking the first. Jobs whose thread cannot be
+ * started run on the calling thread afterwards.
+ */
+void op_parallel(void *(*fn)(void *), void *arg, size_t size, int jobs);
 
 #ifdef  __cplusplus
 }
@@ -28,23 +28,670 @@
  * @ingroup arch
  */
 
+#include <stdint.h>
+
 /**
  * Renames the inline assembly macro to a prettier name.
  */
 #define asm					__asm__ volatile
 
+/*============================================================================*/
+/* Private definitions                                                        */
+/*============================================================================*/
+
+/**
+ * The 254-bit prime modulus, followed by -p^{-1} mod 2^64.
+ */
+static const uint64_t mont[5] = {
+	0xA700000000000013ULL, 0x6121000000000013ULL,
+	0xBA344D8000000008ULL, 0x2523648240000001ULL,
+	0x08435E50D79435E5ULL
+};
+
+/**
+ * Flag telling if the processor supports RDTSCP, or -1 if not checked yet.
+ */
+static int tscp = -1;
+
 /*============================================================================*/
 /* Public definitions                                                         */
 /*============================================================================*/
 
 unsigned long long ARCH_cycles(void) {
-	unsigned int hi, lo;
+	unsigned int hi, lo, a, b, c, d;
+
+	if (tscp < 0) {
+		asm ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0x80000000), "c" (0));
+		tscp = 0;
+		if (a >= 0x80000001) {
+			asm ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0x80000001), "c" (0));
+			tscp = (d >> 27) & 1;
+		}
+	}
+
+	/*
+	 * RDTSCP waits for all earlier instructions before reading the counter
+	 * and the fence stops later ones from starting, without the cost of a
+	 * serializing CPUID (which traps under most hypervisors).
+	 */
+	if (tscp) {
+		asm ("rdtscp\n\tlfence" : "=a" (lo), "=d" (hi) : : "%rcx");
+	} else {
+		asm ("lfence\n\trdtsc\n\tlfence" : "=a" (lo), "=d" (hi));
+	}
+	return ((unsigned long long) lo) | (((unsigned long long) hi) << 32);
+}
+
+void ARCH_cpu_name(char *name, int len) {
+	unsigned int r[12], a, b, c, d;
+	char *s = (char *)r;
+	int i, j;
+
+	name[0] = '\0';
+	asm ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0x80000000), "c" (0));
+	if (a < 0x80000004 || len <= 0) {
+		return;
+	}
+	/* The brand string is spread over three leaves, 16 bytes each. */
+	for (i = 0; i < 3; i++) {
+		asm ("cpuid" : "=a" (r[4 * i]), "=b" (r[4 * i + 1]), "=c" (r[4 * i + 2]),
+				"=d" (r[4 * i + 3]) : "a" (0x80000002 + i), "c" (0));
+	}
+	for (i = 0; i < 48 && s[i] == ' '; i++);
+	for (j = 0; j < len - 1 && i < 48 && s[i] != '\0'; i++) {
+		name[j++] = (s[i] == '"' ? '\'' : s[i]);
+	}
+	name[j] = '\0';
+}
+
+int ARCH_has_adx(void) {
+	unsigned int a, b, c, d;
+
+	/* Check that leaf 7 exists before querying it. */
+	asm ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0), "c" (0));
+	if (a < 7) {
+		return 0;
+	}
+	asm ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (7), "c" (0));
+	/* BMI2 provides MULX, ADX provides ADCX/ADOX. */
+	return ((b >> 8) & 1) && ((b >> 19) & 1);
+}
+
+/*
+ * Montgomery multiplication interleaving one row of the product with one
+ * reduction step. ADCX and ADOX drive two independent carry chains, so the
+ * low and high halves of each MULX are accumulated without serializing on
+ * a single carry flag. Since p < 2^254, five accumulator digits suffice and
+ * the result is below 2p before the final subtraction.
+ */
+void ARCH_fp_mul_adx(uint64_t *c, const uint64_t *a, const uint64_t *b) {
 	asm (
-		"cpuid\n\t"/*serialize*/
-		"rdtsc\n\t"/*read the clock*/
-		"mov %%edx, %0\n\t"
-		"mov %%eax, %1\n\t" 
-		: "=r" (hi), "=r" (lo):: "%rax", "%rbx", "%rcx", "%rdx"
+		"movq 0(%%rcx), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 0(%%rsi), %%r8, %%r9\n\t"
+		"mulxq 8(%%rsi), %%rbx, %%r10\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r11\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r12\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adcxq %%rax, %%r12\n\t"
+		"movq %%r8, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p3], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"adcxq %%rax, %%r12\n\t"
+		"movq 8(%%rcx), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 0(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"mulxq 8(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r8\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%rax, %%r8\n\t"
+		"adcxq %%rax, %%r8\n\t"
+		"movq %%r9, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq %[p3], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"adcxq %%rax, %%r8\n\t"
+		"movq 16(%%rcx), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 0(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq 8(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r9\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%rax, %%r9\n\t"
+		"adcxq %%rax, %%r9\n\t"
+		"movq %%r10, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq %[p3], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"adcxq %%rax, %%r9\n\t"
+		"movq 24(%%rcx), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 0(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq 8(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r10\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%rax, %%r10\n\t"
+		"adcxq %%rax, %%r10\n\t"
+		"movq %%r11, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"mulxq %[p3], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"adcxq %%rax, %%r10\n\t"
+		"movq %%r12, %%r13\n\t"
+		"movq %%r8, %%r15\n\t"
+		"movq %%r9, %%rbx\n\t"
+		"movq %%r10, %%rdx\n\t"
+		"subq %[p0], %%r13\n\t"
+		"sbbq %[p1], %%r15\n\t"
+		"sbbq %[p2], %%rbx\n\t"
+		"sbbq %[p3], %%rdx\n\t"
+		"cmovcq %%r12, %%r13\n\t"
+		"cmovcq %%r8, %%r15\n\t"
+		"cmovcq %%r9, %%rbx\n\t"
+		"cmovcq %%r10, %%rdx\n\t"
+		"movq %%r13, 0(%%rdi)\n\t"
+		"movq %%r15, 8(%%rdi)\n\t"
+		"movq %%rbx, 16(%%rdi)\n\t"
+		"movq %%rdx, 24(%%rdi)\n\t"
+		:
+		: "D" (c), "S" (a), "c" (b), [p0] "m" (mont[0]), [p1] "m" (mont[1]),
+		  [p2] "m" (mont[2]), [p3] "m" (mont[3]), [u] "m" (mont[4])
+		: "rax", "rbx", "rdx", "r8", "r9", "r10", "r11", "r12", "r13", "r14",
+		  "r15", "cc", "memory"
+	);
+}
+
+/*
+ * Montgomery squaring computing the six cross products once, doubling them
+ * and adding the diagonal, followed by a separate reduction of the lower half.
+ */
+void ARCH_fp_sqr_adx(uint64_t *c, const uint64_t *a) {
+	asm (
+		"movq 0(%%rsi), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 8(%%rsi), %%r9, %%r10\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r11\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r12\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adcxq %%rax, %%r12\n\t"
+		"movq 8(%%rsi), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r13\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%rax, %%r13\n\t"
+		"adcxq %%rax, %%r13\n\t"
+		"movq 16(%%rsi), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r15\n\t"
+		"adcxq %%rbx, %%r13\n\t"
+		"adcxq %%rax, %%r15\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"movq %%rax, %%rcx\n\t"
+		"adcxq %%r9, %%r9\n\t"
+		"adcxq %%r10, %%r10\n\t"
+		"adcxq %%r11, %%r11\n\t"
+		"adcxq %%r12, %%r12\n\t"
+		"adcxq %%r13, %%r13\n\t"
+		"adcxq %%r15, %%r15\n\t"
+		"adcxq %%rax, %%rcx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"movq 0(%%rsi), %%rdx\n\t"
+		"mulxq %%rdx, %%r8, %%r14\n\t"
+		"adcxq %%r14, %%r9\n\t"
+		"movq 8(%%rsi), %%rdx\n\t"
+		"mulxq %%rdx, %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adcxq %%r14, %%r11\n\t"
+		"movq 16(%%rsi), %%rdx\n\t"
+		"mulxq %%rdx, %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adcxq %%r14, %%r13\n\t"
+		"movq 24(%%rsi), %%rdx\n\t"
+		"mulxq %%rdx, %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r15\n\t"
+		"adcxq %%r14, %%rcx\n\t"
+		"movq %%r8, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p3], %%rbx, %%rsi\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%rax, %%rsi\n\t"
+		"adcxq %%rax, %%rsi\n\t"
+		"movq %%r9, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%rsi\n\t"
+		"mulxq %[p3], %%rbx, %%r8\n\t"
+		"adcxq %%rbx, %%rsi\n\t"
+		"adoxq %%rax, %%r8\n\t"
+		"adcxq %%rax, %%r8\n\t"
+		"movq %%r10, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%rsi\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%rsi\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq %[p3], %%rbx, %%r9\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%rax, %%r9\n\t"
+		"adcxq %%rax, %%r9\n\t"
+		"movq %%r11, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%rsi\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%rsi\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"mulxq %[p3], %%rbx, %%r10\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%rax, %%r10\n\t"
+		"adcxq %%rax, %%r10\n\t"
+		"addq %%r12, %%rsi\n\t"
+		"adcq %%r13, %%r8\n\t"
+		"adcq %%r15, %%r9\n\t"
+		"adcq %%rcx, %%r10\n\t"
+		"movq %%rsi, %%r13\n\t"
+		"movq %%r8, %%r15\n\t"
+		"movq %%r9, %%rbx\n\t"
+		"movq %%r10, %%rdx\n\t"
+		"subq %[p0], %%r13\n\t"
+		"sbbq %[p1], %%r15\n\t"
+		"sbbq %[p2], %%rbx\n\t"
+		"sbbq %[p3], %%rdx\n\t"
+		"cmovcq %%rsi, %%r13\n\t"
+		"cmovcq %%r8, %%r15\n\t"
+		"cmovcq %%r9, %%rbx\n\t"
+		"cmovcq %%r10, %%rdx\n\t"
+		"movq %%r13, 0(%%rdi)\n\t"
+		"movq %%r15, 8(%%rdi)\n\t"
+		"movq %%rbx, 16(%%rdi)\n\t"
+		"movq %%rdx, 24(%%rdi)\n\t"
+		: "+S" (a)
+		: "D" (c), [p0] "m" (mont[0]), [p1] "m" (mont[1]),
+		  [p2] "m" (mont[2]), [p3] "m" (mont[3]), [u] "m" (mont[4])
+		: "rax", "rbx", "rcx", "rdx", "r8", "r9", "r10", "r11", "r12", "r13",
+		  "r14", "r15", "cc", "memory"
+	);
+}
+
+/*
+ * Schoolbook product of two field elements without reduction, used by the
+ * lazy-reduction extension field arithmetic. The eight output digits are
+ * stored row by row as soon as they are final.
+ */
+void ARCH_fp_muln_adx(uint64_t *c, const uint64_t *a, const uint64_t *b) {
+	asm (
+		"movq 0(%%rcx), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 0(%%rsi), %%r8, %%r9\n\t"
+		"mulxq 8(%%rsi), %%rbx, %%r10\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r11\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r12\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adcxq %%rax, %%r12\n\t"
+		"movq %%r8, 0(%%rdi)\n\t"
+		"movq 8(%%rcx), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 0(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"mulxq 8(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r8\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%rax, %%r8\n\t"
+		"adcxq %%rax, %%r8\n\t"
+		"movq %%r9, 8(%%rdi)\n\t"
+		"movq 16(%%rcx), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 0(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq 8(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r9\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%rax, %%r9\n\t"
+		"adcxq %%rax, %%r9\n\t"
+		"movq %%r10, 16(%%rdi)\n\t"
+		"movq 24(%%rcx), %%rdx\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq 0(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq 8(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq 16(%%rsi), %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"mulxq 24(%%rsi), %%rbx, %%r10\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%rax, %%r10\n\t"
+		"adcxq %%rax, %%r10\n\t"
+		"movq %%r11, 24(%%rdi)\n\t"
+		"movq %%r12, 32(%%rdi)\n\t"
+		"movq %%r8, 40(%%rdi)\n\t"
+		"movq %%r9, 48(%%rdi)\n\t"
+		"movq %%r10, 56(%%rdi)\n\t"
+		:
+		: "D" (c), "S" (a), "c" (b)
+		: "rax", "rbx", "rdx", "r8", "r9", "r10", "r11", "r12", "r14", "cc",
+		  "memory"
+	);
+}
+
+/*
+ * Montgomery reduction of a double-precision value below p * 2^256. Only the
+ * lower half enters the reduction steps; the upper half is below p and is
+ * added at the end, so a single conditional subtraction remains.
+ */
+void ARCH_fp_rdcn_adx(uint64_t *c, const uint64_t *a) {
+	asm (
+		"movq 0(%%rsi), %%r8\n\t"
+		"movq 8(%%rsi), %%r9\n\t"
+		"movq 16(%%rsi), %%r10\n\t"
+		"movq 24(%%rsi), %%r11\n\t"
+		"movq %%r8, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p3], %%rbx, %%r12\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%rax, %%r12\n\t"
+		"adcxq %%rax, %%r12\n\t"
+		"movq %%r9, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%r14, %%r10\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq %[p3], %%rbx, %%r8\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%rax, %%r8\n\t"
+		"adcxq %%rax, %%r8\n\t"
+		"movq %%r10, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r10\n\t"
+		"adoxq %%r14, %%r11\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq %[p3], %%rbx, %%r9\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%rax, %%r9\n\t"
+		"adcxq %%rax, %%r9\n\t"
+		"movq %%r11, %%rdx\n\t"
+		"mulxq %[u], %%rdx, %%r14\n\t"
+		"xorl %%eax, %%eax\n\t"
+		"mulxq %[p0], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r11\n\t"
+		"adoxq %%r14, %%r12\n\t"
+		"mulxq %[p1], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r12\n\t"
+		"adoxq %%r14, %%r8\n\t"
+		"mulxq %[p2], %%rbx, %%r14\n\t"
+		"adcxq %%rbx, %%r8\n\t"
+		"adoxq %%r14, %%r9\n\t"
+		"mulxq %[p3], %%rbx, %%r10\n\t"
+		"adcxq %%rbx, %%r9\n\t"
+		"adoxq %%rax, %%r10\n\t"
+		"adcxq %%rax, %%r10\n\t"
+		"addq 32(%%rsi), %%r12\n\t"
+		"adcq 40(%%rsi), %%r8\n\t"
+		"adcq 48(%%rsi), %%r9\n\t"
+		"adcq 56(%%rsi), %%r10\n\t"
+		"movq %%r12, %%r13\n\t"
+		"movq %%r8, %%r15\n\t"
+		"movq %%r9, %%rbx\n\t"
+		"movq %%r10, %%rdx\n\t"
+		"subq %[p0], %%r13\n\t"
+		"sbbq %[p1], %%r15\n\t"
+		"sbbq %[p2], %%rbx\n\t"
+		"sbbq %[p3], %%rdx\n\t"
+		"cmovcq %%r12, %%r13\n\t"
+		"cmovcq %%r8, %%r15\n\t"
+		"cmovcq %%r9, %%rbx\n\t"
+		"cmovcq %%r10, %%rdx\n\t"
+		"movq %%r13, 0(%%rdi)\n\t"
+		"movq %%r15, 8(%%rdi)\n\t"
+		"movq %%rbx, 16(%%rdi)\n\t"
+		"movq %%rdx, 24(%%rdi)\n\t"
+		:
+		: "D" (c), "S" (a), [p0] "m" (mont[0]), [p1] "m" (mont[1]),
+		  [p2] "m" (mont[2]), [p3] "m" (mont[3]), [u] "m" (mont[4])
+		: "rax", "rbx", "rdx", "r8", "r9", "r10", "r11", "r12", "r13", "r14",
+		  "r15", "cc", "memory"
+	);
+}
+
+/*
+ * Addition of double-precision values modulo p * 2^256, as one add-with-carry
+ * chain over the eight digits followed by a conditional subtraction of p from
+ * the upper half. Only baseline instructions are used, so no CPU check is
+ * needed; c may alias a or b.
+ */
+void ARCH_dv_add(uint64_t *c, const uint64_t *a, const uint64_t *b) {
+	asm (
+		"movq 0(%%rsi), %%r8\n\t"
+		"addq 0(%%rcx), %%r8\n\t"
+		"movq %%r8, 0(%%rdi)\n\t"
+		"movq 8(%%rsi), %%r8\n\t"
+		"adcq 8(%%rcx), %%r8\n\t"
+		"movq %%r8, 8(%%rdi)\n\t"
+		"movq 16(%%rsi), %%r8\n\t"
+		"adcq 16(%%rcx), %%r8\n\t"
+		"movq %%r8, 16(%%rdi)\n\t"
+		"movq 24(%%rsi), %%r8\n\t"
+		"adcq 24(%%rcx), %%r8\n\t"
+		"movq %%r8, 24(%%rdi)\n\t"
+		"movq 32(%%rsi), %%r8\n\t"
+		"adcq 32(%%rcx), %%r8\n\t"
+		"movq 40(%%rsi), %%r9\n\t"
+		"adcq 40(%%rcx), %%r9\n\t"
+		"movq 48(%%rsi), %%r10\n\t"
+		"adcq 48(%%rcx), %%r10\n\t"
+		"movq 56(%%rsi), %%r11\n\t"
+		"adcq 56(%%rcx), %%r11\n\t"
+		"movq %%r8, %%rax\n\t"
+		"movq %%r9, %%rbx\n\t"
+		"movq %%r10, %%rdx\n\t"
+		"movq %%r11, %%r12\n\t"
+		"subq %[p0], %%rax\n\t"
+		"sbbq %[p1], %%rbx\n\t"
+		"sbbq %[p2], %%rdx\n\t"
+		"sbbq %[p3], %%r12\n\t"
+		"cmovcq %%r8, %%rax\n\t"
+		"cmovcq %%r9, %%rbx\n\t"
+		"cmovcq %%r10, %%rdx\n\t"
+		"cmovcq %%r11, %%r12\n\t"
+		"movq %%rax, 32(%%rdi)\n\t"
+		"movq %%rbx, 40(%%rdi)\n\t"
+		"movq %%rdx, 48(%%rdi)\n\t"
+		"movq %%r12, 56(%%rdi)\n\t"
+		:
+		: "D" (c), "S" (a), "c" (b), [p0] "m" (mont[0]), [p1] "m" (mont[1]),
+		  [p2] "m" (mont[2]), [p3] "m" (mont[3])
+		: "rax", "rbx", "rdx", "r8", "r9", "r10", "r11", "r12", "cc", "memory"
+	);
+}
+
+/*
+ * Subtraction of double-precision values modulo p * 2^256, adding p to the
+ * upper half under a mask taken from the final borrow.
+ */
+void ARCH_dv_sub(uint64_t *c, const uint64_t *a, const uint64_t *b) {
+	asm (
+		"movq 0(%%rsi), %%r8\n\t"
+		"subq 0(%%rcx), %%r8\n\t"
+		"movq %%r8, 0(%%rdi)\n\t"
+		"movq 8(%%rsi), %%r8\n\t"
+		"sbbq 8(%%rcx), %%r8\n\t"
+		"movq %%r8, 8(%%rdi)\n\t"
+		"movq 16(%%rsi), %%r8\n\t"
+		"sbbq 16(%%rcx), %%r8\n\t"
+		"movq %%r8, 16(%%rdi)\n\t"
+		"movq 24(%%rsi), %%r8\n\t"
+		"sbbq 24(%%rcx), %%r8\n\t"
+		"movq %%r8, 24(%%rdi)\n\t"
+		"movq 32(%%rsi), %%r8\n\t"
+		"sbbq 32(%%rcx), %%r8\n\t"
+		"movq 40(%%rsi), %%r9\n\t"
+		"sbbq 40(%%rcx), %%r9\n\t"
+		"movq 48(%%rsi), %%r10\n\t"
+		"sbbq 48(%%rcx), %%r10\n\t"
+		"movq 56(%%rsi), %%r11\n\t"
+		"sbbq 56(%%rcx), %%r11\n\t"
+		"sbbq %%rax, %%rax\n\t"
+		"movq %[p0], %%rbx\n\t"
+		"movq %[p1], %%rdx\n\t"
+		"movq %[p2], %%r12\n\t"
+		"movq %[p3], %%r13\n\t"
+		"andq %%rax, %%rbx\n\t"
+		"andq %%rax, %%rdx\n\t"
+		"andq %%rax, %%r12\n\t"
+		"andq %%rax, %%r13\n\t"
+		"addq %%rbx, %%r8\n\t"
+		"adcq %%rdx, %%r9\n\t"
+		"adcq %%r12, %%r10\n\t"
+		"adcq %%r13, %%r11\n\t"
+		"movq %%r8, 32(%%rdi)\n\t"
+		"movq %%r9, 40(%%rdi)\n\t"
+		"movq %%r10, 48(%%rdi)\n\t"
+		"movq %%r11, 56(%%rdi)\n\t"
+		:
+		: "D" (c), "S" (a), "c" (b), [p0] "m" (mont[0]), [p1] "m" (mont[1]),
+		  [p2] "m" (mont[2]), [p3] "m" (mont[3])
+		: "rax", "rbx", "rdx", "r8", "r9", "r10", "r11", "r12", "r13", "cc",
+		  "memory"
 	);
-	return ((unsigned long long) lo) | (((unsigned long long) hi) << 32);
 }
@@ -0,0 +1,215 @@
+/*
+ * OpenPairing is an implementation of a bilinear pairing over OpenSSL
+ * Copyright (C) 2015 OpenPairing Authors
+ *
+ * This file is part of OpenPairing. OpenPairing is legal property of its
+ * developers, whose names are not listed here. Please refer to the COPYRIGHT
+ * file for contact information.
+ *
+ * OpenPairing is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OpenPairing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenPairing. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "op.h"
+
+/* Range of pending pairing indices owned by one worker. */
+typedef struct {
+	pthread_mutex_t lock;
+	size_t head;
+	size_t tail;
+} op_queue;
+
+/* State shared by all workers of a batch. */
+typedef struct {
+	FP12 *out;
+	const EC_POINT **g;
+	const FP2 **x;
+	const FP2 **y;
+	op_queue *q;
+	int threads;
+} op_batch;
+
+/* Arguments for a single worker. */
+typedef struct {
+	op_batch *b;
+	int id;
+	int ret;
+} op_worker;
+
+/* Takes the next index from the front of the worker's own queue. */
+static int op_pop(op_queue *q, size_t *k) {
+	int ok = 0;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->head < q->tail) {
+		*k = q->head++;
+		ok = 1;
+	}
+	pthread_mutex_unlock(&q->lock);
+	return ok;
+}
+
+/*
+ * Moves the back half of some other worker's queue into the (empty) queue of
+ * worker id. Returns zero once every queue has been found empty; work is never
+ * created, only moved, so nothing can show up afterwards that another worker
+ * would not finish.
+ */
+static int op_steal(op_batch *b, int id) {
+	op_queue *v, *q = &b->q[id];
+	size_t mid, tail;
+	int i;
+
+	for (i = 1; i < b->threads; i++) {
+		v = &b->q[(id + i) % b->threads];
+		pthread_mutex_lock(&v->lock);
+		if (v->head < v->tail) {
+			tail = v->tail;
+			mid = v->head + (v->tail - v->head) / 2;
+			v->tail = mid;
+			pthread_mutex_unlock(&v->lock);
+
+			pthread_mutex_lock(&q->lock);
+			q->head = mid;
+			q->tail = tail;
+			pthread_mutex_unlock(&q->lock);
+			return 1;
+		}
+		pthread_mutex_unlock(&v->lock);
+	}
+	return 0;
+}
+
+static void *op_work(void *arg) {
+	op_worker *w = (op_worker *)arg;
+	op_batch *b = w->b;
+	BN_CTX *ctx;
+	size_t k;
+
+	w->ret = 0;
+	ctx = BN_CTX_new();
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	w->ret = 1;
+	do {
+		while (op_pop(&b->q[w->id], &k)) {
+			if (!op_map(&b->out[k], b->g[k], b->x[k], b->y[k], ctx)) {
+				w->ret = 0;
+			}
+		}
+	} while (op_steal(b, w->id));
+
+	BN_CTX_free(ctx);
+	return NULL;
+}
+
+int op_map_batch(FP12 *out, const EC_POINT **g, const FP2 **x, const FP2 **y, size_t n, int threads) {
+	op_batch b;
+	op_worker *w = NULL;
+	pthread_t *tid = NULL;
+	int i, started = 0, ret = 0;
+
+	if (n == 0) {
+		return 1;
+	}
+	if (threads <= 0) {
+		threads = op_cpus();
+	}
+	if ((size_t)threads > n) {
+		threads = (int)n;
+	}
+
+	b.out = out;
+	b.g = g;
+	b.x = x;
+	b.y = y;
+	b.threads = threads;
+	b.q = OPENSSL_malloc(threads * sizeof(op_queue));
+	w = OPENSSL_malloc(threads * sizeof(op_worker));
+	tid = OPENSSL_malloc(threads * sizeof(pthread_t));
+	if (b.q == NULL || w == NULL || tid == NULL) {
+		goto err;
+	}
+
+	/* Start from an even split; stealing evens out whatever imbalance remains. */
+	for (i = 0; i < threads; i++) {
+		pthread_mutex_init(&b.q[i].lock, NULL);
+		b.q[i].head = n * i / threads;
+		b.q[i].tail = n * (i + 1) / threads;
+		w[i].b = &b;
+		w[i].id = i;
+		w[i].ret = 0;
+	}
+
+	/* The calling thread acts as worker 0. */
+	for (started = 1; started < threads; started++) {
+		if (pthread_create(&tid[started], NULL, op_work, &w[started]) != 0) {
+			break;
+		}
+	}
+	op_work(&w[0]);
+	for (i = 1; i < started; i++) {
+		pthread_join(tid[i], NULL);
+	}
+
+	/* Workers that failed to start leave their queues to be stolen. */
+	ret = 1;
+	for (i = 0; i < started; i++) {
+		ret &= w[i].ret;
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_mutex_destroy(&b.q[i].lock);
+	}
+
+err:
+	OPENSSL_free(b.q);
+	OPENSSL_free(w);
+	OPENSSL_free(tid);
+	return ret;
+}
+
+int op_cpus(void) {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0 ? (int)n : 1);
+}
+
+void op_parallel(void *(*fn)(void *), void *arg, size_t size, int jobs) {
+	pthread_t *tid = NULL;
+	int i, started = 1;
+
+	if (jobs > 1) {
+		tid = OPENSSL_malloc(jobs * sizeof(pthread_t));
+	}
+	if (tid != NULL) {
+		for (; started < jobs; started++) {
+			if (pthread_create(&tid[started], NULL, fn, (char *)arg + started * size) != 0) {
+				break;
+			}
+		}
+	}
+	fn(arg);
+	for (i = 1; i < started; i++) {
+		pthread_join(tid[i], NULL);
+	}
+	for (i = started; i < jobs; i++) {
+		fn((char *)arg + i * size);
+	}
+	OPENSSL_free(tid);
+}
@@ -20,10 +20,16 @@
  * along with OpenPairing. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
+#include <math.h>
+#include <sched.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "op.h"
+#include "op_bench.h"
 
 /*============================================================================*/
 /* Private definitions                                                        */
@@ -31,12 +37,221 @@
 
 static unsigned long long before, after, total;
 
+/**
+ * Timing of each sample of the current benchmark, in cycles.
+ */
+static unsigned long long samples[BENCH_SAMPLES];
+
+/**
+ * Number of samples recorded for the current benchmark.
+ */
+static int count;
+
+/**
+ * Cost of an empty measurement, subtracted from every sample.
+ */
+static unsigned long long overhead;
+
+/**
+ * Statistics of the last benchmark, per execution.
+ */
+static unsigned long long s_min, s_med, s_p90, s_p99;
+static double s_dev;
+
+/**
+ * Label and number of executions of the current benchmark.
+ */
+static const char *name = "";
+static int runs;
+
+/**
+ * Timer frequency in cycles per nanosecond, or zero if not calibrated.
+ */
+static double ghz;
+
+/**
+ * Processor description written with each record.
+ */
+static char cpu[49];
+
+/**
+ * Output file for benchmark records and its format.
+ */
+static FILE *out;
+static int fmt;
+static int records;
+
+/**
+ * Baseline medians, the tolerated slowdown and the regressions found so far.
+ */
+static char base_name[BENCH_RECORDS][64];
+static unsigned long long base_med[BENCH_RECORDS];
+static int bases;
+static double limit;
+static int regressions;
+
+static unsigned long long allocs;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+static void *bench_malloc(size_t n, const char *file, int line) {
+	allocs++;
+	return malloc(n);
+}
+
+static void *bench_realloc(void *p, size_t n, const char *file, int line) {
+	allocs++;
+	return realloc(p, n);
+}
+
+static void bench_free(void *p, const char *file, int line) {
+	free(p);
+}
+#else
+static void *bench_malloc(size_t n) {
+	allocs++;
+	return malloc(n);
+}
+
+static void *bench_realloc(void *p, size_t n) {
+	allocs++;
+	return realloc(p, n);
+}
+
+static void bench_free(void *p) {
+	free(p);
+}
+#endif
+
 /*============================================================================*/
 /* Public definitions                                                         */
 /*============================================================================*/
 
-void BENCH_reset() {
+static int bench_cmp(const void *a, const void *b) {
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Estimates the timer frequency against the monotonic clock. */
+static void bench_calibrate(void) {
+	struct timespec t0, t1;
+	unsigned long long c0, c1;
+	double ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	c0 = ARCH_cycles();
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	} while (ns < 2e7);
+	c1 = ARCH_cycles();
+	ghz = (c1 - c0) / ns;
+}
+
+/*
+ * Writes s as a quoted field: CSV doubles embedded quotes, JSON escapes quotes,
+ * backslashes and control characters.
+ */
+static void bench_quote(const char *s) {
+	fputc('"', out);
+	for (; *s != '\0'; s++) {
+		if (*s == '"') {
+			fputs(fmt == BENCH_CSV ? "\"\"" : "\\\"", out);
+		} else if (fmt == BENCH_JSON && *s == '\\') {
+			fputs("\\\\", out);
+		} else if (fmt == BENCH_JSON && (unsigned char)*s < 0x20) {
+			fprintf(out, "\\u%04x", (unsigned char)*s);
+		} else {
+			fputc(*s, out);
+		}
+	}
+	fputc('"', out);
+}
+
+/* Writes the record of the last benchmark to the output file. */
+static void bench_record(void) {
+	double ns = (ghz > 0 ? total / ghz : 0);
+
+	if (out == NULL) {
+		return;
+	}
+	if (fmt == BENCH_CSV) {
+		bench_quote(name);
+		fprintf(out, ",%llu,%.1f,%llu,%llu,%llu,%llu,%.0f,%d,",
+				total, ns, s_min, s_med, s_p90, s_p99, s_dev, runs);
+		bench_quote(cpu);
+		fprintf(out, "\n");
+	} else {
+		fprintf(out, "%s\n  {\"op\": ", (records ? "," : ""));
+		bench_quote(name);
+		fprintf(out, ", \"cycles\": %llu, \"ns\": %.1f, "
+				"\"min\": %llu, \"median\": %llu, \"p90\": %llu, \"p99\": %llu, "
+				"\"stddev\": %.0f, \"iterations\": %d, \"cpu\": ",
+				total, ns, s_min, s_med, s_p90, s_p99, s_dev, runs);
+		bench_quote(cpu);
+		fprintf(out, "}");
+	}
+	records++;
+}
+
+/* Returns the slowdown against the baseline in percent, or 0 if none. */
+static double bench_compare(void) {
+	int i;
+
+	for (i = 0; i < bases; i++) {
+		if (strcmp(base_name[i], name) == 0 && base_med[i] > 0) {
+			return 100.0 * ((double)s_med - base_med[i]) / base_med[i];
+		}
+	}
+	return 0;
+}
+
+void BENCH_overhead() {
+	int i;
+
+	ARCH_cpu_name(cpu, sizeof(cpu));
+	bench_calibrate();
+
+	overhead = 0;
+	/* Warm up the timer and caches before trusting any sample. */
+	BENCH_reset("overhead");
+	for (i = 0; i < BENCH_SAMPLES; i++) {
+		BENCH_before();
+		BENCH_after();
+	}
+	BENCH_reset("overhead");
+	for (i = 0; i < BENCH_SAMPLES; i++) {
+		BENCH_before();
+		BENCH_after();
+	}
+	/* The median is stable against the occasional interrupt. */
+	qsort(samples, count, sizeof(samples[0]), bench_cmp);
+	overhead = samples[count / 2];
+	BENCH_reset("");
+	printf("BENCH: %-32s = %llu cycles (%.2f cycles/ns)\n", "overhead", overhead, ghz);
+}
+
+int BENCH_pin(int cpu) {
+	cpu_set_t set;
+	int i;
+
+	CPU_ZERO(&set);
+	if (cpu >= 0) {
+		CPU_SET(cpu, &set);
+	} else {
+		for (i = 0; i < CPU_SETSIZE; i++) {
+			CPU_SET(i, &set);
+		}
+	}
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+void BENCH_reset(const char *label) {
+	name = label;
 	total = 0;
+	count = 0;
+	runs = 0;
 }
 
 void BENCH_before() {
@@ -44,22 +259,218 @@ void BENCH_before() {
 }
 
 void BENCH_after() {
-	long long result;
+	unsigned long long result;
 
 	after = ARCH_cycles();
-  	result = (after - before);
+	result = after - before;
+	result = (result > overhead ? result - overhead : 0);
 
+	if (count < BENCH_SAMPLES) {
+		samples[count++] = result;
+	}
 	total += result;
 }
 
 void BENCH_compute(int benches) {
+	double mean, var = 0;
+	int i, reps;
+
+	runs = benches;
+	if (count == 0 || benches <= 0) {
+		total = s_min = s_med = s_p90 = s_p99 = 0;
+		s_dev = 0;
+		return;
+	}
+
+	/* A sample may time several executions, so scale back to one. */
+	reps = benches / count;
+	if (reps < 1) {
+		reps = 1;
+	}
+	for (i = 0; i < count; i++) {
+		samples[i] /= reps;
+	}
+
+	qsort(samples, count, sizeof(samples[0]), bench_cmp);
+	s_min = samples[0];
+	s_med = samples[count / 2];
+	s_p90 = samples[(count * 90) / 100];
+	s_p99 = samples[(count * 99) / 100];
+
 	total = total / benches;
+	mean = (double)total;
+	for (i = 0; i < count; i++) {
+		var += (samples[i] - mean) * (samples[i] - mean);
+	}
+	s_dev = sqrt(var / count);
 }
 
 void BENCH_print() {
-	printf("%llu cycles\n", total);
+	double slow = bench_compare();
+
+	printf("BENCH: %-32s = %llu cycles (min %llu, med %llu, p90 %llu, p99 %llu, sd %.0f)",
+			name, total, s_min, s_med, s_p90, s_p99, s_dev);
+	if (bases > 0 && slow > limit) {
+		printf(" REGRESSION +%.1f%%", slow);
+		regressions++;
+	}
+	printf("\n");
+	bench_record();
+}
+
+int BENCH_output(const char *file, int format) {
+	out = fopen(file, "w");
+	if (out == NULL) {
+		return 0;
+	}
+	fmt = format;
+	records = 0;
+	if (fmt == BENCH_CSV) {
+		fprintf(out, "op,cycles,ns,min,median,p90,p99,stddev,iterations,cpu\n");
+	} else {
+		fprintf(out, "[");
+	}
+	return 1;
+}
+
+/* Decodes the four hex digits of a JSON unicode escape, or returns -1. */
+static int bench_hex(const char *p) {
+	int i, d = 0;
+
+	/* Stops at the first bad digit, so it never reads past a terminator. */
+	for (i = 0; i < 4; i++) {
+		if (p[i] >= '0' && p[i] <= '9') {
+			d = 16 * d + (p[i] - '0');
+		} else if (p[i] >= 'a' && p[i] <= 'f') {
+			d = 16 * d + (p[i] - 'a' + 10);
+		} else if (p[i] >= 'A' && p[i] <= 'F') {
+			d = 16 * d + (p[i] - 'A' + 10);
+		} else {
+			return -1;
+		}
+	}
+	return d;
+}
+
+/*
+ * Copies the field starting at p into dst, undoing the quoting of
+ * bench_quote if the field is quoted, and returns the first character after
+ * it, or NULL if it does not end on this line or does not fit.
+ */
+static const char *bench_field(const char *p, char *dst, size_t len, int json) {
+	size_t n = 0;
+	int d, esc;
+
+	if (*p != '"') {
+		while (*p != ',' && *p != '\0' && *p != '\n') {
+			if (n + 1 >= len) {
+				return NULL;
+			}
+			dst[n++] = *p++;
+		}
+		dst[n] = '\0';
+		return p;
+	}
+	for (p++; *p != '\0'; p++) {
+		if (*p == '"' && !(!json && p[1] == '"')) {
+			dst[n] = '\0';
+			return p + 1;
+		}
+		esc = (*p == '"' || (json && *p == '\\'));
+		if (esc) {
+			/* A doubled quote in CSV, an escape in JSON. */
+			p++;
+			if (*p == '\0') {
+				break;
+			}
+		}
+		if (n + 1 >= len) {
+			return NULL;
+		}
+		if (json && esc && *p == 'u') {
+			if ((d = bench_hex(p + 1)) < 0) {
+				return NULL;
+			}
+			dst[n++] = (char)d;
+			p += 4;
+		} else {
+			dst[n++] = *p;
+		}
+	}
+	return NULL;
+}
+
+int BENCH_baseline(const char *file, double threshold) {
+	char line[512];
+	const char *p, *q;
+	FILE *in = fopen(file, "r");
+	int i, json;
+
+	if (in == NULL) {
+		return 0;
+	}
+	limit = threshold;
+	bases = 0;
+	while (bases < BENCH_RECORDS && fgets(line, sizeof(line), in) != NULL) {
+		/* JSON has one object per line as written by BENCH_output. */
+		p = strstr(line, "\"op\": ");
+		json = (p != NULL);
+		if (json) {
+			p += strlen("\"op\": ");
+		} else if (strncmp(line, "op,", 3) == 0) {
+			continue;
+		} else {
+			p = line;
+		}
+		p = bench_field(p, base_name[bases], sizeof(base_name[0]), json);
+		if (p == NULL) {
+			continue;
+		}
+		if (json) {
+			q = strstr(p, "\"median\": ");
+			if (q != NULL) {
+				q += strlen("\"median\": ");
+			}
+		} else {
+			/* The median is the fourth column after the name. */
+			q = p;
+			for (i = 0; i < 4 && q != NULL; i++) {
+				q = strchr(q, ',');
+				if (q != NULL) {
+					q++;
+				}
+			}
+		}
+		if (q == NULL) {
+			continue;
+		}
+		base_med[bases] = strtoull(q, NULL, 10);
+		bases++;
+	}
+	fclose(in);
+	return 1;
+}
+
+int BENCH_finish() {
+	if (out != NULL) {
+		if (fmt == BENCH_JSON) {
+			fprintf(out, "\n]\n");
+		}
+		fclose(out);
+		out = NULL;
+	}
+	return regressions;
 }
 
 unsigned long long BENCH_total() {
 	return total;
 }
+
+int BENCH_alloc_init() {
+	allocs = 0;
+	return CRYPTO_set_mem_functions(bench_malloc, bench_realloc, bench_free);
+}
+
+unsigned long long BENCH_allocs() {
+	return allocs;
+}
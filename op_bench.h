@@ -40,6 +40,28 @@
  */
 #define BENCH 		10
 
+/**
+ * Maximum number of samples kept for the statistics of one benchmark.
+ */
+#define BENCH_SAMPLES	(BENCH * BENCH)
+
+/**
+ * Maximum number of benchmarks read from a baseline file.
+ */
+#define BENCH_RECORDS	256
+
+/**
+ * Output formats for benchmark records.
+ */
+enum {
+	/** Human-readable lines only. */
+	BENCH_TEXT,
+	/** One comma-separated record per benchmark, with a header line. */
+	BENCH_CSV,
+	/** A JSON array with one object per benchmark. */
+	BENCH_JSON
+};
+
 /*============================================================================*/
 /* Macro definitions                                                          */
 /*============================================================================*/
@@ -51,8 +73,7 @@
  * @param[in] FUNCTION		- the function to benchmark.
  */
 #define BENCH_ONCE(LABEL, FUNCTION)											\
-	BENCH_reset();															\
-	printf("BENCH: " LABEL "%*c = ", (int)(32 - strlen(LABEL)), ' ');	\
+	BENCH_reset(LABEL);														\
 	BENCH_before();															\
 	FUNCTION;																\
 	BENCH_after();															\
@@ -66,8 +87,7 @@
  * @param[in] FUNCTION		- the function to benchmark.
  */
 #define BENCH_SMALL(LABEL, FUNCTION)										\
-	BENCH_reset();															\
-	printf("BENCH: " LABEL "%*c = ", (int)(32 - strlen(LABEL)), ' ');	\
+	BENCH_reset(LABEL);														\
 	BENCH_before();															\
 	for (int i = 0; i < BENCH; i++)	{										\
 		FUNCTION;															\
@@ -82,8 +102,7 @@
  * @param[in] LABEL			- the label for this benchmark.
  */
 #define BENCH_BEGIN(LABEL)													\
-	BENCH_reset();															\
-	printf("BENCH: " LABEL "%*c = ", (int)(32 - strlen(LABEL)), ' ');	\
+	BENCH_reset(LABEL);														\
 	for (int i = 0; i < BENCH; i++)	{										\
 
 /**
@@ -95,33 +114,43 @@
 	BENCH_print()															\
 
 /**
- * Measures the time of one execution and adds it to the benchmark total.
+ * Measures the time of each execution and records it as a sample, after an
+ * untimed warm-up run.
  *
  * @param[in] FUNCTION		- the function executed.
  */
 #define BENCH_ADD(FUNCTION)													\
 	FUNCTION;																\
-	BENCH_before();															\
 	for (int j = 0; j < BENCH; j++) {										\
+		BENCH_before();														\
 		FUNCTION;															\
+		BENCH_after();														\
 	}																		\
-	BENCH_after();															\
 
 /*============================================================================*/
 /* Function prototypes                                                        */
 /*============================================================================*/
 
 /**
- * Measures and prints benchmarking overhead.
+ * Measures and prints benchmarking overhead, which is then subtracted from
+ * every later sample.
  */
 void BENCH_overhead(void);
 
+/**
+ * Pins the calling thread to a processor to reduce migration noise.
+ *
+ * @param[in] cpu			- the processor index, or -1 to allow any processor.
+ * @return 1 if the thread was pinned, 0 otherwise.
+ */
+int BENCH_pin(int cpu);
+
 /**
  * Resets the benchmark data.
  *
  * @param[in] label			- the benchmark label.
  */
-void BENCH_reset(void);
+void BENCH_reset(const char *label);
 
 /**
  * Measures the time before a benchmark is executed.
@@ -129,22 +158,52 @@ void BENCH_reset(void);
 void BENCH_before(void);
 
 /**
- * Measures the time after a benchmark was started and adds it to the total.
+ * Measures the time after a benchmark was started and records it as a sample.
  */
 void BENCH_after(void);
 
 /**
- * Computes the mean elapsed time between the start and the end of a benchmark.
+ * Computes the mean, minimum, median, 90th and 99th percentiles and standard
+ * deviation of the time of one execution.
  *
  * @param benches			- the number of executed benchmarks.
  */
 void BENCH_compute(int benches);
 
 /**
- * Prints the last benchmark.
+ * Prints the last benchmark, writes its record and checks it against the
+ * baseline.
  */
 void BENCH_print(void);
 
+/**
+ * Writes a record of every following benchmark to a file. Benchmark labels
+ * are quoted, so they may contain commas and quotes.
+ *
+ * @param[in] file			- the output file name.
+ * @param[in] format		- BENCH_CSV or BENCH_JSON.
+ * @return 1 if the file could be opened, 0 otherwise.
+ */
+int BENCH_output(const char *file, int format);
+
+/**
+ * Loads benchmark results from a CSV or JSON file written by BENCH_output
+ * and flags any later benchmark whose median is slower by more than the
+ * given percentage.
+ *
+ * @param[in] file			- the baseline file name.
+ * @param[in] threshold		- the tolerated slowdown in percent.
+ * @return 1 if the baseline could be read, 0 otherwise.
+ */
+int BENCH_baseline(const char *file, double threshold);
+
+/**
+ * Closes the output file.
+ *
+ * @return the number of regressions found against the baseline.
+ */
+int BENCH_finish(void);
+
 /**
  * Returns the result of the last benchmark.
  *
@@ -152,4 +211,19 @@ void BENCH_print(void);
  */
 unsigned long long BENCH_total(void);
 
+/**
+ * Starts counting heap allocations made through OpenSSL. Must be called
+ * before anything is allocated.
+ *
+ * @return 1 if the counter was installed, 0 otherwise.
+ */
+int BENCH_alloc_init(void);
+
+/**
+ * Returns the number of heap allocations counted so far.
+ *
+ * @return the number of allocations.
+ */
+unsigned long long BENCH_allocs(void);
+
 #endif /* !OP_BENCH_H */
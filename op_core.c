@@ -20,6 +20,8 @@
  * along with OpenPairing. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include "op.h"
 
 #define P 	"2523648240000001BA344D80000000086121000000000013A700000000000013"
@@ -34,122 +36,575 @@
 #define Y0	"021897A06BAF93439A90E096698C822329BD0AE6BDBE09BD19F0E07891CD2B9A"
 #define Y1	"0EBB2B0E7C8B15268F6D4456F5F38D37B09006FFD739C9578A2D1AEC6B3ACE9B"
 
-PAIRING_GROUP group = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+PAIRING_GROUP group = { NULL, NULL, { { 0 } }, NULL, NULL, { { { { { { 0 } } } } } } };
+
+/* Derives the Frobenius constants for p^2 and p^3 from those for p. */
+static int op_frb(PAIRING_GROUP *g) {
+	FP2 t;
+	int k;
+
+	FP2_zero(&t);
+	FP_copy(&t.f[0], &g->one);
+	for (k = 0; k < 5; k++) {
+		if (!FP2_mul_frb(g, &g->frb[0][k], &t, k + 1)) {
+			return 0;
+		}
+		/* g2 = g1^(p + 1) lies in Fp, and g3 = g1 * g2^p = g1 * g2. */
+		if (!FP2_inv_uni(g, &g->frb[1][k], &g->frb[0][k])) {
+			return 0;
+		}
+		if (!FP2_mul(g, &g->frb[1][k], &g->frb[1][k], &g->frb[0][k])) {
+			return 0;
+		}
+		if (!FP2_mul(g, &g->frb[2][k], &g->frb[1][k], &g->frb[0][k])) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Encodes the Miller-loop parameter |6x + 2| = 6|x| - 2 as signed digits.
+ * The NAF is kept only if it saves work: each digit after the first costs a
+ * doubling and each nonzero digit after the first an addition, so a NAF one
+ * digit longer than the binary expansion needs a lower weight to pay off.
+ */
+static void op_par(PAIRING_GROUP *g) {
+	unsigned __int128 u, v;
+	signed char bin[PAR_DIGS], naf[PAR_DIGS];
+	int i, nb = 0, nn = 0, wb = 0, wn = 0;
+
+	u = (unsigned __int128)X_ABS * 6 - 2;
+	for (v = u; v != 0; v >>= 1) {
+		bin[nb] = (signed char)(v & 1);
+		wb += bin[nb++];
+	}
+	for (v = u; v != 0; v >>= 1) {
+		naf[nn] = 0;
+		if (v & 1) {
+			/* Pick the digit that leaves v divisible by 4. */
+			naf[nn] = (signed char)(2 - (int)(v & 3));
+			v -= naf[nn];
+			wn++;
+		}
+		nn++;
+	}
+
+	if (nn + wn < nb + wb) {
+		for (i = 0; i < nn; i++) {
+			g->par[i] = naf[nn - 1 - i];
+		}
+		g->par_len = nn;
+	} else {
+		for (i = 0; i < nb; i++) {
+			g->par[i] = bin[nb - 1 - i];
+		}
+		g->par_len = nb;
+	}
+}
+
+/* Coefficients of beta as a polynomial in x, constant first. */
+static const int beta[4] = { 1, 9, 18, 18 };
+
+/* Sets r = c[0] + c[1] * x + c[2] * x^2 + c[3] * x^3. */
+static int op_poly(BIGNUM *r, const BIGNUM *x, const int *c, BN_CTX *ctx) {
+	int i;
+
+	BN_zero(r);
+	for (i = 3; i >= 0; i--) {
+		if (!BN_mul(r, r, x, ctx)) {
+			return 0;
+		}
+		if (c[i] >= 0 ? !BN_add_word(r, c[i]) : !BN_sub_word(r, -c[i])) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * GLS lattice for lambda = p mod r = 6x^2, from Galbraith and Scott. Both psi
+ * on G2 and the Frobenius on GT act as lambda. See op_decomp for the layout.
+ */
+const int op_gls_basis[16][4] = {
+	{ 1, 1 }, { 0, 1 }, { 0, 1 }, { 0, -2 },
+	{ 1, 2 }, { 0, -1 }, { -1, -1 }, { 0, -1 },
+	{ 0, 2 }, { 1, 2 }, { 1, 2 }, { 1, 2 },
+	{ -1, 1 }, { 2, 4 }, { 1, -2 }, { -1, 1 }
+};
+
+const int op_gls_dual[4][4] = {
+	{ 1, 3, 2, 0 }, { 0, 1, 8, 12 }, { 0, 1, 4, 6 }, { 0, -1, -2, 0 }
+};
+
+/*
+ * Splits k mod r into e[0] + e[1] * lambda + ... + e[m - 1] * lambda^(m - 1)
+ * by Babai rounding. Row j of the lattice basis holds polynomials in x (four
+ * coefficients each, constant first) at basis[j * m + i], and dual[j] is the
+ * j-th entry of the first row of its adjugate, whose determinant is r. With
+ * odd set, some a_j are rounded one lower so that every part comes out odd.
+ */
+int op_decomp(const PAIRING_GROUP *group, BIGNUM **e, const BIGNUM *k, const int (*basis)[4], const int (*dual)[4], int m, int odd, BN_CTX *ctx) {
+	BIGNUM *x, *n, *t, *q, *a[4];
+	int i, j, b, c, par, ret = 0;
+
+	if (m > 4) {
+		return 0;
+	}
+
+	BN_CTX_start(ctx);
+	x = BN_CTX_get(ctx);
+	n = BN_CTX_get(ctx);
+	t = BN_CTX_get(ctx);
+	q = BN_CTX_get(ctx);
+	for (j = 0; j < m; j++) {
+		a[j] = BN_CTX_get(ctx);
+	}
+	if (a[m - 1] == NULL) {
+		goto err;
+	}
+
+	if (!BN_set_word(x, X_ABS) || !EC_GROUP_get_order(group->ec, n, ctx)) {
+		goto err;
+	}
+	BN_set_negative(x, 1);
+	if (!BN_nnmod(e[0], k, n, ctx)) {
+		goto err;
+	}
+
+	/* a_j = round(k * dual_j(x) / r). */
+	for (j = 0; j < m; j++) {
+		if (!op_poly(t, x, dual[j], ctx) || !BN_mul(t, t, e[0], ctx)) {
+			goto err;
+		}
+		if (!BN_div(a[j], q, t, n, ctx) || !BN_lshift1(q, q)) {
+			goto err;
+		}
+		BN_set_negative(q, 0);
+		if (BN_cmp(q, n) >= 0) {
+			if (BN_is_negative(t) ? !BN_sub_word(a[j], 1) : !BN_add_word(a[j], 1)) {
+				goto err;
+			}
+		}
+	}
+
+	/*
+	 * Lowering a_j adds row j to e. Since x is odd, entry i of row j is odd
+	 * when its coefficients add up to an odd number, and the rows stay
+	 * independent modulo 2 because their determinant r is odd: exactly one
+	 * set b of rows to add makes every part odd.
+	 */
+	for (b = 0; odd && b < (1 << m); b++) {
+		par = BN_is_odd(e[0]);
+		for (j = 0; j < m; j++) {
+			for (i = 0; i < m; i++) {
+				c = basis[j * m + i][0] + basis[j * m + i][1] + basis[j * m + i][2] + basis[j * m + i][3];
+				par ^= ((BN_is_odd(a[j]) ^ (b >> j)) & c & 1) << i;
+			}
+		}
+		if (par == (1 << m) - 1) {
+			for (j = 0; j < m; j++) {
+				if ((b >> j) & 1 && !BN_sub_word(a[j], 1)) {
+					goto err;
+				}
+			}
+			break;
+		}
+	}
+
+	/* e = (k, 0, ..., 0) - sum_j a_j * b_j. */
+	for (i = 1; i < m; i++) {
+		BN_zero(e[i]);
+	}
+	for (j = 0; j < m; j++) {
+		for (i = 0; i < m; i++) {
+			if (!op_poly(t, x, basis[j * m + i], ctx)) {
+				goto err;
+			}
+			if (!BN_mul(q, t, a[j], ctx) || !BN_sub(e[i], e[i], q)) {
+				goto err;
+			}
+		}
+	}
+
+	ret = 1;
+err:
+	BN_CTX_end(ctx);
+	return ret;
+}
+
+int op_naf(signed char *naf, const BIGNUM *e, int w) {
+	unsigned __int128 m = 0;
+	int i, d, len = 0;
+
+	if (BN_num_bits(e) > GLV_DIGS - 2) {
+		return -1;
+	}
+	for (i = BN_num_bits(e) - 1; i >= 0; i--) {
+		m = (m << 1) | (unsigned)BN_is_bit_set(e, i);
+	}
+	while (m != 0) {
+		d = 0;
+		if (m & 1) {
+			/* The signed residue of m modulo 2^w. */
+			d = (int)(m & ((1 << w) - 1));
+			if (d >= (1 << (w - 1))) {
+				d -= (1 << w);
+			}
+			if (d > 0) {
+				m -= (unsigned)d;
+			} else {
+				m += (unsigned)-d;
+			}
+		}
+		naf[len++] = (signed char)d;
+		m >>= 1;
+	}
+	return len;
+}
+
+/* Stores 0 <= a < 2^(64 * FP_DIGS) in FP_DIGS little-endian words. */
+static void op_words(uint64_t *s, const BIGNUM *a) {
+	unsigned char buf[8 * FP_DIGS];
+	int i, len = BN_num_bytes(a);
+
+	/* BN_bn2bin writes big-endian without padding. */
+	memset(buf, 0, sizeof(buf));
+	BN_bn2bin(a, buf + sizeof(buf) - len);
+	for (i = 0; i < FP_DIGS; i++) {
+		s[i] = 0;
+	}
+	for (i = 0; i < (int)sizeof(buf); i++) {
+		s[i / 8] |= (uint64_t)buf[sizeof(buf) - 1 - i] << (8 * (i % 8));
+	}
+}
+
+int op_msm_read(uint64_t *s, const BIGNUM *k, const BIGNUM *n, BN_CTX *ctx) {
+	BIGNUM *t;
+	int ret = 0;
+
+	BN_CTX_start(ctx);
+	t = BN_CTX_get(ctx);
+	if (t == NULL || !BN_nnmod(t, k, n, ctx)) {
+		goto err;
+	}
+	op_words(s, t);
+	ret = 1;
+
+err:
+	BN_CTX_end(ctx);
+	return ret;
+}
+
+int op_msm_win(size_t n) {
+	double cost, best = 0;
+	int c, w = 1;
+
+	/*
+	 * Each window costs one bucket addition per point plus the running sums
+	 * over its 2^(c - 1) buckets, two additions apiece at about twice the
+	 * price of a batched affine one.
+	 */
+	for (c = 1; c <= MSM_WIN; c++) {
+		cost = (double)((ORD_BITS + c) / c) * ((double)n + (double)(1 << (c + 1)));
+		if (c == 1 || cost < best) {
+			best = cost;
+			w = c;
+		}
+	}
+	return w;
+}
+
+/* Returns c bits of s starting at bit pos, which may run past the top. */
+static int op_bits(const uint64_t *s, int pos, int c) {
+	uint64_t t;
+	int i = pos / 64, j = pos % 64;
+
+	if (i >= FP_DIGS) {
+		return 0;
+	}
+	t = s[i] >> j;
+	if (j + c > 64 && i + 1 < FP_DIGS) {
+		t |= s[i + 1] << (64 - j);
+	}
+	return (int)(t & ((1ULL << c) - 1));
+}
+
+int op_msm_dig(const uint64_t *s, int w, int c) {
+	int d, t;
+
+	/*
+	 * Digits in [-2^(c - 1), 2^(c - 1)]: window w borrows 2^c from the next
+	 * one exactly when its own top bit is set, so the carry coming in is
+	 * the top bit of the window below.
+	 */
+	d = t = op_bits(s, w * c, c);
+	if (w > 0) {
+		d += op_bits(s, w * c - 1, 1);
+	}
+	return (t >> (c - 1)) ? d - (1 << c) : d;
+}
+
+int op_msm_init(OP_MSM *m, int nb, int batch) {
+	int b;
+
+	m->round = 0;
+	m->stamp = OPENSSL_malloc(nb * sizeof(int));
+	m->idx = OPENSSL_malloc(batch * sizeof(int));
+	m->dbk = OPENSSL_malloc(batch * sizeof(int));
+	m->dpt = OPENSSL_malloc(batch * sizeof(size_t));
+	if (m->stamp == NULL || m->idx == NULL || m->dbk == NULL || m->dpt == NULL) {
+		op_msm_free(m);
+		return 0;
+	}
+	for (b = 0; b < nb; b++) {
+		m->stamp[b] = 0;
+	}
+	return 1;
+}
+
+void op_msm_free(OP_MSM *m) {
+	OPENSSL_free(m->stamp);
+	OPENSSL_free(m->idx);
+	OPENSSL_free(m->dbk);
+	OPENSSL_free(m->dpt);
+	m->stamp = m->idx = m->dbk = NULL;
+	m->dpt = NULL;
+}
+
+/* Offers point e = 2i + neg to bucket b, returning 0 if b is busy this round. */
+static int op_msm_try(OP_MSM *m, int b, size_t e, int *k) {
+	if (m->stamp[b] == m->round) {
+		return 0;
+	}
+	if (m->put(m->arg, b, e >> 1, (int)(e & 1), *k)) {
+		m->stamp[b] = m->round;
+		m->idx[(*k)++] = b;
+	}
+	return 1;
+}
+
+int op_msm_fill(OP_MSM *m, const uint64_t *s, size_t n, int w, int c, int lim) {
+	size_t i = 0, e;
+	int d, j, k, nd = 0;
+
+	/*
+	 * Up to lim additions and lim deferred points per round. Deferred points
+	 * are retried before new ones are taken, and no bucket is busy at the
+	 * start of a round, so every round makes progress.
+	 */
+	while (i < n || nd > 0) {
+		m->round++;
+		k = 0;
+		for (j = d = 0; j < nd; j++) {
+			if (!op_msm_try(m, m->dbk[j], m->dpt[j], &k)) {
+				m->dbk[d] = m->dbk[j];
+				m->dpt[d++] = m->dpt[j];
+			}
+		}
+		nd = d;
+		for (; i < n && k < lim && nd < lim; i++) {
+			if ((d = op_msm_dig(s + i * FP_DIGS, w, c)) == 0) {
+				continue;
+			}
+			e = 2 * i + (d < 0);
+			d = (d < 0 ? -d : d) - 1;
+			if (!op_msm_try(m, d, e, &k)) {
+				m->dbk[nd] = d;
+				m->dpt[nd++] = e;
+			}
+		}
+		if (!m->flush(m->arg, m->idx, k)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int op_gen_rec(const PAIRING_GROUP *group, signed char *dig, const BIGNUM *k, const int (*basis)[4], const int (*dual)[4], int m, int len, BN_CTX *ctx) {
+	uint64_t s[FP_DIGS], c, sgn;
+	BIGNUM *e[4];
+	int i, j, l, ret = 0;
+
+	BN_CTX_start(ctx);
+	for (i = 0; i < m; i++) {
+		e[i] = BN_CTX_get(ctx);
+	}
+	if (e[m - 1] == NULL || !op_decomp(group, e, k, basis, dual, m, 1, ctx)) {
+		goto err;
+	}
+
+	for (i = 0; i < m; i++) {
+		if (BN_num_bits(e[i]) > 64 * FP_DIGS - 1) {
+			goto err;
+		}
+		/* Two's complement of e[i], so that negative parts recode the same way. */
+		op_words(s, e[i]);
+		sgn = (uint64_t)0 - (uint64_t)BN_is_negative(e[i]);
+		c = sgn & 1;
+		for (l = 0; l < FP_DIGS; l++) {
+			s[l] = (s[l] ^ sgn) + c;
+			c = (s[l] < c);
+		}
+
+		/*
+		 * For odd s, s = d + 2^w * s' with d = (s mod 2^(w + 1)) - 2^w odd and
+		 * s' = (s >> w) | 1 odd again, shifting in the sign. The last digit
+		 * takes what is left, which must fit in a window.
+		 */
+		for (j = 0; j < len - 1; j++) {
+			dig[i * len + j] = (signed char)((int)(s[0] & ((1 << (GEN_WIN + 1)) - 1)) - (1 << GEN_WIN));
+			for (l = 0; l < FP_DIGS - 1; l++) {
+				s[l] = (s[l] >> GEN_WIN) | (s[l + 1] << (64 - GEN_WIN));
+			}
+			s[FP_DIGS - 1] = (s[FP_DIGS - 1] >> GEN_WIN) | (sgn << (64 - GEN_WIN));
+			s[0] |= 1;
+		}
+		for (l = 1; l < FP_DIGS; l++) {
+			if (s[l] != sgn) {
+				goto err;
+			}
+		}
+		if ((s[0] >> 63) != (sgn & 1) || (int64_t)s[0] <= -(1 << GEN_WIN) || (int64_t)s[0] >= (1 << GEN_WIN)) {
+			goto err;
+		}
+		dig[i * len + len - 1] = (signed char)s[0];
+	}
+	ret = 1;
+
+err:
+	BN_CTX_end(ctx);
+	return ret;
+}
 
 int op_init(void) {
 	BIGNUM *a = NULL, *b = NULL, *x = NULL, *r = NULL, *p = NULL, *one = NULL;
+	BN_CTX *ctx = NULL;
 	EC_POINT *g1 = NULL;
+	int ret = 0;
 
-	group.bn = BN_CTX_new();
-	group.mont = BN_MONT_CTX_new();
-	if (group.bn == NULL || group.mont == NULL) {
-		op_free();
-		return 0;
+	/* Pick the field multiplication backend for this CPU before any arithmetic. */
+	FP_select(ARCH_has_adx());
+
+	/* Scratch space is only needed while building the group. */
+	ctx = BN_CTX_new();
+	if (ctx == NULL) {
+		goto err;
 	}
 
 	if (BN_hex2bn(&p, P) != (sizeof(P) - 1)) {
-		return 0;
+		goto err;
 	}
 
-	a = BN_CTX_get(group.bn);
-	b = BN_CTX_get(group.bn);
+	a = BN_CTX_get(ctx);
+	b = BN_CTX_get(ctx);
 	one = BN_new();
-	if (one == NULL) {
-		op_free();
-		return 0;
+	if (b == NULL || one == NULL) {
+		goto err;
 	}
 	if (!BN_set_word(a, 0) || !BN_set_word(b, 2) || !BN_set_word(one, 1)) {
-		op_free();
-		return 0;
+		goto err;
 	}
-	group.ec = EC_GROUP_new_curve_GFp(p, a, b, group.bn);
+	group.ec = EC_GROUP_new_curve_GFp(p, a, b, ctx);
 	if (group.ec == NULL) {
-		op_free();
-		return 0;
-	}
-	group.field = &group.ec->field;
-	if (!BN_MONT_CTX_set(group.mont, group.field, group.bn)) {
-		return 0;
+		goto err;
 	}
+	group.field = p;
+	p = NULL;
 
 	g1 = EC_POINT_new(group.ec);
 	if (g1 == NULL) {
-		op_free();
-		return 0;
+		goto err;
 	}
 
 	if (BN_hex2bn(&x, X) != (sizeof(X) - 1)) {
-		op_free();
-		return 0;
+		goto err;
 	}
 	if (BN_hex2bn(&r, R) != (sizeof(R) - 1)) {
-		op_free();
-		return 0;
+		goto err;
 	}
 
-	if (!EC_POINT_set_affine_coordinates_GFp(group.ec, g1, x, one, group.bn)) {
-		op_free();
-		return 0;
+	if (!EC_POINT_set_affine_coordinates_GFp(group.ec, g1, x, one, ctx)) {
+		goto err;
 	}
 	if (!EC_GROUP_set_generator(group.ec, g1, r, one)) {
-		op_free();
-		return 0;
+		goto err;
 	}
 
-    if (!BN_to_montgomery(one, BN_value_one(), group.mont, group.bn)) {
-        return 0;
+	/* The field arithmetic works in Montgomery form, so convert constants. */
+	if (!FP_read_bn(&group.one, one)) {
+		goto err;
 	}
 
 	group.g2x = (FP2 *)calloc(1, sizeof(FP2));
 	group.g2y = (FP2 *)calloc(1, sizeof(FP2));
 	if (group.g2x == NULL || group.g2y == NULL) {
-		op_free();
-		return 0;
+		goto err;
 	}
 
-	if (BN_hex2bn(&x, X0) != (sizeof(X0) - 1)) {
-		op_free();
-		return 0;
+	if (BN_hex2bn(&x, X0) != (sizeof(X0) - 1) || !FP_read_bn(&group.g2x->f[0], x)) {
+		goto err;
+	}
+	if (BN_hex2bn(&x, X1) != (sizeof(X1) - 1) || !FP_read_bn(&group.g2x->f[1], x)) {
+		goto err;
+	}
+	if (BN_hex2bn(&x, Y0) != (sizeof(Y0) - 1) || !FP_read_bn(&group.g2y->f[0], x)) {
+		goto err;
+	}
+	if (BN_hex2bn(&x, Y1) != (sizeof(Y1) - 1) || !FP_read_bn(&group.g2y->f[1], x)) {
+		goto err;
 	}
-	BN_copy(&group.g2x->f[0], x);
 
-	if (BN_hex2bn(&x, X1) != (sizeof(X1) - 1)) {
-		op_free();
-		return 0;
+	if (!op_frb(&group)) {
+		goto err;
 	}
-	BN_copy(&group.g2x->f[1], x);
+	op_par(&group);
 
-	if (BN_hex2bn(&x, Y0) != (sizeof(Y0) - 1)) {
-		op_free();
-		return 0;
+	/* beta = 18x^3 + 18x^2 + 9x + 1, matching lambda = 36x^3 + 18x^2 + 6x + 1. */
+	if (!BN_set_word(a, X_ABS)) {
+		goto err;
+	}
+	BN_set_negative(a, 1);
+	if (!op_poly(b, a, beta, ctx) || !BN_nnmod(b, b, group.field, ctx)) {
+		goto err;
+	}
+	if (!FP_read_bn(&group.beta, b)) {
+		goto err;
 	}
-	BN_copy(&group.g2y->f[0], x);
 
-	if (BN_hex2bn(&x, Y1) != (sizeof(Y1) - 1)) {
-		op_free();
-		return 0;
+	if (!G1_gen_table(&group, ctx) || !G2_gen_table(&group)) {
+		goto err;
+	}
+	if (!op_map(&group.gt, EC_GROUP_get0_generator(group.ec), group.g2x, group.g2y, ctx)) {
+		goto err;
 	}
-	BN_copy(&group.g2y->f[1], x);
 
-	group.one = one;
-	one = NULL;
+	ret = 1;
 
-	BN_free(a);
-	BN_free(b);
-	BN_free(x);	
-	BN_free(r);
+err:
+	if (!ret) {
+		op_free();
+	}
+	BN_CTX_free(ctx);
 	BN_free(p);
+	BN_free(one);
+	BN_free(x);
+	BN_free(r);
 	EC_POINT_free(g1);
-	return 1;
+	return ret;
 }
 
 void op_free(void) {
-	BN_CTX_free(group.bn);
 	EC_GROUP_free(group.ec);
-	BN_free(&group.g2x->f[0]);
-	BN_free(&group.g2x->f[1]);
-	BN_free(&group.g2y->f[0]);
-	BN_free(&group.g2y->f[1]);
+	BN_free(group.field);
 	free(group.g2x);
 	free(group.g2y);
-}
\ No newline at end of file
+	OPENSSL_free(group.g1_tab);
+	OPENSSL_free(group.g2_tab);
+	group.ec = NULL;
+	group.field = NULL;
+	group.g2x = NULL;
+	group.g2y = NULL;
+	group.g1_tab = NULL;
+	group.g2_tab = NULL;
+}
@@ -0,0 +1,678 @@
+/*
+ * OpenPairing is an implementation of a bilinear pairing over OpenSSL
+ * Copyright (C) 2015 OpenPairing Authors
+ *
+ * This file is part of OpenPairing. OpenPairing is legal property of its
+ * developers, whose names are not listed here. Please refer to the COPYRIGHT
+ * file for contact information.
+ *
+ * OpenPairing is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OpenPairing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenPairing. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "openssl/rand.h"
+
+#include "op.h"
+
+/*
+ * Arithmetic specialized to the 254-bit BN prime
+ * p = 36x^4 + 36x^3 + 24x^2 + 6x + 1, x = -(2^62 + 2^55 + 1).
+ * Elements are kept in Montgomery form with R = 2^256. Since p < 2^254,
+ * sums of up to four elements fit in FP_DIGS digits without carry-out.
+ */
+
+typedef unsigned __int128 uint128_t;
+typedef __int128 int128_t;
+
+/* The prime p. */
+static const uint64_t prime[FP_DIGS] = {
+	0xA700000000000013ULL, 0x6121000000000013ULL,
+	0xBA344D8000000008ULL, 0x2523648240000001ULL
+};
+
+/* The prime p in five signed 62-bit limbs, used for inversion. */
+static const int64_t prime62[5] = {
+	0x2700000000000013LL, 0x048400000000004ELL, 0x2344D80000000086LL,
+	0x08D920900000006ELL, 0x25LL
+};
+
+/* p^{-1} mod 2^62. */
+static const uint64_t prime62_inv = 0x37BCA1AF286BCA1BULL;
+
+/* R^3 mod p, which takes an integer inverse back into Montgomery form. */
+static const FP conv3 = { {
+	0x631B7E411531F6DFULL, 0x5130479839E3DC8CULL,
+	0x69A1E2B133D59539ULL, 0x10824852757FDC0AULL
+} };
+
+/* R^2 mod p, used to convert into Montgomery form. */
+static const FP conv = { {
+	0xB3E886745370473DULL, 0x55EFBF6E8C1CC3F1ULL,
+	0x281E3A1B7F86954FULL, 0x1B0A32FDF6403A3DULL
+} };
+
+/* -p^{-1} mod 2^64. */
+static const uint64_t u = 0x08435E50D79435E5ULL;
+
+/* Computes c = a - b and returns the borrow. */
+static uint64_t fp_subn(uint64_t *c, const uint64_t *a, const uint64_t *b, int digs) {
+	uint64_t t, w, borrow = 0;
+	int i;
+
+	for (i = 0; i < digs; i++) {
+		t = a[i] - b[i];
+		w = (a[i] < b[i]);
+		c[i] = t - borrow;
+		borrow = w | (t < borrow);
+	}
+	return borrow;
+}
+
+/* Computes c = a + b and returns the carry. */
+static uint64_t fp_addn(uint64_t *c, const uint64_t *a, const uint64_t *b, int digs) {
+	uint64_t t, carry = 0;
+	int i;
+
+	for (i = 0; i < digs; i++) {
+		t = a[i] + carry;
+		carry = (t < carry);
+		c[i] = t + b[i];
+		carry |= (c[i] < t);
+	}
+	return carry;
+}
+
+/*
+ * Sets c to a - p if a >= p and to a otherwise, without branching on the
+ * value of a. The comparison and the masked subtraction are two plain carry
+ * chains, which compilers keep in registers; c may alias a.
+ */
+static void fp_subc(uint64_t *c, const uint64_t *a, uint64_t hi) {
+	uint64_t d, m, w, borrow = 0, mask;
+	int i;
+
+	for (i = 0; i < FP_DIGS; i++) {
+		d = a[i] - prime[i];
+		borrow = (a[i] < prime[i]) | (d < borrow);
+	}
+	/* Subtract p if there was no borrow or if a had a carry-out. */
+	mask = -((hi | (borrow ^ 1)) & 1);
+	borrow = 0;
+	for (i = 0; i < FP_DIGS; i++) {
+		m = prime[i] & mask;
+		d = a[i] - m;
+		w = (a[i] < m);
+		c[i] = d - borrow;
+		borrow = w | (d < borrow);
+	}
+}
+
+/* Montgomery reduction of the 2 * FP_DIGS digits in t, t < pR. */
+static void fp_rdcn(uint64_t *c, uint64_t *t) {
+	uint64_t m, carry, hi = 0;
+	uint128_t w;
+	int i, j;
+
+	for (i = 0; i < FP_DIGS; i++) {
+		m = t[i] * u;
+		carry = 0;
+		for (j = 0; j < FP_DIGS; j++) {
+			w = (uint128_t)m * prime[j] + t[i + j] + carry;
+			t[i + j] = (uint64_t)w;
+			carry = (uint64_t)(w >> 64);
+		}
+		/* Propagate the carry into the upper half. */
+		w = (uint128_t)t[i + FP_DIGS] + carry + hi;
+		t[i + FP_DIGS] = (uint64_t)w;
+		hi = (uint64_t)(w >> 64);
+	}
+	fp_subc(c, t + FP_DIGS, hi);
+}
+
+/* Computes the 2 * FP_DIGS digits of the product a * b. */
+static void fp_muln(uint64_t *c, const uint64_t *a, const uint64_t *b) {
+	uint64_t carry;
+	int i, j;
+
+	memset(c, 0, 2 * FP_DIGS * sizeof(uint64_t));
+	for (i = 0; i < FP_DIGS; i++) {
+		carry = 0;
+		for (j = 0; j < FP_DIGS; j++) {
+			uint128_t w = (uint128_t)a[i] * b[j] + c[i + j] + carry;
+			c[i + j] = (uint64_t)w;
+			carry = (uint64_t)(w >> 64);
+		}
+		c[i + FP_DIGS] = carry;
+	}
+}
+
+/* Computes the 2 * FP_DIGS digits of a^2, sharing the cross products. */
+static void fp_sqrn(uint64_t *c, const uint64_t *a) {
+	uint64_t carry;
+	int i, j;
+
+	memset(c, 0, 2 * FP_DIGS * sizeof(uint64_t));
+	/* Cross products a_i * a_j, i < j. */
+	for (i = 0; i < FP_DIGS - 1; i++) {
+		carry = 0;
+		for (j = i + 1; j < FP_DIGS; j++) {
+			uint128_t w = (uint128_t)a[i] * a[j] + c[i + j] + carry;
+			c[i + j] = (uint64_t)w;
+			carry = (uint64_t)(w >> 64);
+		}
+		c[i + FP_DIGS] = carry;
+	}
+	/* Double them. */
+	c[2 * FP_DIGS - 1] = c[2 * FP_DIGS - 2] >> 63;
+	for (i = 2 * FP_DIGS - 2; i > 0; i--) {
+		c[i] = (c[i] << 1) | (c[i - 1] >> 63);
+	}
+	c[0] <<= 1;
+	/* Add the squares a_i^2. */
+	carry = 0;
+	for (i = 0; i < FP_DIGS; i++) {
+		uint128_t w = (uint128_t)a[i] * a[i];
+		uint128_t s = (uint128_t)c[2 * i] + (uint64_t)w + carry;
+		c[2 * i] = (uint64_t)s;
+		s = (uint128_t)c[2 * i + 1] + (uint64_t)(w >> 64) + (uint64_t)(s >> 64);
+		c[2 * i + 1] = (uint64_t)s;
+		carry = (uint64_t)(s >> 64);
+	}
+}
+
+/* Portable Montgomery multiplication. */
+static void fp_mul_c(uint64_t *c, const uint64_t *a, const uint64_t *b) {
+	uint64_t t[2 * FP_DIGS];
+
+	fp_muln(t, a, b);
+	fp_rdcn(c, t);
+}
+
+/* Portable Montgomery squaring. */
+static void fp_sqr_c(uint64_t *c, const uint64_t *a) {
+	uint64_t t[2 * FP_DIGS];
+
+	fp_sqrn(t, a);
+	fp_rdcn(c, t);
+}
+
+/* Portable reduction that leaves its double-precision input untouched. */
+static void fp_rdc_c(uint64_t *c, const uint64_t *a) {
+	uint64_t t[2 * FP_DIGS];
+
+	memcpy(t, a, sizeof(t));
+	fp_rdcn(c, t);
+}
+
+/* Multiplication backends, chosen once by FP_select(). */
+static void (*fp_mul)(uint64_t *, const uint64_t *, const uint64_t *) = fp_mul_c;
+static void (*fp_sqr)(uint64_t *, const uint64_t *) = fp_sqr_c;
+static void (*fp_mul_unr)(uint64_t *, const uint64_t *, const uint64_t *) = fp_muln;
+static void (*fp_rdc)(uint64_t *, const uint64_t *) = fp_rdc_c;
+
+void FP_select(int adx) {
+	if (adx) {
+		fp_mul = ARCH_fp_mul_adx;
+		fp_sqr = ARCH_fp_sqr_adx;
+		fp_mul_unr = ARCH_fp_muln_adx;
+		fp_rdc = ARCH_fp_rdcn_adx;
+	} else {
+		fp_mul = fp_mul_c;
+		fp_sqr = fp_sqr_c;
+		fp_mul_unr = fp_muln;
+		fp_rdc = fp_rdc_c;
+	}
+}
+
+void FP_copy(FP *r, const FP *a) {
+	memcpy(r->f, a->f, sizeof(r->f));
+}
+
+void FP_copy_sec(FP *r, const FP *a, int c) {
+	uint64_t m = (uint64_t)0 - (uint64_t)(c != 0);
+	int i;
+
+	/* No branch or address depends on c. */
+	for (i = 0; i < FP_DIGS; i++) {
+		r->f[i] ^= m & (r->f[i] ^ a->f[i]);
+	}
+}
+
+void FP_zero(FP *a) {
+	memset(a->f, 0, sizeof(a->f));
+}
+
+int FP_is_zero(const FP *a) {
+	uint64_t t = 0;
+	int i;
+
+	for (i = 0; i < FP_DIGS; i++) {
+		t |= a->f[i];
+	}
+	return t == 0;
+}
+
+int FP_cmp(const FP *a, const FP *b) {
+	uint64_t t = 0;
+	int i;
+
+	for (i = 0; i < FP_DIGS; i++) {
+		t |= a->f[i] ^ b->f[i];
+	}
+	return t != 0;
+}
+
+int FP_rand(FP *a) {
+	uint64_t t[FP_DIGS];
+
+	/* Sample 254-bit strings until one falls below p. */
+	do {
+		if (RAND_bytes((unsigned char *)a->f, sizeof(a->f)) != 1) {
+			return 0;
+		}
+		a->f[FP_DIGS - 1] &= 0x3FFFFFFFFFFFFFFFULL;
+	} while (fp_subn(t, a->f, prime, FP_DIGS) == 0);
+	return 1;
+}
+
+void FP_print(const FP *a) {
+	DV t;
+	FP c;
+	int i;
+
+	/* Leave Montgomery form before printing. */
+	memset(t.f, 0, sizeof(t.f));
+	memcpy(t.f, a->f, sizeof(a->f));
+	fp_rdcn(c.f, t.f);
+	for (i = FP_DIGS - 1; i >= 0; i--) {
+		printf("%016llX", (unsigned long long)c.f[i]);
+	}
+	printf("\n");
+}
+
+int FP_read_bn(FP *r, const BIGNUM *a) {
+	unsigned char buf[FP_DIGS * sizeof(uint64_t)];
+	int i, j, len;
+	FP t;
+
+	if (BN_is_negative(a) || BN_num_bytes(a) > (int)sizeof(buf)) {
+		return 0;
+	}
+	len = BN_num_bytes(a);
+	memset(buf, 0, sizeof(buf));
+	BN_bn2bin(a, buf + sizeof(buf) - len);
+
+	for (i = 0; i < FP_DIGS; i++) {
+		t.f[i] = 0;
+		for (j = 0; j < 8; j++) {
+			t.f[i] |= (uint64_t)buf[sizeof(buf) - 1 - (8 * i + j)] << (8 * j);
+		}
+	}
+	/* Multiplying by R^2 both reduces modulo p and converts to Montgomery form. */
+	FP_mul(r, &t, &conv);
+	return 1;
+}
+
+int FP_write_bn(BIGNUM *r, const FP *a) {
+	unsigned char buf[FP_DIGS * sizeof(uint64_t)];
+	DV t;
+	FP c;
+	int i, j;
+
+	memset(t.f, 0, sizeof(t.f));
+	memcpy(t.f, a->f, sizeof(a->f));
+	fp_rdcn(c.f, t.f);
+
+	for (i = 0; i < FP_DIGS; i++) {
+		for (j = 0; j < 8; j++) {
+			buf[sizeof(buf) - 1 - (8 * i + j)] = (unsigned char)(c.f[i] >> (8 * j));
+		}
+	}
+	return BN_bin2bn(buf, sizeof(buf), r) != NULL;
+}
+
+void FP_add(FP *r, const FP *a, const FP *b) {
+	uint64_t t[FP_DIGS], carry;
+
+	carry = fp_addn(t, a->f, b->f, FP_DIGS);
+	fp_subc(r->f, t, carry);
+}
+
+void FP_sub(FP *r, const FP *a, const FP *b) {
+	uint64_t t[FP_DIGS], mask;
+	int i;
+
+	mask = -fp_subn(r->f, a->f, b->f, FP_DIGS);
+	for (i = 0; i < FP_DIGS; i++) {
+		t[i] = prime[i] & mask;
+	}
+	fp_addn(r->f, r->f, t, FP_DIGS);
+}
+
+void FP_neg(FP *r, const FP *a) {
+	uint64_t mask;
+	int i;
+
+	/* Map zero to zero instead of p. */
+	mask = -(uint64_t)(!FP_is_zero(a));
+	fp_subn(r->f, prime, a->f, FP_DIGS);
+	for (i = 0; i < FP_DIGS; i++) {
+		r->f[i] &= mask;
+	}
+}
+
+void FP_dbl(FP *r, const FP *a) {
+	FP_add(r, a, a);
+}
+
+void FP_hlv(FP *r, const FP *a) {
+	uint64_t t[FP_DIGS], mask;
+	int i;
+
+	/* Make a even by adding p if needed, then shift. Since p < 2^254, no carry. */
+	mask = -(a->f[0] & 1);
+	for (i = 0; i < FP_DIGS; i++) {
+		t[i] = prime[i] & mask;
+	}
+	fp_addn(r->f, a->f, t, FP_DIGS);
+	for (i = 0; i < FP_DIGS - 1; i++) {
+		r->f[i] = (r->f[i] >> 1) | (r->f[i + 1] << 63);
+	}
+	r->f[FP_DIGS - 1] >>= 1;
+}
+
+void FP_mul(FP *r, const FP *a, const FP *b) {
+	fp_mul(r->f, a->f, b->f);
+}
+
+void FP_sqr(FP *r, const FP *a) {
+	fp_sqr(r->f, a->f);
+}
+
+void FP_mul_unr(DV *r, const FP *a, const FP *b) {
+	fp_mul_unr(r->f, a->f, b->f);
+}
+
+void FP_sqr_unr(DV *r, const FP *a) {
+	fp_sqrn(r->f, a->f);
+}
+
+void FP_rdc(FP *r, const DV *a) {
+	fp_rdc(r->f, a->f);
+}
+
+/*
+ * Inversion follows the constant-time safegcd algorithm of Bernstein and Yang,
+ * with the half-delta divsteps and 62-bit limbs of libsecp256k1. Ten batches
+ * of 59 divsteps are enough for any modulus below 2^256.
+ */
+
+#define M62		(UINT64_MAX >> 2)
+
+/* Transition matrix of a batch of divsteps, scaled by 2^62. */
+typedef struct {
+	int64_t u, v, q, r;
+} fp_trans;
+
+/*
+ * Runs 59 divsteps on the low bits of f and g, starting from zeta, and
+ * returns the new zeta. The matrix entries are kept unsigned so that they
+ * can be shifted left; they always fit in a signed 64-bit integer.
+ */
+static int64_t fp_divsteps(int64_t zeta, uint64_t f, uint64_t g, fp_trans *t) {
+	uint64_t u = 8, v = 0, q = 0, r = 8, m1, m2, x, y, z;
+	volatile uint64_t c1, c2;
+	int i;
+
+	for (i = 3; i < 62; i++) {
+		/* m1 = (zeta < 0), m2 = (g is odd). */
+		c1 = zeta >> 63;
+		m1 = c1;
+		c2 = g & 1;
+		m2 = -c2;
+		/* Add f, u, v to g, q, r with the sign of zeta, if g is odd. */
+		x = (f ^ m1) - m1;
+		y = (u ^ m1) - m1;
+		z = (v ^ m1) - m1;
+		g += x & m2;
+		q += y & m2;
+		r += z & m2;
+		/* If both hold, swap roles: zeta = -zeta - 2, f += g. */
+		m1 &= m2;
+		zeta = (zeta ^ (int64_t)m1) - 1;
+		f += g & m1;
+		u += q & m1;
+		v += r & m1;
+		g >>= 1;
+		u <<= 1;
+		v <<= 1;
+	}
+	t->u = (int64_t)u;
+	t->v = (int64_t)v;
+	t->q = (int64_t)q;
+	t->r = (int64_t)r;
+	return zeta;
+}
+
+/*
+ * Computes [d, e] = t * [d, e] / 2^62 mod p, adding the multiple of p that
+ * clears the low limb. Inputs and outputs lie in (-2p, p).
+ */
+static void fp_update_de(int64_t *d, int64_t *e, const fp_trans *t) {
+	const int64_t u = t->u, v = t->v, q = t->q, r = t->r;
+	int64_t md, me, sd, se;
+	int128_t cd, ce;
+	int i;
+
+	/* Start from [u, q] if d is negative and [v, r] if e is negative. */
+	sd = d[4] >> 63;
+	se = e[4] >> 63;
+	md = (u & sd) + (v & se);
+	me = (q & sd) + (r & se);
+	cd = (int128_t)u * d[0] + (int128_t)v * e[0];
+	ce = (int128_t)q * d[0] + (int128_t)r * e[0];
+	/* Correct md, me so that the low 62 bits vanish. */
+	md -= (prime62_inv * (uint64_t)cd + md) & M62;
+	me -= (prime62_inv * (uint64_t)ce + me) & M62;
+	cd += (int128_t)prime62[0] * md;
+	ce += (int128_t)prime62[0] * me;
+	cd >>= 62;
+	ce >>= 62;
+	for (i = 1; i < 5; i++) {
+		cd += (int128_t)u * d[i] + (int128_t)v * e[i];
+		ce += (int128_t)q * d[i] + (int128_t)r * e[i];
+		cd += (int128_t)prime62[i] * md;
+		ce += (int128_t)prime62[i] * me;
+		d[i - 1] = (int64_t)((uint64_t)cd & M62);
+		e[i - 1] = (int64_t)((uint64_t)ce & M62);
+		cd >>= 62;
+		ce >>= 62;
+	}
+	d[4] = (int64_t)cd;
+	e[4] = (int64_t)ce;
+}
+
+/* Computes [f, g] = t * [f, g] / 2^62, which is exact. */
+static void fp_update_fg(int64_t *f, int64_t *g, const fp_trans *t) {
+	const int64_t u = t->u, v = t->v, q = t->q, r = t->r;
+	int128_t cf, cg;
+	int i;
+
+	cf = (int128_t)u * f[0] + (int128_t)v * g[0];
+	cg = (int128_t)q * f[0] + (int128_t)r * g[0];
+	cf >>= 62;
+	cg >>= 62;
+	for (i = 1; i < 5; i++) {
+		cf += (int128_t)u * f[i] + (int128_t)v * g[i];
+		cg += (int128_t)q * f[i] + (int128_t)r * g[i];
+		f[i - 1] = (int64_t)((uint64_t)cf & M62);
+		g[i - 1] = (int64_t)((uint64_t)cg & M62);
+		cf >>= 62;
+		cg >>= 62;
+	}
+	f[4] = (int64_t)cf;
+	g[4] = (int64_t)cg;
+}
+
+/* Propagates signed carries so that limbs 0 to 3 lie in [0, 2^62). */
+static void fp_carry62(int64_t *d) {
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		d[i + 1] += d[i] >> 62;
+		d[i] &= (int64_t)M62;
+	}
+}
+
+/* Brings d from (-2p, p) into [0, p), negating it first if sign < 0. */
+static void fp_norm62(int64_t *d, int64_t sign) {
+	int64_t m;
+	int i;
+
+	m = d[4] >> 63;
+	for (i = 0; i < 5; i++) {
+		d[i] += prime62[i] & m;
+	}
+	m = sign >> 63;
+	for (i = 0; i < 5; i++) {
+		d[i] = (d[i] ^ m) - m;
+	}
+	fp_carry62(d);
+	m = d[4] >> 63;
+	for (i = 0; i < 5; i++) {
+		d[i] += prime62[i] & m;
+	}
+	fp_carry62(d);
+}
+
+int FP_inv(FP *r, const FP *a) {
+	int64_t d[5] = { 0, 0, 0, 0, 0 }, e[5] = { 1, 0, 0, 0, 0 }, f[5], g[5];
+	int64_t zeta = -1;
+	fp_trans t;
+	int i;
+
+	if (FP_is_zero(a)) {
+		return 0;
+	}
+
+	for (i = 0; i < 5; i++) {
+		f[i] = prime62[i];
+	}
+	g[0] = a->f[0] & M62;
+	g[1] = ((a->f[0] >> 62) | (a->f[1] << 2)) & M62;
+	g[2] = ((a->f[1] >> 60) | (a->f[2] << 4)) & M62;
+	g[3] = ((a->f[2] >> 58) | (a->f[3] << 6)) & M62;
+	g[4] = a->f[3] >> 56;
+
+	/* Afterwards g = 0, f = +-1 and d = +-(aR)^{-1} mod p. */
+	for (i = 0; i < 10; i++) {
+		zeta = fp_divsteps(zeta, f[0], g[0], &t);
+		fp_update_de(d, e, &t);
+		fp_update_fg(f, g, &t);
+	}
+	fp_norm62(d, f[4]);
+
+	r->f[0] = (uint64_t)d[0] | ((uint64_t)d[1] << 62);
+	r->f[1] = ((uint64_t)d[1] >> 2) | ((uint64_t)d[2] << 60);
+	r->f[2] = ((uint64_t)d[2] >> 4) | ((uint64_t)d[3] << 58);
+	r->f[3] = ((uint64_t)d[3] >> 6) | ((uint64_t)d[4] << 56);
+
+	/* Montgomery multiplication by R^3 yields a^{-1}R. */
+	FP_mul(r, r, &conv3);
+	return 1;
+}
+
+/*
+ * Inverts n elements with a single inversion, using Montgomery's trick. Zero
+ * entries are left as zero and do not disturb the others. The output may
+ * alias the input; p needs room for n prefix products.
+ */
+int FP_inv_batch_buf(FP *r, const FP *a, int n, FP *p) {
+	FP t, v;
+	int i, k = -1;
+
+	/* p[i] is the product of the nonzero entries before a[i], k the first. */
+	for (i = 0; i < n; i++) {
+		if (FP_is_zero(&a[i])) {
+			continue;
+		}
+		if (k < 0) {
+			FP_copy(&t, &a[i]);
+			k = i;
+		} else {
+			FP_copy(&p[i], &t);
+			FP_mul(&t, &t, &a[i]);
+		}
+	}
+
+	if (k >= 0) {
+		FP_inv(&t, &t);
+	}
+	for (i = n - 1; i >= 0; i--) {
+		if (FP_is_zero(&a[i])) {
+			FP_zero(&r[i]);
+		} else if (i == k) {
+			FP_copy(&r[i], &t);
+		} else {
+			/* Read a[i] before r[i] is written, in case they alias. */
+			FP_mul(&v, &t, &p[i]);
+			FP_mul(&t, &t, &a[i]);
+			FP_copy(&r[i], &v);
+		}
+	}
+	return 1;
+}
+
+int FP_inv_batch(FP *r, const FP *a, int n) {
+	FP sp[INV_STACK], *p = NULL;
+	int ret;
+
+	if (n <= 0) {
+		return 1;
+	}
+	if (n <= INV_STACK) {
+		p = sp;
+	} else if ((p = OPENSSL_malloc(n * sizeof(FP))) == NULL) {
+		return 0;
+	}
+	ret = FP_inv_batch_buf(r, a, n, p);
+	if (p != sp) {
+		OPENSSL_free(p);
+	}
+	return ret;
+}
+
+void DV_copy(DV *r, const DV *a) {
+	memcpy(r->f, a->f, sizeof(r->f));
+}
+
+void DV_zero(DV *a) {
+	memset(a->f, 0, sizeof(a->f));
+}
+
+/*
+ * Double-precision values are kept in [0, p * 2^256), the input range of
+ * Montgomery reduction, so additions and subtractions are performed modulo
+ * p * 2^256 by correcting only the upper half.
+ */
+
+void DV_add(DV *r, const DV *a, const DV *b) {
+	ARCH_dv_add(r->f, a->f, b->f);
+}
+
+void DV_sub(DV *r, const DV *a, const DV *b) {
+	ARCH_dv_sub(r->f, a->f, b->f);
+}
@@ -106,7 +106,7 @@ int FP12_neg(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
 	return 1;
 }
 
-int FP12_mul(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b, BN_CTX *ctx) {
+int FP12_mul(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b) {
 	FP6 t0, t1, t2;
 	int ret = 0;
 
@@ -117,11 +117,11 @@ int FP12_mul(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b,
 	/* Karatsuba algorithm. */
 
 	/* t0 = a_0 * b_0. */
-	if (!FP6_mul(group, &t0, &a->f[0], &b->f[0], ctx)) {
+	if (!FP6_mul(group, &t0, &a->f[0], &b->f[0])) {
 		goto err;
 	}
 	/* t1 = a_1 * b_1. */
-	if (!FP6_mul(group, &t1, &a->f[1], &b->f[1], ctx)) {
+	if (!FP6_mul(group, &t1, &a->f[1], &b->f[1])) {
 		goto err;
 	}
 	/* t2 = b_0 + b_1. */
@@ -135,7 +135,7 @@ int FP12_mul(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b,
 	}
 
 	/* c_1 = (a_0 + a_1) * (b_0 + b_1) */
-	if (!FP6_mul(group, &r->f[1], &r->f[1], &t2, ctx)) {
+	if (!FP6_mul(group, &r->f[1], &r->f[1], &t2)) {
 		goto err;
 	}
 	if (!FP6_sub(group, &r->f[1], &r->f[1], &t0)) {
@@ -146,7 +146,7 @@ int FP12_mul(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b,
 	}
 
 	/* c_0 = a_0b_0 + v * a_1b_1. */
-	if (!FP6_mul_art(group, &t1, &t1, ctx)) {
+	if (!FP6_mul_art(group, &t1, &t1)) {
 		goto err;
 	}
 	if (!FP6_add(group, &r->f[0], &t0, &t1)) {
@@ -162,7 +162,7 @@ err:
 	return ret;
 }
 
-int FP12_mul_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b, BN_CTX *ctx) {
+int FP12_mul_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b) {
 	FP6 t0, t1, t2;
 	int ret = 0;
 
@@ -171,13 +171,13 @@ int FP12_mul_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12
 	FP6_init(&t2);
 
 	/* t0 = a_0 * b_0 */
-	if (!FP2_mul(group, &t0.f[0], &a->f[0].f[0], &b->f[0].f[0], ctx)) {
+	if (!FP2_mul(group, &t0.f[0], &a->f[0].f[0], &b->f[0].f[0])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &t0.f[1], &a->f[0].f[1], &b->f[0].f[0], ctx)) {
+	if (!FP2_mul(group, &t0.f[1], &a->f[0].f[1], &b->f[0].f[0])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &t0.f[2], &a->f[0].f[2], &b->f[0].f[0], ctx)) {
+	if (!FP2_mul(group, &t0.f[2], &a->f[0].f[2], &b->f[0].f[0])) {
 		goto err;
 	}
 
@@ -188,7 +188,7 @@ int FP12_mul_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12
 	FP2_copy(&t2.f[1], &b->f[1].f[1]);
 
 	/* t1 = a_1 * b_1. */
-	if (!FP6_mul_dxs(group, &t1, &a->f[1], &b->f[1], ctx)) {
+	if (!FP6_mul_dxs(group, &t1, &a->f[1], &b->f[1])) {
 		goto err;
 	}
 	/* c_1 = a_0 + a_1. */
@@ -196,7 +196,7 @@ int FP12_mul_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12
 		goto err;
 	}
 	/* c_1 = (a_0 + a_1) * (b_0 + b_1) - a_0 * b_0 - a_1 * b_1. */
-	if (!FP6_mul_dxs(group, &r->f[1], &r->f[1], &t2, ctx)) {
+	if (!FP6_mul_dxs(group, &r->f[1], &r->f[1], &t2)) {
 		goto err;
 	}
 	if (!FP6_sub(group, &r->f[1], &r->f[1], &t0)) {
@@ -206,7 +206,7 @@ int FP12_mul_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12
 		goto err;
 	}
 	/* c_0 = a_0 * b_0 + v * a_1 * b_1. */
-	if (!FP6_mul_art(group, &t1, &t1, ctx)) {
+	if (!FP6_mul_art(group, &t1, &t1)) {
 		goto err;
 	}
 	if (!FP6_add(group, &r->f[0], &t0, &t1)) {
@@ -221,35 +221,173 @@ err:
 	return ret;
 }
 
-int FP12_inv(const PAIRING_GROUP *group, FP12 *c, const FP12 *a, BN_CTX *ctx) {
+int FP12_mul_lzr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b) {
+	FP6 t0, t1;
+	DV6 u0, u1, u2;
+
+	/* Karatsuba algorithm, reducing each coefficient only once. */
+
+	/* u0 = a_0 * b_0, u1 = a_1 * b_1. */
+	FP6_mul_unr(group, &u0, &a->f[0], &b->f[0]);
+	FP6_mul_unr(group, &u1, &a->f[1], &b->f[1]);
+
+	/* u2 = (a_0 + a_1) * (b_0 + b_1). */
+	FP6_add(group, &t0, &a->f[0], &a->f[1]);
+	FP6_add(group, &t1, &b->f[0], &b->f[1]);
+	FP6_mul_unr(group, &u2, &t0, &t1);
+
+	/* c_1 = u2 - u0 - u1. */
+	DV6_sub(&u2, &u2, &u0);
+	DV6_sub(&u2, &u2, &u1);
+	FP6_rdc(group, &r->f[1], &u2);
+
+	/* c_0 = u0 + v * u1. */
+	DV6_mul_art(&u1, &u1);
+	DV6_add(&u0, &u0, &u1);
+	FP6_rdc(group, &r->f[0], &u0);
+
+	return 1;
+}
+
+int FP12_mul_dxs_lzr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b) {
+	FP6 t0, t1;
+	DV6 u0, u1, u2;
+
+	/* u0 = a_0 * b_0, with b_0 = b_00. */
+	FP2_mul_unr(group, &u0.f[0], &a->f[0].f[0], &b->f[0].f[0]);
+	FP2_mul_unr(group, &u0.f[1], &a->f[0].f[1], &b->f[0].f[0]);
+	FP2_mul_unr(group, &u0.f[2], &a->f[0].f[2], &b->f[0].f[0]);
+
+	/* u1 = a_1 * b_1, with b_1 = b_10 + b_11 * v. */
+	FP6_mul_dxs_unr(group, &u1, &a->f[1], &b->f[1]);
+
+	/* u2 = (a_0 + a_1) * (b_0 + b_1). */
+	FP6_add(group, &t0, &a->f[0], &a->f[1]);
+	FP2_add(group, &t1.f[0], &b->f[0].f[0], &b->f[1].f[0]);
+	FP2_copy(&t1.f[1], &b->f[1].f[1]);
+	FP6_mul_dxs_unr(group, &u2, &t0, &t1);
+
+	/* c_1 = u2 - u0 - u1. */
+	DV6_sub(&u2, &u2, &u0);
+	DV6_sub(&u2, &u2, &u1);
+	FP6_rdc(group, &r->f[1], &u2);
+
+	/* c_0 = u0 + v * u1. */
+	DV6_mul_art(&u1, &u1);
+	DV6_add(&u0, &u0, &u1);
+	FP6_rdc(group, &r->f[0], &u0);
+
+	return 1;
+}
+
+int FP12_mul_dxs_dxs(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b) {
+	FP2 t0, t1;
+	DV2 u0, u1, u3, v1, v3, v4;
+
+	/*
+	 * Both lines are l_0 + l_1 * w + l_3 * w^3, so the product only leaves
+	 * the coefficient of w^5 empty. Karatsuba on the three pairs.
+	 */
+
+	/* u0 = a_0 * b_0, u1 = a_1 * b_1, u3 = a_3 * b_3. */
+	FP2_mul_unr(group, &u0, &a->f[0].f[0], &b->f[0].f[0]);
+	FP2_mul_unr(group, &u1, &a->f[1].f[0], &b->f[1].f[0]);
+	FP2_mul_unr(group, &u3, &a->f[1].f[1], &b->f[1].f[1]);
+
+	/* v1 = a_0 * b_1 + a_1 * b_0. */
+	FP2_add(group, &t0, &a->f[0].f[0], &a->f[1].f[0]);
+	FP2_add(group, &t1, &b->f[0].f[0], &b->f[1].f[0]);
+	FP2_mul_unr(group, &v1, &t0, &t1);
+	DV2_sub(&v1, &v1, &u0);
+	DV2_sub(&v1, &v1, &u1);
+
+	/* v3 = a_0 * b_3 + a_3 * b_0. */
+	FP2_add(group, &t0, &a->f[0].f[0], &a->f[1].f[1]);
+	FP2_add(group, &t1, &b->f[0].f[0], &b->f[1].f[1]);
+	FP2_mul_unr(group, &v3, &t0, &t1);
+	DV2_sub(&v3, &v3, &u0);
+	DV2_sub(&v3, &v3, &u3);
+
+	/* v4 = a_1 * b_3 + a_3 * b_1. */
+	FP2_add(group, &t0, &a->f[1].f[0], &a->f[1].f[1]);
+	FP2_add(group, &t1, &b->f[1].f[0], &b->f[1].f[1]);
+	FP2_mul_unr(group, &v4, &t0, &t1);
+	DV2_sub(&v4, &v4, &u1);
+	DV2_sub(&v4, &v4, &u3);
+
+	/* w^6 = E, so c_0 = u0 + E * u3. */
+	DV2_mul_nor(&u3, &u3);
+	DV2_add(&u0, &u0, &u3);
+
+	FP2_rdc(group, &r->f[0].f[0], &u0);
+	FP2_rdc(group, &r->f[0].f[1], &u1);
+	FP2_rdc(group, &r->f[0].f[2], &v4);
+	FP2_rdc(group, &r->f[1].f[0], &v1);
+	FP2_rdc(group, &r->f[1].f[1], &v3);
+	FP2_zero(&r->f[1].f[2]);
+
+	return 1;
+}
+
+int FP12_mul_dxd_lzr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const FP12 *b) {
+	FP6 t0, t1;
+	DV6 u0, u1, u2;
+
+	/* Same as FP12_mul_lzr, but b_12 = 0 as left by FP12_mul_dxs_dxs. */
+
+	/* u0 = a_0 * b_0, u1 = a_1 * b_1. */
+	FP6_mul_unr(group, &u0, &a->f[0], &b->f[0]);
+	FP6_mul_dxs_unr(group, &u1, &a->f[1], &b->f[1]);
+
+	/* u2 = (a_0 + a_1) * (b_0 + b_1). */
+	FP6_add(group, &t0, &a->f[0], &a->f[1]);
+	FP2_add(group, &t1.f[0], &b->f[0].f[0], &b->f[1].f[0]);
+	FP2_add(group, &t1.f[1], &b->f[0].f[1], &b->f[1].f[1]);
+	FP2_copy(&t1.f[2], &b->f[0].f[2]);
+	FP6_mul_unr(group, &u2, &t0, &t1);
+
+	/* c_1 = u2 - u0 - u1. */
+	DV6_sub(&u2, &u2, &u0);
+	DV6_sub(&u2, &u2, &u1);
+	FP6_rdc(group, &r->f[1], &u2);
+
+	/* c_0 = u0 + v * u1. */
+	DV6_mul_art(&u1, &u1);
+	DV6_add(&u0, &u0, &u1);
+	FP6_rdc(group, &r->f[0], &u0);
+
+	return 1;
+}
+
+int FP12_inv(const PAIRING_GROUP *group, FP12 *c, const FP12 *a) {
 	FP6 t0, t1;
 	int ret = 0;
 
 	FP6_init(&t0);
 	FP6_init(&t1);
 
-	if (!FP6_sqr(group, &t0, &a->f[0], ctx)) {
+	if (!FP6_sqr(group, &t0, &a->f[0])) {
 		goto err;
 	}
-	if (!FP6_sqr(group, &t1, &a->f[1], ctx)) {
+	if (!FP6_sqr(group, &t1, &a->f[1])) {
 		goto err;
 	}	
-	if (!FP6_mul_art(group, &t1, &t1, ctx)) {
+	if (!FP6_mul_art(group, &t1, &t1)) {
 		goto err;
 	}
 	if (!FP6_sub(group, &t0, &t0, &t1)) {
 		goto err;
 	}
-	if (!FP6_inv(group, &t0, &t0, ctx)) {
+	if (!FP6_inv(group, &t0, &t0)) {
 		goto err;
 	}
-	if (!FP6_mul(group, &c->f[0], &a->f[0], &t0, ctx)) {
+	if (!FP6_mul(group, &c->f[0], &a->f[0], &t0)) {
 		goto err;
 	}
 	if (!FP6_neg(group, &c->f[1], &a->f[1])) {
 		goto err;
 	}
-	if (!FP6_mul(group, &c->f[1], &c->f[1], &t0, ctx)) {
+	if (!FP6_mul(group, &c->f[1], &c->f[1], &t0)) {
 		goto err;
 	}
 
@@ -261,7 +399,75 @@ err:
 	return ret;
 }
 
-int FP12_inv_uni(const PAIRING_GROUP *group, FP12 *c, const FP12 *a, BN_CTX *ctx) {
+int FP12_inv_batch(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, int n) {
+	FP6 sv[INV_STACK], *v = sv, t0, t1;
+	FP2 st[INV_STACK], *t = st, u;
+	FP sd[INV_STACK], *d = sd, w;
+	int i, j, ret = 0;
+
+	if (n <= 0) {
+		return 1;
+	}
+	if (n > INV_STACK) {
+		v = OPENSSL_malloc(n * sizeof(FP6));
+		t = OPENSSL_malloc(n * sizeof(FP2));
+		d = OPENSSL_malloc(n * sizeof(FP));
+		if (v == NULL || t == NULL || d == NULL) {
+			goto err;
+		}
+	}
+
+	/*
+	 * Follow FP12_inv and FP6_inv down the tower, but stop at the norm d[i]
+	 * of each element to Fp, so that one batched inversion serves them all.
+	 * A zero element has a zero norm and so comes out as zero.
+	 */
+	for (i = 0; i < n; i++) {
+		if (!FP6_sqr(group, &t0, &a[i].f[0]) || !FP6_sqr(group, &t1, &a[i].f[1])) {
+			goto err;
+		}
+		if (!FP6_mul_art(group, &t1, &t1) || !FP6_sub(group, &t0, &t0, &t1)) {
+			goto err;
+		}
+		if (!FP6_inv_adj(group, &v[i], &t[i], &t0)) {
+			goto err;
+		}
+		FP_sqr(&d[i], &t[i].f[0]);
+		FP_sqr(&w, &t[i].f[1]);
+		FP_add(&d[i], &d[i], &w);
+	}
+	if (!FP_inv_batch(d, d, n)) {
+		goto err;
+	}
+	for (i = 0; i < n; i++) {
+		/* t^-1 = conj(t) / d, then (a_0^2 - v * a_1^2)^-1 = v[i] * t^-1. */
+		FP_mul(&u.f[0], &t[i].f[0], &d[i]);
+		FP_mul(&u.f[1], &t[i].f[1], &d[i]);
+		FP_neg(&u.f[1], &u.f[1]);
+		for (j = 0; j < 3; j++) {
+			if (!FP2_mul(group, &t0.f[j], &v[i].f[j], &u)) {
+				goto err;
+			}
+		}
+		if (!FP6_mul(group, &r[i].f[0], &a[i].f[0], &t0)) {
+			goto err;
+		}
+		if (!FP6_neg(group, &t1, &a[i].f[1]) || !FP6_mul(group, &r[i].f[1], &t1, &t0)) {
+			goto err;
+		}
+	}
+
+	ret = 1;
+err:
+	if (v != sv) {
+		OPENSSL_free(v);
+		OPENSSL_free(t);
+		OPENSSL_free(d);
+	}
+	return ret;
+}
+
+int FP12_inv_uni(const PAIRING_GROUP *group, FP12 *c, const FP12 *a) {
 	FP6_copy(&c->f[0], &a->f[0]);
 	if (!FP6_neg(group, &c->f[1], &a->f[1])) {
 		return 0;
@@ -269,7 +475,63 @@ int FP12_inv_uni(const PAIRING_GROUP *group, FP12 *c, const FP12 *a, BN_CTX *ctx
 	return 1;
 }
 
-int FP12_frb(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx) {
+int FP12_frb(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
+	int ret = 0;
+	if (!FP2_inv_uni(group, &r->f[0].f[0], &a->f[0].f[0])) {
+		goto err;
+	}
+	if (!FP2_inv_uni(group, &r->f[1].f[0], &a->f[1].f[0])) {
+		goto err;
+	}
+	if (!FP2_inv_uni(group, &r->f[0].f[1], &a->f[0].f[1])) {
+		goto err;
+	}
+	if (!FP2_inv_uni(group, &r->f[1].f[1], &a->f[1].f[1])) {
+		goto err;
+	}
+	if (!FP2_inv_uni(group, &r->f[0].f[2], &a->f[0].f[2])) {
+		goto err;
+	}
+	if (!FP2_inv_uni(group, &r->f[1].f[2], &a->f[1].f[2])) {
+		goto err;
+	}
+	if (!FP2_mul_frb(group, &r->f[1].f[0], &r->f[1].f[0], 1)) {
+		goto err;
+	}
+	if (!FP2_mul_frb(group, &r->f[0].f[1], &r->f[0].f[1], 2)) {
+		goto err;
+	}
+	if (!FP2_mul_frb(group, &r->f[1].f[1], &r->f[1].f[1], 3)) {
+		goto err;
+	}
+	if (!FP2_mul_frb(group, &r->f[0].f[2], &r->f[0].f[2], 4)) {
+		goto err;
+	}
+	if (!FP2_mul_frb(group, &r->f[1].f[2], &r->f[1].f[2], 5)) {
+		goto err;
+	}
+	ret = 1;
+err:
+	return ret;
+}
+
+int FP12_frb2(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
+	/* The p^2-power constants are in Fp and conjugation cancels out. */
+	FP12_copy(r, a);
+	FP_mul(&r->f[1].f[0].f[0], &r->f[1].f[0].f[0], &group->frb[1][0].f[0]);
+	FP_mul(&r->f[1].f[0].f[1], &r->f[1].f[0].f[1], &group->frb[1][0].f[0]);
+	FP_mul(&r->f[0].f[1].f[0], &r->f[0].f[1].f[0], &group->frb[1][1].f[0]);
+	FP_mul(&r->f[0].f[1].f[1], &r->f[0].f[1].f[1], &group->frb[1][1].f[0]);
+	FP_mul(&r->f[1].f[1].f[0], &r->f[1].f[1].f[0], &group->frb[1][2].f[0]);
+	FP_mul(&r->f[1].f[1].f[1], &r->f[1].f[1].f[1], &group->frb[1][2].f[0]);
+	FP_mul(&r->f[0].f[2].f[0], &r->f[0].f[2].f[0], &group->frb[1][3].f[0]);
+	FP_mul(&r->f[0].f[2].f[1], &r->f[0].f[2].f[1], &group->frb[1][3].f[0]);
+	FP_mul(&r->f[1].f[2].f[0], &r->f[1].f[2].f[0], &group->frb[1][4].f[0]);
+	FP_mul(&r->f[1].f[2].f[1], &r->f[1].f[2].f[1], &group->frb[1][4].f[0]);
+	return 1;
+}
+
+int FP12_frb3(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
 	int ret = 0;
 	if (!FP2_inv_uni(group, &r->f[0].f[0], &a->f[0].f[0])) {
 		goto err;
@@ -289,19 +551,19 @@ int FP12_frb(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx) {
 	if (!FP2_inv_uni(group, &r->f[1].f[2], &a->f[1].f[2])) {
 		goto err;
 	}
-	if (!FP2_mul_frb(group, &r->f[1].f[0], &r->f[1].f[0], 1, ctx)) {
+	if (!FP2_mul(group, &r->f[1].f[0], &r->f[1].f[0], &group->frb[2][0])) {
 		goto err;
 	}
-	if (!FP2_mul_frb(group, &r->f[0].f[1], &r->f[0].f[1], 2, ctx)) {
+	if (!FP2_mul(group, &r->f[0].f[1], &r->f[0].f[1], &group->frb[2][1])) {
 		goto err;
 	}
-	if (!FP2_mul_frb(group, &r->f[1].f[1], &r->f[1].f[1], 3, ctx)) {
+	if (!FP2_mul(group, &r->f[1].f[1], &r->f[1].f[1], &group->frb[2][2])) {
 		goto err;
 	}
-	if (!FP2_mul_frb(group, &r->f[0].f[2], &r->f[0].f[2], 4, ctx)) {
+	if (!FP2_mul(group, &r->f[0].f[2], &r->f[0].f[2], &group->frb[2][3])) {
 		goto err;
 	}
-	if (!FP2_mul_frb(group, &r->f[1].f[2], &r->f[1].f[2], 5, ctx)) {
+	if (!FP2_mul(group, &r->f[1].f[2], &r->f[1].f[2], &group->frb[2][4])) {
 		goto err;
 	}
 	ret = 1;
@@ -309,29 +571,26 @@ err:
 	return ret;
 }
 
-int FP12_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx) {
+int FP12_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
 	FP12 t;
 	int ret = 0;
 
 	FP12_init(&t);
 
-	if (!FP12_inv(group, &t, a, ctx)) {
+	if (!FP12_inv(group, &t, a)) {
 		goto err;
 	}
-	if (!FP12_inv_uni(group, r, a, ctx)) {
+	if (!FP12_inv_uni(group, r, a)) {
 		goto err;
 	}
-	if (!FP12_mul(group, r, r, &t, ctx)) {
+	if (!FP12_mul_lzr(group, r, r, &t)) {
 		goto err;
 	}
 
-	if (!FP12_frb(group, &t, r, ctx)) {
-		goto err;
-	}	
-	if (!FP12_frb(group, &t, &t, ctx)) {
+	if (!FP12_frb2(group, &t, r)) {
 		goto err;
 	}
-	if (!FP12_mul(group, r, r, &t, ctx)) {
+	if (!FP12_mul_lzr(group, r, r, &t)) {
 		goto err;
 	}
 
@@ -341,44 +600,116 @@ err:
 	return ret;
 }
 
-int FP12_exp_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx) {
-	int i, ret = 0;
-	FP12 t0, t1;
-
-	FP12_init(&t0);
-	FP12_init(&t1);
-
-	FP12_copy(&t0, a);
-	for (i = 0; i < 55; i++) {
-		if (!FP12_sqr_pck(group, &t0, &t0, ctx)) {
-			goto err;
+/*
+ * Raises a cyclotomic a to the exponent whose set bits are the w increasing
+ * positions in b, using compressed squarings. The intermediate values that
+ * enter the product are decompressed together, sharing one inversion.
+ */
+static int fp12_exp_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const int *b, int w) {
+	FP12 t, u[EXP_PCK];
+	int i, j, k = 0, ret = 0;
+
+	FP12_copy(&t, a);
+	for (i = 0, j = 0; j < w; j++) {
+		if (b[j] == 0) {
+			continue;
+		}
+		for (; i < b[j]; i++) {
+			if (!FP12_sqr_pck(group, &t, &t)) {
+				goto err;
+			}
 		}
+		FP12_copy(&u[k++], &t);
+	}
+	if (!FP12_back_sim(group, u, u, k)) {
+		goto err;
 	}
-	FP12_copy(&t1, &t0);
-	for (i = 55; i < 62; i++) {
-		if (!FP12_sqr_pck(group, &t1, &t1, ctx)) {
+
+	if (w > 0 && b[0] == 0) {
+		FP12_copy(&t, a);
+	} else {
+		FP12_zero(&t);
+		FP_copy(&t.f[0].f[0].f[0], &group->one);
+	}
+	for (j = 0; j < k; j++) {
+		if (!FP12_mul_lzr(group, &t, &t, &u[j])) {
 			goto err;
 		}
 	}
-	if (!FP12_back(group, &t0, &t1, &t0, &t1, ctx)) {
-		goto err;
+	FP12_copy(r, &t);
+
+	ret = 1;
+err:
+	return ret;
+}
+
+int FP12_exp_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
+	/* |x| = 2^62 + 2^55 + 1. */
+	static const int b[] = { 0, 55, 62 };
+
+	return fp12_exp_pck(group, r, a, b, 3);
+}
+
+/*
+ * Rough costs in Fp2 multiplications of one compressed squaring, one
+ * Granger-Scott squaring, one decompression (with its share of the batched
+ * inversion) and the shared inversion itself.
+ */
+#define COST_PCK	5
+#define COST_SQR	7
+#define COST_BACK	10
+#define COST_INV	100
+
+int FP12_exp_cyc_gen(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const BIGNUM *e) {
+	FP12 t;
+	int b[EXP_PCK + 1];
+	int i, bits, w = 0, ret = 0;
+
+	if (BN_is_zero(e)) {
+		FP12_zero(r);
+		FP_copy(&r->f[0].f[0].f[0], &group->one);
+		return 1;
 	}
 
-	if (!FP12_mul(group, &t0, &t0, &t1, ctx)) {
-		goto err;
+	bits = BN_num_bits(e);
+	for (i = 0; i < bits; i++) {
+		w += BN_is_bit_set(e, i);
+	}
+
+	/* Compressed squarings pay off while few values need decompressing. */
+	if (w <= EXP_PCK && (bits - 1) * COST_PCK + w * COST_BACK + COST_INV < (bits - 1) * COST_SQR) {
+		for (i = 0, w = 0; i < bits; i++) {
+			if (BN_is_bit_set(e, i)) {
+				b[w++] = i;
+			}
+		}
+		if (!fp12_exp_pck(group, r, a, b, w)) {
+			goto err;
+		}
+	} else {
+		FP12_copy(&t, a);
+		for (i = bits - 2; i >= 0; i--) {
+			if (!FP12_sqr_cyc(group, &t, &t)) {
+				goto err;
+			}
+			if (BN_is_bit_set(e, i) && !FP12_mul_lzr(group, &t, &t, a)) {
+				goto err;
+			}
+		}
+		FP12_copy(r, &t);
 	}
-	if (!FP12_mul(group, r, &t0, a, ctx)) {
+
+	/* Inversion is conjugation in the cyclotomic subgroup. */
+	if (BN_is_negative(e) && !FP12_inv_uni(group, r, r)) {
 		goto err;
 	}
 
 	ret = 1;
 err:
-	FP12_free(&t0);
-	FP12_free(&t1);
 	return ret;
 }
 
-int FP12_sqr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx) {
+int FP12_sqr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
 	FP6 t0, t1;
 	int ret = 0;
 
@@ -392,22 +723,22 @@ int FP12_sqr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx) {
 	if (!FP6_add(group, &t0, &a->f[0], &a->f[1])) {
 		goto err;
 	}
-	if (!FP6_mul_art(group, &t1, &a->f[1], ctx)) {
+	if (!FP6_mul_art(group, &t1, &a->f[1])) {
 		goto err;
 	}
 	if (!FP6_add(group, &t1, &a->f[0], &t1)) {
 		goto err;
 	}
-	if (!FP6_mul(group, &t0, &t0, &t1, ctx)) {
+	if (!FP6_mul(group, &t0, &t0, &t1)) {
 		goto err;
 	}
-	if (!FP6_mul(group, &r->f[1], &a->f[0], &a->f[1], ctx)) {
+	if (!FP6_mul(group, &r->f[1], &a->f[0], &a->f[1])) {
 		goto err;
 	}
 	if (!FP6_sub(group, &r->f[0], &t0, &r->f[1])) {
 		goto err;
 	}
-	if (!FP6_mul_art(group, &t1, &r->f[1], ctx)) {
+	if (!FP6_mul_art(group, &t1, &r->f[1])) {
 		goto err;
 	}
 	if (!FP6_sub(group, &r->f[0], &r->f[0], &t1)) {
@@ -423,9 +754,68 @@ err:
 	return ret;
 }
 
-int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx) {
+int FP12_sqr_lzr(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
+	FP6 t0, t1;
+	DV6 u0, u1, u2;
+
+	/* u0 = (a_0 + a_1) * (a_0 + v * a_1), u1 = a_0 * a_1. */
+	FP6_add(group, &t0, &a->f[0], &a->f[1]);
+	FP6_mul_art(group, &t1, &a->f[1]);
+	FP6_add(group, &t1, &a->f[0], &t1);
+	FP6_mul_unr(group, &u0, &t0, &t1);
+	FP6_mul_unr(group, &u1, &a->f[0], &a->f[1]);
+
+	/* c_0 = u0 - u1 - v * u1. */
+	DV6_mul_art(&u2, &u1);
+	DV6_sub(&u0, &u0, &u1);
+	DV6_sub(&u0, &u0, &u2);
+	FP6_rdc(group, &r->f[0], &u0);
+
+	/* c_1 = 2 * u1. */
+	DV6_add(&u1, &u1, &u1);
+	FP6_rdc(group, &r->f[1], &u1);
+
+	return 1;
+}
+
+int FP12_sqr_cyc(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
+	FP2 t0, t1, t2, t3, c0, c1;
+
+	/*
+	 * Granger-Scott squaring: for a in the cyclotomic subgroup, each of the
+	 * Fp4 pairs (g0, g1), (g4, g5) and (g2, g3) is squared with three Fp2
+	 * squarings. The last two pairs are shared with FP12_sqr_pck.
+	 */
+
+	/* t0 = g0^2 + E * g1^2, t1 = 2 * g0 * g1. */
+	FP2_sqr(group, &t2, &a->f[0].f[0]);
+	FP2_sqr(group, &t3, &a->f[1].f[1]);
+	FP2_add(group, &t1, &a->f[0].f[0], &a->f[1].f[1]);
+	FP2_mul_nor(group, &t0, &t3);
+	FP2_add(group, &t0, &t0, &t2);
+	FP2_sqr(group, &t1, &t1);
+	FP2_sub(group, &t1, &t1, &t2);
+	FP2_sub(group, &t1, &t1, &t3);
+
+	/* c0 = 3 * t0 - 2 * g0, c1 = 3 * t1 + 2 * g1. */
+	FP2_sub(group, &c0, &t0, &a->f[0].f[0]);
+	FP2_add(group, &c0, &c0, &c0);
+	FP2_add(group, &c0, &c0, &t0);
+	FP2_add(group, &c1, &t1, &a->f[1].f[1]);
+	FP2_add(group, &c1, &c1, &c1);
+	FP2_add(group, &c1, &c1, &t1);
+
+	if (!FP12_sqr_pck(group, r, a)) {
+		return 0;
+	}
+	FP2_copy(&r->f[0].f[0], &c0);
+	FP2_copy(&r->f[1].f[1], &c1);
+	return 1;
+}
+
+int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a) {
 	FP2 t0, t1, t2, t3, t4, t5, t6;
-	int ret;
+	int ret = 0;
 
 	FP2_init(&t0);
 	FP2_init(&t1);
@@ -435,16 +825,16 @@ int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx
 	FP2_init(&t5);
 	FP2_init(&t6);
 
-	if (!FP2_sqr(group, &t0, &a->f[0].f[1], ctx)) {
+	if (!FP2_sqr(group, &t0, &a->f[0].f[1])) {
 		goto err;
 	}
-	if (!FP2_sqr(group, &t1, &a->f[1].f[2], ctx)) {
+	if (!FP2_sqr(group, &t1, &a->f[1].f[2])) {
 		goto err;
 	}
 	if (!FP2_add(group, &t5, &a->f[0].f[1], &a->f[1].f[2])) {
 		goto err;
 	}
-	if (!FP2_sqr(group, &t2, &t5, ctx)) {
+	if (!FP2_sqr(group, &t2, &t5)) {
 		goto err;
 	}
 
@@ -458,14 +848,14 @@ int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx
 	if (!FP2_add(group, &t6, &a->f[1].f[0], &a->f[0].f[2])) {
 		goto err;
 	}
-	if (!FP2_sqr(group, &t3, &t6, ctx)) {
+	if (!FP2_sqr(group, &t3, &t6)) {
 		goto err;
 	}
-	if (!FP2_sqr(group, &t2, &a->f[1].f[0], ctx)) {
+	if (!FP2_sqr(group, &t2, &a->f[1].f[0])) {
 		goto err;
 	}
 
-	if (!FP2_mul_nor(group, &t6, &t5, ctx)) {
+	if (!FP2_mul_nor(group, &t6, &t5)) {
 		goto err;
 	}
 	if (!FP2_add(group, &t5, &t6, &a->f[1].f[0])) {
@@ -478,7 +868,7 @@ int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx
 		goto err;
 	}
 
-	if (!FP2_mul_nor(group, &t4, &t1, ctx)) {
+	if (!FP2_mul_nor(group, &t4, &t1)) {
 		goto err;
 	}
 	if (!FP2_add(group, &t5, &t0, &t4)) {
@@ -488,7 +878,7 @@ int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx
 		goto err;
 	}
 
-	if (!FP2_sqr(group, &t1, &a->f[0].f[2], ctx)) {
+	if (!FP2_sqr(group, &t1, &a->f[0].f[2])) {
 		goto err;
 	}
 
@@ -499,7 +889,7 @@ int FP12_sqr_pck(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, BN_CTX *ctx
 		goto err;
 	}
 
-	if (!FP2_mul_nor(group, &t4, &t1, ctx)) {
+	if (!FP2_mul_nor(group, &t4, &t1)) {
 		goto err;
 	}
 	if (!FP2_add(group, &t5, &t2, &t4)) {
@@ -543,138 +933,85 @@ err:
 	return ret;
 }
 
-int FP12_back(const PAIRING_GROUP *group, FP12 *r, FP12 *s, const FP12 *a, const FP12 *b, BN_CTX *ctx) {
-	FP2 t0[2], t1[2], t2[2];
-	FP12 t[2], u[2];
-	BIGNUM *one;
-	BN_CTX *new_ctx = NULL;
+int FP12_back_sim(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, int n) {
+	FP2 sn[2 * EXP_PCK], *num = NULL, *den = NULL, t0, t1;
 	int i, ret = 0;
 
-	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
-		if (ctx == NULL) {
-			return -1;
-		}
+	if (n <= 0) {
+		return 1;
 	}
-
-	BN_CTX_start(ctx);
-	one = BN_CTX_get(ctx);
-	if (one == NULL) {
-		goto err;
+	if (n <= EXP_PCK) {
+		num = sn;
+	} else if ((num = OPENSSL_malloc(2 * n * sizeof(FP2))) == NULL) {
+		return 0;
 	}
-
-	FP2_init(&t0[0]);
-	FP2_init(&t0[1]);
-	FP2_init(&t1[0]);
-	FP2_init(&t1[1]);
-	FP2_init(&t2[0]);
-	FP2_init(&t2[1]);
-	FP12_init(&t[0]);
-	FP12_init(&t[1]);
-	FP12_init(&u[0]);
-	FP12_init(&u[1]);
-
-	FP12_copy(&u[0], a);
-	FP12_copy(&u[1], b);
-
-	for (i = 0; i < 2; i++) {
-		/* t0 = g4^2. */
-		if (!FP2_sqr(group, &t0[i], &u[i].f[0].f[1], ctx)) {
-			goto err;
-		}
-		/* t1 = 3 * g4^2 - 2 * g3. */
-		if (!FP2_sub(group, &t1[i], &t0[i], &u[i].f[0].f[2])) {
-			goto err;
-		}
-		if (!FP2_add(group, &t1[i], &t1[i], &t1[i])) {
-			goto err;
-		}
-		if (!FP2_add(group, &t1[i], &t1[i], &t0[i])) {
-			goto err;
-		}
-		/* t0 = E * g5^2 + t1. */
-		if (!FP2_sqr(group, &t2[i], &u[i].f[1].f[2], ctx)) {
-			goto err;
-		}
-		if (!FP2_mul_nor(group, &t0[i], &t2[i], ctx)) {
-			goto err;
-		}
-		if (!FP2_add(group, &t0[i], &t0[i], &t1[i])) {
-			goto err;
+	den = num + n;
+
+	/* Write g1 = num / den, following Karabina. */
+	for (i = 0; i < n; i++) {
+		if (!FP2_is_zero(&a[i].f[1].f[0])) {
+			/* num = E * g5^2 + 3 * g4^2 - 2 * g3, den = 4 * g2. */
+			FP2_sqr(group, &t0, &a[i].f[0].f[1]);
+			FP2_sub(group, &t1, &t0, &a[i].f[0].f[2]);
+			FP2_add(group, &t1, &t1, &t1);
+			FP2_add(group, &t1, &t1, &t0);
+			FP2_sqr(group, &t0, &a[i].f[1].f[2]);
+			FP2_mul_nor(group, &t0, &t0);
+			FP2_add(group, &num[i], &t0, &t1);
+			FP2_add(group, &den[i], &a[i].f[1].f[0], &a[i].f[1].f[0]);
+			FP2_add(group, &den[i], &den[i], &den[i]);
+		} else {
+			/* num = 2 * g4 * g5, den = g3. */
+			FP2_mul(group, &num[i], &a[i].f[0].f[1], &a[i].f[1].f[2]);
+			FP2_add(group, &num[i], &num[i], &num[i]);
+			FP2_copy(&den[i], &a[i].f[0].f[2]);
 		}
-		/* t1 = (4 * g2). */
-		if (!FP2_add(group, &t1[i], &u[i].f[1].f[0], &u[i].f[1].f[0])) {
-			goto err;
-		}
-		if (!FP2_add(group, &t1[i], &t1[i], &t1[i])) {
-			goto err;
-		}
-	}
-
-	/* t1 = 1 / t1. */
-	if (!FP2_inv_sim(group, &t1[0], &t1[1], &t1[0], &t1[1], ctx)) {
-		goto err;
 	}
 
-	for (i = 0; i < 2; i++) {
-		/* t0 = g1. */
-		if (!FP2_mul(group, &t[i].f[1].f[1], &t0[i], &t1[i], ctx)) {
-			goto err;
-		}
-		/* t1 = g3 * g4. */
-		if (!FP2_mul(group, &t1[i], &u[i].f[0].f[2], &u[i].f[0].f[1], ctx)) {
-			goto err;
-		}
-		/* t2 = 2 * g1^2 - 3 * g3 * g4. */
-		if (!FP2_sqr(group, &t2[i], &t[i].f[1].f[1], ctx)) {
-			goto err;
-		}
-		if (!FP2_sub(group, &t2[i], &t2[i], &t1[i])) {
-			goto err;
-		}
-		if (!FP2_add(group, &t2[i], &t2[i], &t2[i])) {
-			goto err;
-		}
-		if (!FP2_sub(group, &t2[i], &t2[i], &t1[i])) {
-			goto err;
-		}
-		/* t1 = g2 * g5. */
-		if (!FP2_mul(group, &t1[i], &u[i].f[1].f[0], &u[i].f[1].f[2], ctx)) {
-			goto err;
-		}
-		/* t2 = E * (2 * g1^2 + g2 * g5 - 3 * g3 * g4) + 1. */
-		if (!FP2_add(group, &t2[i], &t2[i], &t1[i])) {
-			goto err;
-		}
-		if (!FP2_mul_nor(group, &t[i].f[0].f[0], &t2[i], ctx)) {
-			goto err;
-		}
-		if (!BN_add(&t[i].f[0].f[0].f[0], &t[i].f[0].f[0].f[0], group->one)) {
-			goto err;
+	/* A zero denominator only occurs for g1 = 0 and inverts to zero. */
+	if (!FP2_inv_batch(group, den, den, n)) {
+		goto err;
+	}
+
+	for (i = 0; i < n; i++) {
+		FP2_mul(group, &num[i], &num[i], &den[i]);
+		/* g0 = E * (2 * g1^2 + g2 * g5 - 3 * g3 * g4) + 1. */
+		FP2_mul(group, &t1, &a[i].f[0].f[2], &a[i].f[0].f[1]);
+		FP2_sqr(group, &t0, &num[i]);
+		FP2_sub(group, &t0, &t0, &t1);
+		FP2_add(group, &t0, &t0, &t0);
+		FP2_sub(group, &t0, &t0, &t1);
+		FP2_mul(group, &t1, &a[i].f[1].f[0], &a[i].f[1].f[2]);
+		FP2_add(group, &t0, &t0, &t1);
+		FP2_mul_nor(group, &t0, &t0);
+		FP_add(&t0.f[0], &t0.f[0], &group->one);
+		if (r != a) {
+			FP2_copy(&r[i].f[0].f[1], &a[i].f[0].f[1]);
+			FP2_copy(&r[i].f[0].f[2], &a[i].f[0].f[2]);
+			FP2_copy(&r[i].f[1].f[0], &a[i].f[1].f[0]);
+			FP2_copy(&r[i].f[1].f[2], &a[i].f[1].f[2]);
 		}
-		FP2_copy(&t[i].f[0].f[1], &u[i].f[0].f[1]);
-		FP2_copy(&t[i].f[0].f[2], &u[i].f[0].f[2]);
-		FP2_copy(&t[i].f[1].f[0], &u[i].f[1].f[0]);
-		FP2_copy(&t[i].f[1].f[2], &u[i].f[1].f[2]);
+		FP2_copy(&r[i].f[1].f[1], &num[i]);
+		FP2_copy(&r[i].f[0].f[0], &t0);
 	}
 
-	FP12_copy(r, &t[0]);
-	FP12_copy(s, &t[1]);
-
 	ret = 1;
 err:
-	FP2_free(&t0[0]);
-	FP2_free(&t0[1]);
-	FP2_free(&t1[0]);
-	FP2_free(&t1[1]);
-	FP2_free(&t2[0]);
-	FP2_free(&t2[1]);
-	FP12_free(&t[0]);
-	FP12_free(&t[1]);
-	FP12_free(&u[0]);
-	FP12_free(&u[1]);
-    BN_CTX_end(ctx);
-    if (new_ctx != NULL)
-        BN_CTX_free(new_ctx);
+	if (num != sn) {
+		OPENSSL_free(num);
+	}
 	return ret;
-}
\ No newline at end of file
+}
+
+int FP12_back(const PAIRING_GROUP *group, FP12 *r, FP12 *s, const FP12 *a, const FP12 *b) {
+	FP12 t[2];
+
+	FP12_copy(&t[0], a);
+	FP12_copy(&t[1], b);
+	if (!FP12_back_sim(group, t, t, 2)) {
+		return 0;
+	}
+	FP12_copy(r, &t[0]);
+	FP12_copy(s, &t[1]);
+	return 1;
+}
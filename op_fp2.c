@@ -22,474 +22,234 @@
 
 #include "op.h"
 
-#define FRB10 "1830373EE92ACF9FD5910FFED2C92F70144F87F9C79B1F6B2728380075E94F74"
-#define FRB11 "0CF32D4356D53061E4A33D812D36D0984CD178063864E0A87FD7C7FF8A16B09F"
-#define FRB2 "22A87DEBBFFFFFEFC0651CD3594D64661C92209138D7BA61056EFC68E869FD55"
-#define FRB3 "1AA6D99B1D115E0A5F0116472CAE2274C45A8B4E56D9569CFD55C5DC71674777"
-#define FRB4 "1EB0BE5BFFFFFFE3A8F6FE53594D642B74AB209138D7B9D7746EFC68E869FCD0"
-#define FRB50 "0DB3AC57C63C2DA87A5DD8C5FF7751DC778913481E7475F47D7DFDDCE75096D8"
-#define FRB51 "176FB82A79C3D2593FD674BA0088AE2BE997ECB7E18B8A1F2982022318AF693B"
-
-static void print(BIGNUM *r) {
-	BIGNUM *t = BN_CTX_get(group.bn);
-	group.ec->meth->field_decode(group.ec, t, r, group.bn);
-	BN_print_fp(stdout, t);
-	printf("\n");
-}
+/* Frobenius constants in Montgomery form. */
+static const FP2 frb1 = { { { {
+	0x2728380075E94F74ULL, 0x144F87F9C79B1F6BULL,
+	0xD5910FFED2C92F70ULL, 0x1830373EE92ACF9FULL
+} }, { {
+	0x7FD7C7FF8A16B09FULL, 0x4CD178063864E0A8ULL,
+	0xE4A33D812D36D098ULL, 0x0CF32D4356D53061ULL
+} } } };
+
+static const FP frb2 = { {
+	0x056EFC68E869FD55ULL, 0x1C92209138D7BA61ULL,
+	0xC0651CD3594D6466ULL, 0x22A87DEBBFFFFFEFULL
+} };
+
+static const FP frb3 = { {
+	0xFD55C5DC71674777ULL, 0xC45A8B4E56D9569CULL,
+	0x5F0116472CAE2274ULL, 0x1AA6D99B1D115E0AULL
+} };
+
+static const FP frb4 = { {
+	0x746EFC68E869FCD0ULL, 0x74AB209138D7B9D7ULL,
+	0xA8F6FE53594D642BULL, 0x1EB0BE5BFFFFFFE3ULL
+} };
+
+static const FP2 frb5 = { { { {
+	0x7D7DFDDCE75096D8ULL, 0x778913481E7475F4ULL,
+	0x7A5DD8C5FF7751DCULL, 0x0DB3AC57C63C2DA8ULL
+} }, { {
+	0x2982022318AF693BULL, 0xE997ECB7E18B8A1FULL,
+	0x3FD674BA0088AE2BULL, 0x176FB82A79C3D259ULL
+} } } };
 
 void FP2_init(FP2 *a) {
-	BN_init(&a->f[0]);
-	BN_init(&a->f[1]);
+	FP_zero(&a->f[0]);
+	FP_zero(&a->f[1]);
 }
 
 void FP2_free(FP2 *a) {
-	BN_free(&a->f[0]);
-	BN_free(&a->f[1]);
+	/* Elements live on the stack, nothing to release. */
+	(void)a;
 }
 
 int FP2_rand(const PAIRING_GROUP *group, FP2 *a) {
-	if (!BN_rand_range(&a->f[0], group->field)) {
+	if (!FP_rand(&a->f[0])) {
 		return 0;
 	}
-	if (!BN_rand_range(&a->f[1], group->field)) {
+	if (!FP_rand(&a->f[1])) {
 		return 0;
 	}
 	return 1;
 }
 
 void FP2_print(const FP2 *a) {
-	BN_print_fp(stdout, &a->f[0]);
-	printf("\n");
-	BN_print_fp(stdout, &a->f[1]);
-	printf("\n");
+	FP_print(&a->f[0]);
+	FP_print(&a->f[1]);
 }
 
 int FP2_zero(FP2 *a) {
-	if (!BN_zero(&a->f[0])) {
-		return 0;
-	}
-	if (!BN_zero(&a->f[1])) {
-		return 0;
-	}
+	FP_zero(&a->f[0]);
+	FP_zero(&a->f[1]);
 	return 1;
 }
 
 int FP2_cmp(const FP2 *a, const FP2 *b) {
-	if (BN_cmp(&a->f[0], &b->f[0]) != 0) {
+	if (FP_cmp(&a->f[0], &b->f[0]) != 0) {
 		return 1;
 	}
-	if (BN_cmp(&a->f[1], &b->f[1]) != 0) {
+	if (FP_cmp(&a->f[1], &b->f[1]) != 0) {
 		return 1;
 	}
 	return 0;
 }
 
 void FP2_copy(FP2 *a, const FP2 *b) {
-	BN_copy(&a->f[0], &b->f[0]);
-	BN_copy(&a->f[1], &b->f[1]);
+	FP_copy(&a->f[0], &b->f[0]);
+	FP_copy(&a->f[1], &b->f[1]);
 }
 
 int FP2_is_zero(const FP2 *a) {
-	return BN_is_zero(&a->f[0]) && BN_is_zero(&a->f[1]);
+	return FP_is_zero(&a->f[0]) && FP_is_zero(&a->f[1]);
 }
 
 int FP2_add(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b) {
-	if (!BN_mod_add_quick(&r->f[0], &a->f[0], &b->f[0], group->field)) {
-		return 0;
-	}
-	if (!BN_mod_add_quick(&r->f[1], &a->f[1], &b->f[1], group->field)) {
-		return 0;
-	}
+	FP_add(&r->f[0], &a->f[0], &b->f[0]);
+	FP_add(&r->f[1], &a->f[1], &b->f[1]);
 	return 1;
 }
 
 int FP2_sub(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b) {
-	if (!BN_mod_sub_quick(&r->f[0], &a->f[0], &b->f[0], group->field)) {
-		return 0;
-	}
-	if (!BN_mod_sub_quick(&r->f[1], &a->f[1], &b->f[1], group->field)) {
-		return 0;
-	}
+	FP_sub(&r->f[0], &a->f[0], &b->f[0]);
+	FP_sub(&r->f[1], &a->f[1], &b->f[1]);
 	return 1;
 }
 
 int FP2_neg(const PAIRING_GROUP *group, FP2 *r, const FP2 *a) {
-	if (!BN_sub(&r->f[0], group->field, &a->f[0])) {
-		return 0;
-	}
-	if (!BN_sub(&r->f[1], group->field, &a->f[1])) {
-		return 0;
-	}	
+	FP_neg(&r->f[0], &a->f[0]);
+	FP_neg(&r->f[1], &a->f[1]);
 	return 1;
 }
 
-int FP2_mul_frb(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, int i, BN_CTX *ctx) {
-	BIGNUM *frb;
-	FP2 fp2_frb;
-	BN_CTX *new_ctx = NULL;
-	int ret = 0;
-
-	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
-		if (ctx == NULL) {
-			return -1;
-		}
-	}
-
-	FP2_init(&fp2_frb);
-	BN_CTX_start(ctx);
-	frb = BN_CTX_get(ctx);
-	if (frb == NULL) {
-		goto err;
-	}
-
-	if (i == 1) {
-		if (BN_hex2bn(&frb, FRB10) != (sizeof(FRB10) - 1)) {
-			return 0;
-		}
-		BN_copy(&fp2_frb.f[0], frb);
-		if (BN_hex2bn(&frb, FRB11) != (sizeof(FRB11) - 1)) {
-			return 0;
-		}
-		BN_copy(&fp2_frb.f[1], frb);
-		if (!FP2_mul(group, r, a, &fp2_frb, ctx)) {
-			goto err;
-		}
-	}
-
-	if (i == 2) {
-		if (BN_hex2bn(&frb, FRB2) != (sizeof(FRB2) - 1)) {
-			return 0;
-		}
-		if (!BN_mod_mul_montgomery(&r->f[0], &a->f[0], frb, group->mont, ctx)) {
-			goto err;
-		}
-		if (!BN_mod_mul_montgomery(&r->f[1], &a->f[1], frb, group->mont, ctx)) {
-			goto err;
-		}
-		if (!FP2_mul_art(group, r, r, ctx)) {
-			goto err;
-		}
-	}
-
-	if (i == 3) {
-		if (BN_hex2bn(&frb, FRB3) != (sizeof(FRB3) - 1)) {
-			return 0;
-		}
-		if (!BN_mod_mul_montgomery(&r->f[0], &a->f[0], frb, group->mont, ctx)) {
-			goto err;
-		}
-		if (!BN_mod_mul_montgomery(&r->f[1], &a->f[1], frb, group->mont, ctx)) {
-			goto err;
-		}
-		if (!FP2_mul_nor(group, r, r, ctx)) {
-			goto err;
-		}		
-	}
+int FP2_hlv(const PAIRING_GROUP *group, FP2 *r, const FP2 *a) {
+	FP_hlv(&r->f[0], &a->f[0]);
+	FP_hlv(&r->f[1], &a->f[1]);
+	return 1;
+}
 
-	if (i == 4) {
-		if (BN_hex2bn(&frb, FRB4) != (sizeof(FRB4) - 1)) {
-			return 0;
-		}
-		if (!BN_mod_mul_montgomery(&r->f[0], &a->f[0], frb, group->mont, ctx)) {
-			goto err;
-		}
-		if (!BN_mod_mul_montgomery(&r->f[1], &a->f[1], frb, group->mont, ctx)) {
-			goto err;
-		}
+int FP2_mul_frb(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, int i) {
+	switch (i) {
+		case 1:
+			return FP2_mul(group, r, a, &frb1);
+		case 2:
+			FP_mul(&r->f[0], &a->f[0], &frb2);
+			FP_mul(&r->f[1], &a->f[1], &frb2);
+			return FP2_mul_art(group, r, r);
+		case 3:
+			FP_mul(&r->f[0], &a->f[0], &frb3);
+			FP_mul(&r->f[1], &a->f[1], &frb3);
+			return FP2_mul_nor(group, r, r);
+		case 4:
+			FP_mul(&r->f[0], &a->f[0], &frb4);
+			FP_mul(&r->f[1], &a->f[1], &frb4);
+			return 1;
+		case 5:
+			return FP2_mul(group, r, a, &frb5);
 	}
-
-	if (i == 5) {
-		if (BN_hex2bn(&frb, FRB50) != (sizeof(FRB50) - 1)) {
-			return 0;
-		}
-		BN_copy(&fp2_frb.f[0], frb);
-		if (BN_hex2bn(&frb, FRB51) != (sizeof(FRB51) - 1)) {
-			return 0;
-		}
-		BN_copy(&fp2_frb.f[1], frb);
-		if (!FP2_mul(group, r, a, &fp2_frb, ctx)) {
-			goto err;
-		}
-	}	
-
-	ret = 1;
-
- err:
-    FP2_free(&fp2_frb);
-    BN_CTX_end(ctx);
-    if (new_ctx != NULL)
-        BN_CTX_free(new_ctx);
-	return ret;
+	return 0;
 }
 
-int FP2_mul(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b, BN_CTX *ctx) {
-	BIGNUM *t0, *t1, *t2, *t3, *t4;
-	BN_CTX *new_ctx = NULL;
-	int ret = 0;
-
-	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
-		if (ctx == NULL) {
-			return -1;
-		}
-	}
-
-	BN_CTX_start(ctx);
-	t0 = BN_CTX_get(ctx);
-	t1 = BN_CTX_get(ctx);
-	t2 = BN_CTX_get(ctx);
-	t3 = BN_CTX_get(ctx);
-	t4 = BN_CTX_get(ctx);
-	if (t4 == NULL) {
-		goto err;
-	}
+int FP2_mul(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b) {
+	FP t0, t1, t2, t3, t4;
 
 	/* Karatsuba algorithm. */
 
 	/* t2 = a_0 + a_1, t1 = b_0 + b_1. */
-	if (!BN_mod_add_quick(t2, &a->f[0], &a->f[1], group->field)) {
-		goto err;
-	}
-
-	if (!BN_mod_add_quick(t1, &b->f[0], &b->f[1], group->field)) {
-		goto err;
-	}
+	FP_add(&t2, &a->f[0], &a->f[1]);
+	FP_add(&t1, &b->f[0], &b->f[1]);
 
 	/* t3 = (a_0 + a_1) * (b_0 + b_1). */
-	if (!BN_mod_mul_montgomery(t3, t2, t1, group->mont, ctx)) {
-		goto err;
-	}
+	FP_mul(&t3, &t2, &t1);
 
 	/* t0 = a_0 * b_0, t4 = a_1 * b_1. */
-	if (!BN_mod_mul_montgomery(t0, &a->f[0], &b->f[0], group->mont, ctx)) {
-		goto err;
-	}
-	if (!BN_mod_mul_montgomery(t4, &a->f[1], &b->f[1], group->mont, ctx)) {
-		goto err;
-	}
+	FP_mul(&t0, &a->f[0], &b->f[0]);
+	FP_mul(&t4, &a->f[1], &b->f[1]);
 
 	/* t2 = (a_0 * b_0) + (a_1 * b_1). */
-	if (!BN_mod_add_quick(t2, t0, t4, group->field)) {
-		goto err;
-	}
+	FP_add(&t2, &t0, &t4);
 
 	/* t1 = (a_0 * b_0) + u^2 * (a_1 * b_1). */
-	if (!BN_mod_sub_quick(&r->f[0], t0, t4, group->field)) {
-		goto err;
-	}
+	FP_sub(&r->f[0], &t0, &t4);
 
 	/* t4 = t3 - t2. */
-	if (!BN_mod_sub_quick(&r->f[1], t3, t2, group->field)) {
-		goto err;
-	}
+	FP_sub(&r->f[1], &t3, &t2);
 
-	ret = 1;
- err:
-    BN_CTX_end(ctx);
-    if (new_ctx != NULL)
-        BN_CTX_free(new_ctx);
-	return ret;
+	return 1;
 }
 
-int FP2_mul_nor(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx) {
-	BIGNUM *t;
-	BN_CTX *new_ctx = NULL;
-	int ret = 0;
+int FP2_mul_nor(const PAIRING_GROUP *group, FP2 *r, const FP2 *a) {
+	FP t;
 
-	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
-		if (ctx == NULL) {
-			return -1;
-		}
-	}
+	/* (a_0 + a_1 * i) * (1 + i) = (a_0 - a_1) + (a_0 + a_1) * i. */
+	FP_sub(&t, &a->f[0], &a->f[1]);
+	FP_add(&r->f[1], &a->f[0], &a->f[1]);
+	FP_copy(&r->f[0], &t);
 
-	BN_CTX_start(ctx);
-	t = BN_CTX_get(ctx);
-	if (t == NULL) {
-		goto err;
-	}
-
-	if (!BN_sub(t, group->field, &a->f[1])) {
-		goto err;
-	}
-	if (!BN_mod_add_quick(&r->f[1], &a->f[0], &a->f[1], group->field)) {
-		goto err;
-	}
-	if (!BN_mod_add_quick(&r->f[0], t, &a->f[0], group->field)) {
-		goto err;
-	}
-
-	ret = 1;
-
- err:
-    BN_CTX_end(ctx);
-    if (new_ctx != NULL)
-        BN_CTX_free(new_ctx);
-	return ret;
+	return 1;
 }
 
-int FP2_mul_art(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx) {
-	BIGNUM *t;
-	BN_CTX *new_ctx = NULL;
-	int ret = 0;
-
-	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
-		if (ctx == NULL) {
-			return -1;
-		}
-	}
-
-	BN_CTX_start(ctx);
-	t = BN_CTX_get(ctx);
-	if (t == NULL) {
-		goto err;
-	}
+int FP2_mul_art(const PAIRING_GROUP *group, FP2 *r, const FP2 *a) {
+	FP t;
 
-	BN_copy(t, &a->f[0]);
-	if (!BN_sub(&r->f[0], group->field, &a->f[1])) {
-		goto err;
-	}
-	BN_copy(&r->f[1], t);
-
-	ret = 1;
+	FP_copy(&t, &a->f[0]);
+	FP_neg(&r->f[0], &a->f[1]);
+	FP_copy(&r->f[1], &t);
 
- err:
-    BN_CTX_end(ctx);
-    if (new_ctx != NULL)
-        BN_CTX_free(new_ctx);
-	return ret;
+	return 1;
 }
 
-int FP2_sqr(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx) {
-	BIGNUM *t0, *t1, *t2;
-	BN_CTX *new_ctx = NULL;
-	int ret = 0;
-
-	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
-		if (ctx == NULL) {
-			return -1;
-		}
-	}
-
-	BN_CTX_start(ctx);
-	t0 = BN_CTX_get(ctx);
-	t1 = BN_CTX_get(ctx);
-	t2 = BN_CTX_get(ctx);
-	if (t2 == NULL) {
-		goto err;
-	}
+int FP2_sqr(const PAIRING_GROUP *group, FP2 *r, const FP2 *a) {
+	FP t0, t1, t2;
 
 	/* t0 = (a_0 + a_1). */
-	if (!BN_mod_add_quick(t0, &a->f[0], &a->f[1], group->field)) {
-		goto err;
-	}
+	FP_add(&t0, &a->f[0], &a->f[1]);
 
 	/* t1 = (a_0 - a_1). */
-	if (!BN_mod_sub_quick(t1, &a->f[0], &a->f[1], group->field)) {
-		goto err;
-	}
+	FP_sub(&t1, &a->f[0], &a->f[1]);
 
 	/* t2 = 2 * a_0. */
-	if (!BN_lshift1(t2, &a->f[0])) {
-		goto err;
-	}
+	FP_dbl(&t2, &a->f[0]);
 
 	/* c_1 = 2 * a_0 * a_1. */
-	if (!BN_mod_mul_montgomery(&r->f[1], t2, &a->f[1], group->mont, ctx)) {
-		goto err;
-	}
+	FP_mul(&r->f[1], &t2, &a->f[1]);
 	/* c_0 = a_0^2 + a_1^2 * u^2. */
-	if (!BN_mod_mul_montgomery(&r->f[0], t0, t1, group->mont, ctx)) {
-		goto err;
-	}
+	FP_mul(&r->f[0], &t0, &t1);
 
-	ret = 1;
-
- err:
-    BN_CTX_end(ctx);
-    if (new_ctx != NULL)
-        BN_CTX_free(new_ctx);
-	return ret;
+	return 1;
 }
 
-int FP2_inv(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx) {
-	BIGNUM *t0, *t1;
-	BN_CTX *new_ctx = NULL;
-	int ret = 0;
-
-	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
-		if (ctx == NULL) {
-			return -1;
-		}
-	}
-
-	BN_CTX_start(ctx);
-	t0 = BN_CTX_get(ctx);
-	t1 = BN_CTX_get(ctx);
-	if (t1 == NULL) {
-		goto err;
-	}
+int FP2_inv(const PAIRING_GROUP *group, FP2 *r, const FP2 *a) {
+	FP t0, t1;
 
 	/* t0 = a_0^2, t1 = a_1^2. */
-	if (!BN_mod_mul_montgomery(t0, &a->f[0], &a->f[0], group->mont, ctx)) {
-		goto err;
-	}
-	if (!BN_mod_mul_montgomery(t1, &a->f[1], &a->f[1], group->mont, ctx)) {
-		goto err;
-	}
+	FP_sqr(&t0, &a->f[0]);
+	FP_sqr(&t1, &a->f[1]);
 
 	/* t1 = 1/(a_0^2 + a_1^2). */
-	if (!BN_mod_add_quick(t0, t0, t1, group->field)) {
-		goto err;
-	}
-
-	if (!BN_from_montgomery(t0, t0, group->mont, ctx)) {
-		goto err;
-	}
-
-	if (!BN_mod_inverse(t1, t0, group->field, ctx)) {
-		goto err;
-	}
-
-	if (!BN_to_montgomery(t1, t1, group->mont, ctx)) {
-		goto err;
+	FP_add(&t0, &t0, &t1);
+	if (!FP_inv(&t1, &t0)) {
+		return 0;
 	}
 
 	/* c_0 = a_0/(a_0^2 + a_1^2). */
-	if (!BN_mod_mul_montgomery(&r->f[0], &a->f[0], t1, group->mont, ctx)) {
-		goto err;
-	}
+	FP_mul(&r->f[0], &a->f[0], &t1);
 
 	/* c_1 = a_1/(a_0^2 + a_1^2). */
-	if (!BN_mod_mul_montgomery(&r->f[1], &a->f[1], t1, group->mont, ctx)) {
-		goto err;
-	}
-
-	if (!BN_sub(&r->f[1], group->field, &r->f[1])) {
-		goto err;
-	}
-
-	ret = 1;
+	FP_mul(&r->f[1], &a->f[1], &t1);
+	FP_neg(&r->f[1], &r->f[1]);
 
- err:
-    BN_CTX_end(ctx);
-    if (new_ctx != NULL)
-        BN_CTX_free(new_ctx);
-	return ret;
+	return 1;
 }
 
-int FP2_conv_uni(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx) {
+int FP2_conv_uni(const PAIRING_GROUP *group, FP2 *r, const FP2 *a) {
 	FP2 t;
 	int ret = 0;
 
 	FP2_init(&t);
 
 	/* t = a^{-1}. */
-	if (!FP2_inv(group, &t, a, ctx)) {
+	if (!FP2_inv(group, &t, a)) {
 		goto err;
 	}
 	/* c = a^p. */
@@ -497,7 +257,7 @@ int FP2_conv_uni(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx)
 		goto err;
 	}
 	/* c = a^(p - 1). */
-	if (!FP2_mul(group, r, r, &t, ctx)) {
+	if (!FP2_mul(group, r, r, &t)) {
 		goto err;
 	}
 
@@ -509,15 +269,13 @@ err:
 }
 
 int FP2_inv_uni(const PAIRING_GROUP *group, FP2 *r, const FP2 *a) {
-	BN_copy(&r->f[0], &a->f[0]);
-	if (!BN_sub(&r->f[1], group->field, &a->f[1])) {
-		return 0;
-	}
+	FP_copy(&r->f[0], &a->f[0]);
+	FP_neg(&r->f[1], &a->f[1]);
 	return 1;
 }
 
-int FP2_inv_sim(const PAIRING_GROUP *group, FP2 *r, FP2 *s, const FP2 *a, const FP2 *b, BN_CTX *ctx) {
-	int i, ret = 0;
+int FP2_inv_sim(const PAIRING_GROUP *group, FP2 *r, FP2 *s, const FP2 *a, const FP2 *b) {
+	int ret = 0;
 	FP2 u, t;
 
 	FP2_init(&t);
@@ -525,18 +283,18 @@ int FP2_inv_sim(const PAIRING_GROUP *group, FP2 *r, FP2 *s, const FP2 *a, const
 
 	FP2_copy(&t, a);
 
-	if (!FP2_mul(group, &u, a, b, ctx)) {
+	if (!FP2_mul(group, &u, a, b)) {
 		goto err;
 	}
 
-	if (!FP2_inv(group, &u, &u, ctx)) {
+	if (!FP2_inv(group, &u, &u)) {
 		goto err;
 	}
 
-	if (!FP2_mul(group, r, b, &u, ctx)) {
+	if (!FP2_mul(group, r, b, &u)) {
 		goto err;
 	}
-	if (!FP2_mul(group, s, &t, &u, ctx)) {
+	if (!FP2_mul(group, s, &t, &u)) {
 		goto err;
 	}
 
@@ -547,110 +305,123 @@ err:
 	return ret;
 }
 
-int FP2_mul_unr(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b, BN_CTX *ctx) {
-	BIGNUM *t0, *t1, *t2, *t3, *t4;
-	BN_CTX *new_ctx = NULL;
-	int ret = 0;
+int FP2_inv_batch_buf(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, int n, FP2 *p) {
+	FP2 t, v;
+	int i, k = -1;
 
-	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
-		if (ctx == NULL) {
-			return -1;
+	/* Montgomery's trick, skipping zeros: see FP_inv_batch. */
+	for (i = 0; i < n; i++) {
+		if (FP2_is_zero(&a[i])) {
+			continue;
+		}
+		if (k < 0) {
+			FP2_copy(&t, &a[i]);
+			k = i;
+		} else {
+			FP2_copy(&p[i], &t);
+			if (!FP2_mul(group, &t, &t, &a[i])) {
+				return 0;
+			}
 		}
 	}
 
-	BN_CTX_start(ctx);
-	t0 = BN_CTX_get(ctx);
-	t1 = BN_CTX_get(ctx);
-	t2 = BN_CTX_get(ctx);
-	t3 = BN_CTX_get(ctx);
-	t4 = BN_CTX_get(ctx);
-	if (t4 == NULL) {
-		goto err;
+	if (k >= 0 && !FP2_inv(group, &t, &t)) {
+		return 0;
+	}
+	for (i = n - 1; i >= 0; i--) {
+		if (FP2_is_zero(&a[i])) {
+			FP2_zero(&r[i]);
+		} else if (i == k) {
+			FP2_copy(&r[i], &t);
+		} else {
+			if (!FP2_mul(group, &v, &t, &p[i])) {
+				return 0;
+			}
+			if (!FP2_mul(group, &t, &t, &a[i])) {
+				return 0;
+			}
+			FP2_copy(&r[i], &v);
+		}
 	}
+	return 1;
+}
 
-	/* Karatsuba algorithm. */
+int FP2_inv_batch(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, int n) {
+	FP2 sp[INV_STACK], *p = NULL;
+	int ret;
 
-	/* t2 = a_0 + a_1, t1 = b_0 + b_1. */
-	if (!BN_add(t2, &a->f[0], &a->f[1])) {
-		goto err;
+	if (n <= 0) {
+		return 1;
 	}
-	if (!BN_add(t1, &b->f[0], &b->f[1])) {
-		goto err;
+	if (n <= INV_STACK) {
+		p = sp;
+	} else if ((p = OPENSSL_malloc(n * sizeof(FP2))) == NULL) {
+		return 0;
+	}
+	ret = FP2_inv_batch_buf(group, r, a, n, p);
+	if (p != sp) {
+		OPENSSL_free(p);
 	}
+	return ret;
+}
+
+int FP2_mul_unr(const PAIRING_GROUP *group, DV2 *r, const FP2 *a, const FP2 *b) {
+	FP t1, t2;
+	DV t0, t3, t4;
+
+	/* Karatsuba algorithm. */
+
+	/* t2 = a_0 + a_1, t1 = b_0 + b_1. */
+	FP_add(&t2, &a->f[0], &a->f[1]);
+	FP_add(&t1, &b->f[0], &b->f[1]);
 
 	/* t3 = (a_0 + a_1) * (b_0 + b_1). */
-	if (!BN_mul(t3, t2, t1, ctx)) {
-		goto err;
-	}
+	FP_mul_unr(&t3, &t2, &t1);
 
 	/* t0 = a_0 * b_0, t4 = a_1 * b_1. */
-	if (!BN_mul(t0, &a->f[0], &b->f[0], ctx)) {
-		goto err;
-	}
-	if (!BN_mul(t4, &a->f[1], &b->f[1], ctx)) {
-		goto err;
-	}
-
-	/* t2 = (a_0 * b_0) + (a_1 * b_1). */
-	if (!BN_add(t2, t0, t4)) {
-		goto err;
-	}
+	FP_mul_unr(&t0, &a->f[0], &b->f[0]);
+	FP_mul_unr(&t4, &a->f[1], &b->f[1]);
 
 	/* c0 = (a_0 * b_0) + u^2 * (a_1 * b_1). */
-	if (!BN_sub(&r->f[0], t0, t4)) {
-		goto err;
-	}
+	DV_sub(&r->f[0], &t0, &t4);
 
-	/* c1 = t3 - t2. */
-	if (!BN_sub(&r->f[1], t3, t2)) {
-		goto err;
-	}
-
-	ret = 1;
+	/* c1 = t3 - (a_0 * b_0) - (a_1 * b_1). */
+	DV_sub(&r->f[1], &t3, &t0);
+	DV_sub(&r->f[1], &r->f[1], &t4);
 
- err:
-    BN_CTX_end(ctx);
-    if (new_ctx != NULL)
-        BN_CTX_free(new_ctx);
-	return ret;
+	return 1;
 }
 
-int FP2_rdc(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, BN_CTX *ctx) {
-	int ret = 0;
+int FP2_sqr_unr(const PAIRING_GROUP *group, DV2 *r, const FP2 *a) {
+	FP t0, t1;
 
-	/* c_0 = t1 mod p. */
-	if (!BN_from_montgomery(&r->f[0], &a->f[0], group->mont, ctx)) {
-		goto err;
-	}
-	if (!BN_from_montgomery(&r->f[1], &a->f[1], group->mont, ctx)) {
-		goto err;
-	}
+	/* c0 = (a_0 + a_1) * (a_0 - a_1). */
+	FP_add(&t0, &a->f[0], &a->f[1]);
+	FP_sub(&t1, &a->f[0], &a->f[1]);
+	FP_mul_unr(&r->f[0], &t0, &t1);
 
-	if (BN_is_negative(&r->f[0])) {
-		if (!BN_add(&r->f[0], &r->f[0], group->field)) {
-			goto err;
-		}
-	}
-	if (BN_is_negative(&r->f[1])) {
-		if (!BN_add(&r->f[1], &r->f[1], group->field)) {
-			goto err;
-		}
-	}
+	/* c1 = 2 * a_0 * a_1. */
+	FP_dbl(&t0, &a->f[0]);
+	FP_mul_unr(&r->f[1], &t0, &a->f[1]);
 
-	ret = 1;
+	return 1;
+}
 
-err:
-	return ret;
+int FP2_rdc(const PAIRING_GROUP *group, FP2 *r, const DV2 *a) {
+	/* c_i = a_i * R^{-1} mod p. */
+	FP_rdc(&r->f[0], &a->f[0]);
+	FP_rdc(&r->f[1], &a->f[1]);
+	return 1;
 }
 
-int FP2_mul2(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b, BN_CTX *ctx) {
+int FP2_mul2(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b) {
+	DV2 t;
 	int ret = 0;
 
-	if (!FP2_mul_unr(group, r, a, b, ctx)) {
+	if (!FP2_mul_unr(group, &t, a, b)) {
 		goto err;
 	}
-	if (!FP2_rdc(group, r, r, ctx)) {
+	if (!FP2_rdc(group, r, &t)) {
 		goto err;
 	}
 
@@ -659,3 +430,21 @@ int FP2_mul2(const PAIRING_GROUP *group, FP2 *r, const FP2 *a, const FP2 *b, BN_
 err:
 	return ret;
 }
+
+void DV2_add(DV2 *r, const DV2 *a, const DV2 *b) {
+	DV_add(&r->f[0], &a->f[0], &b->f[0]);
+	DV_add(&r->f[1], &a->f[1], &b->f[1]);
+}
+
+void DV2_sub(DV2 *r, const DV2 *a, const DV2 *b) {
+	DV_sub(&r->f[0], &a->f[0], &b->f[0]);
+	DV_sub(&r->f[1], &a->f[1], &b->f[1]);
+}
+
+void DV2_mul_nor(DV2 *r, const DV2 *a) {
+	DV t;
+
+	DV_sub(&t, &a->f[0], &a->f[1]);
+	DV_add(&r->f[1], &a->f[0], &a->f[1]);
+	DV_copy(&r->f[0], &t);
+}
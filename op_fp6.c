@@ -128,7 +128,7 @@ int FP6_neg(const PAIRING_GROUP *group, FP6 *r, const FP6 *a) {
 	return 1;
 }
 
-int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_CTX *ctx) {
+int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b) {
 	FP2 v0, v1, v2, t0, t1, t2;
 	int ret = 0;
 
@@ -140,17 +140,17 @@ int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_C
 	FP2_init(&t2);
 
 	/* v0 = a_0b_0 */
-	if (!FP2_mul(group, &v0, &a->f[0], &b->f[0], ctx)) {
+	if (!FP2_mul(group, &v0, &a->f[0], &b->f[0])) {
 		goto err;
 	}
 
 	/* v1 = a_1b_1 */
-	if (!FP2_mul(group, &v1, &a->f[1], &b->f[1], ctx)) {
+	if (!FP2_mul(group, &v1, &a->f[1], &b->f[1])) {
 		goto err;
 	}
 
 	/* v2 = a_2b_2 */
-	if (!FP2_mul(group, &v2, &a->f[2], &b->f[2], ctx)) {
+	if (!FP2_mul(group, &v2, &a->f[2], &b->f[2])) {
 		goto err;
 	}
 
@@ -161,7 +161,7 @@ int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_C
 	if (!FP2_add(group, &t1, &b->f[1], &b->f[2])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &t2, &t0, &t1, ctx)) {
+	if (!FP2_mul(group, &t2, &t0, &t1)) {
 		goto err;
 	}
 	if (!FP2_sub(group, &t2, &t2, &v1)) {
@@ -170,7 +170,7 @@ int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_C
 	if (!FP2_sub(group, &t2, &t2, &v2)) {
 		goto err;
 	}
-	if (!FP2_mul_nor(group, &t0, &t2, ctx)) {
+	if (!FP2_mul_nor(group, &t0, &t2)) {
 		goto err;
 	}
 	if (!FP2_add(group, &t2, &t0, &v0)) {
@@ -184,7 +184,7 @@ int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_C
 	if (!FP2_add(group, &t1, &b->f[0], &b->f[1])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &r->f[1], &t0, &t1, ctx)) {
+	if (!FP2_mul(group, &r->f[1], &t0, &t1)) {
 		goto err;
 	}
 	if (!FP2_sub(group, &r->f[1], &r->f[1], &v0)) {
@@ -193,7 +193,7 @@ int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_C
 	if (!FP2_sub(group, &r->f[1], &r->f[1], &v1)) {
 		goto err;
 	}
-	if (!FP2_mul_nor(group, &t0, &v2, ctx)) {
+	if (!FP2_mul_nor(group, &t0, &v2)) {
 		goto err;
 	}
 	if (!FP2_add(group, &r->f[1], &r->f[1], &t0)) {
@@ -207,7 +207,7 @@ int FP6_mul(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_C
 	if (!FP2_add(group, &t1, &b->f[0], &b->f[2])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &r->f[2], &t0, &t1, ctx)) {
+	if (!FP2_mul(group, &r->f[2], &t0, &t1)) {
 		goto err;
 	}
 	if (!FP2_sub(group, &r->f[2], &r->f[2], &v0)) {
@@ -232,116 +232,55 @@ err:
 	FP2_free(&v2);
 	FP2_free(&v1);
 	FP2_free(&v0);
+	return ret;
 }
 
-int FP6_mul_unr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_CTX *ctx) {
-	FP2 v0, v1, v2, t0, t1, t2;
-	int ret = 0;
-
-	FP2_init(&v0);
-	FP2_init(&v1);
-	FP2_init(&v2);
-	FP2_init(&t0);
-	FP2_init(&t1);
-	FP2_init(&t2);
+int FP6_mul_unr(const PAIRING_GROUP *group, DV6 *r, const FP6 *a, const FP6 *b) {
+	FP2 t0, t1;
+	DV2 v0, v1, v2, u0, u1;
 
 	/* v0 = a_0b_0 */
-	if (!FP2_mul_unr(group, &v0, &a->f[0], &b->f[0], ctx)) {
-		goto err;
-	}
+	FP2_mul_unr(group, &v0, &a->f[0], &b->f[0]);
 
 	/* v1 = a_1b_1 */
-	if (!FP2_mul_unr(group, &v1, &a->f[1], &b->f[1], ctx)) {
-		goto err;
-	}
+	FP2_mul_unr(group, &v1, &a->f[1], &b->f[1]);
 
 	/* v2 = a_2b_2 */
-	if (!FP2_mul_unr(group, &v2, &a->f[2], &b->f[2], ctx)) {
-		goto err;
-	}
+	FP2_mul_unr(group, &v2, &a->f[2], &b->f[2]);
 
-	/* t2 (c_0) = v0 + E((a_1 + a_2)(b_1 + b_2) - v1 - v2) */
-	if (!FP2_add(group, &t0, &a->f[1], &a->f[2])) {
-		goto err;
-	}
-	if (!FP2_add(group, &t1, &b->f[1], &b->f[2])) {
-		goto err;
-	}
-	if (!FP2_mul_unr(group, &t2, &t0, &t1, ctx)) {
-		goto err;
-	}
-	if (!FP2_sub(group, &t2, &t2, &v1)) {
-		goto err;
-	}
-	if (!FP2_sub(group, &t2, &t2, &v2)) {
-		goto err;
-	}
-	if (!FP2_mul_nor(group, &t0, &t2, ctx)) {
-		goto err;
-	}
-	if (!FP2_add(group, &t2, &t0, &v0)) {
-		goto err;
-	}
+	/* u0 (c_0) = v0 + E((a_1 + a_2)(b_1 + b_2) - v1 - v2) */
+	FP2_add(group, &t0, &a->f[1], &a->f[2]);
+	FP2_add(group, &t1, &b->f[1], &b->f[2]);
+	FP2_mul_unr(group, &u0, &t0, &t1);
+	DV2_sub(&u0, &u0, &v1);
+	DV2_sub(&u0, &u0, &v2);
+	DV2_mul_nor(&u0, &u0);
+	DV2_add(&u0, &u0, &v0);
 
 	/* c_1 = (a_0 + a_1)(b_0 + b_1) - v0 - v1 + Ev2 */
-	if (!FP2_add(group, &t0, &a->f[0], &a->f[1])) {
-		goto err;
-	}
-	if (!FP2_add(group, &t1, &b->f[0], &b->f[1])) {
-		goto err;
-	}
-	if (!FP2_mul_unr(group, &r->f[1], &t0, &t1, ctx)) {
-		goto err;
-	}
-	if (!FP2_sub(group, &r->f[1], &r->f[1], &v0)) {
-		goto err;
-	}
-	if (!FP2_sub(group, &r->f[1], &r->f[1], &v1)) {
-		goto err;
-	}
-	if (!FP2_mul_nor(group, &t0, &v2, ctx)) {
-		goto err;
-	}
-	if (!FP2_add(group, &r->f[1], &r->f[1], &t0)) {
-		goto err;
-	}
+	FP2_add(group, &t0, &a->f[0], &a->f[1]);
+	FP2_add(group, &t1, &b->f[0], &b->f[1]);
+	FP2_mul_unr(group, &u1, &t0, &t1);
+	DV2_sub(&u1, &u1, &v0);
+	DV2_sub(&u1, &u1, &v1);
+	DV2_mul_nor(&r->f[1], &v2);
+	DV2_add(&r->f[1], &r->f[1], &u1);
 
 	/* c_2 = (a_0 + a_2)(b_0 + b_2) - v0 + v1 - v2 */
-	if (!FP2_add(group, &t0, &a->f[0], &a->f[2])) {
-		goto err;
-	}
-	if (!FP2_add(group, &t1, &b->f[0], &b->f[2])) {
-		goto err;
-	}
-	if (!FP2_mul_unr(group, &r->f[2], &t0, &t1, ctx)) {
-		goto err;
-	}
-	if (!FP2_sub(group, &r->f[2], &r->f[2], &v0)) {
-		goto err;
-	}
-	if (!FP2_add(group, &r->f[2], &r->f[2], &v1)) {
-		goto err;
-	}
-	if (!FP2_sub(group, &r->f[2], &r->f[2], &v2)) {
-		goto err;
-	}
-
-	/* c_0 = t2 */
-	FP2_copy(&r->f[0], &t2);
+	FP2_add(group, &t0, &a->f[0], &a->f[2]);
+	FP2_add(group, &t1, &b->f[0], &b->f[2]);
+	FP2_mul_unr(group, &r->f[2], &t0, &t1);
+	DV2_sub(&r->f[2], &r->f[2], &v0);
+	DV2_add(&r->f[2], &r->f[2], &v1);
+	DV2_sub(&r->f[2], &r->f[2], &v2);
 
-	ret = 1;
+	/* c_0 = u0 */
+	r->f[0] = u0;
 
-err:
-	FP2_free(&t2);
-	FP2_free(&t1);
-	FP2_free(&t0);
-	FP2_free(&v2);
-	FP2_free(&v1);
-	FP2_free(&v0);
-	return ret;
+	return 1;
 }
 
-int FP6_mul_dxs(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b, BN_CTX *ctx) {
+int FP6_mul_dxs(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b) {
 	FP2 v0, v1, v2, t0, t1, t2;
 	int ret = 0;
 
@@ -353,12 +292,12 @@ int FP6_mul_dxs(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b,
 	FP2_init(&t2);
 
 	/* v0 = a_0b_0 */
-	if (!FP2_mul(group, &v0, &a->f[0], &b->f[0], ctx)) {
+	if (!FP2_mul(group, &v0, &a->f[0], &b->f[0])) {
 		goto err;
 	}
 
 	/* v1 = a_1b_1 */
-	if (!FP2_mul(group, &v1, &a->f[1], &b->f[1], ctx)) {
+	if (!FP2_mul(group, &v1, &a->f[1], &b->f[1])) {
 		goto err;
 	}
 
@@ -368,13 +307,13 @@ int FP6_mul_dxs(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b,
 	if (!FP2_add(group, &t0, &a->f[1], &a->f[2])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &t0, &t0, &b->f[1], ctx)) {
+	if (!FP2_mul(group, &t0, &t0, &b->f[1])) {
 		goto err;
 	}
 	if (!FP2_sub(group, &t0, &t0, &v1)) {
 		goto err;
 	}
-	if (!FP2_mul_nor(group, &t2, &t0, ctx)) {
+	if (!FP2_mul_nor(group, &t2, &t0)) {
 		goto err;
 	}
 	if (!FP2_add(group, &t2, &t2, &v0)) {
@@ -388,7 +327,7 @@ int FP6_mul_dxs(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b,
 	if (!FP2_add(group, &t1, &b->f[0], &b->f[1])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &r->f[1], &t0, &t1, ctx)) {
+	if (!FP2_mul(group, &r->f[1], &t0, &t1)) {
 		goto err;
 	}
 	if (!FP2_sub(group, &r->f[1], &r->f[1], &v0)) {
@@ -402,7 +341,7 @@ int FP6_mul_dxs(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, const FP6 *b,
 	if (!FP2_add(group, &t0, &a->f[0], &a->f[2])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &r->f[2], &t0, &b->f[0], ctx)) {
+	if (!FP2_mul(group, &r->f[2], &t0, &b->f[0])) {
 		goto err;
 	}
 	if (!FP2_sub(group, &r->f[2], &r->f[2], &v0)) {
@@ -427,17 +366,90 @@ err:
 	return ret;
 }
 
-int FP6_rdc(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
+int FP6_mul_dxs_unr(const PAIRING_GROUP *group, DV6 *r, const FP6 *a, const FP6 *b) {
+	FP2 t0, t1;
+	DV2 v0, v1, u0;
+
+	/* Same as FP6_mul_unr, but b_2 = 0. */
+
+	/* v0 = a_0b_0 */
+	FP2_mul_unr(group, &v0, &a->f[0], &b->f[0]);
+
+	/* v1 = a_1b_1 */
+	FP2_mul_unr(group, &v1, &a->f[1], &b->f[1]);
+
+	/* u0 (c_0) = v0 + E((a_1 + a_2)b_1 - v1) */
+	FP2_add(group, &t0, &a->f[1], &a->f[2]);
+	FP2_mul_unr(group, &u0, &t0, &b->f[1]);
+	DV2_sub(&u0, &u0, &v1);
+	DV2_mul_nor(&u0, &u0);
+	DV2_add(&u0, &u0, &v0);
+
+	/* c_1 = (a_0 + a_1)(b_0 + b_1) - v0 - v1 */
+	FP2_add(group, &t0, &a->f[0], &a->f[1]);
+	FP2_add(group, &t1, &b->f[0], &b->f[1]);
+	FP2_mul_unr(group, &r->f[1], &t0, &t1);
+	DV2_sub(&r->f[1], &r->f[1], &v0);
+	DV2_sub(&r->f[1], &r->f[1], &v1);
+
+	/* c_2 = (a_0 + a_2)b_0 - v0 + v1 */
+	FP2_add(group, &t0, &a->f[0], &a->f[2]);
+	FP2_mul_unr(group, &r->f[2], &t0, &b->f[0]);
+	DV2_sub(&r->f[2], &r->f[2], &v0);
+	DV2_add(&r->f[2], &r->f[2], &v1);
+
+	/* c_0 = u0 */
+	r->f[0] = u0;
+
+	return 1;
+}
+
+int FP6_sqr_unr(const PAIRING_GROUP *group, DV6 *r, const FP6 *a) {
+	FP2 t0;
+	DV2 v0, v1, v2, v3, v4;
+
+	/* v0 = a_0^2, v2 = a_2^2. */
+	FP2_sqr_unr(group, &v0, &a->f[0]);
+	FP2_sqr_unr(group, &v2, &a->f[2]);
+
+	/* v1 = 2a_1a_2, v3 = 2a_0a_1. */
+	FP2_add(group, &t0, &a->f[1], &a->f[1]);
+	FP2_mul_unr(group, &v1, &t0, &a->f[2]);
+	FP2_mul_unr(group, &v3, &a->f[0], &t0);
+
+	/* v4 = (a_0 - a_1 + a_2)^2. */
+	FP2_sub(group, &t0, &a->f[0], &a->f[1]);
+	FP2_add(group, &t0, &t0, &a->f[2]);
+	FP2_sqr_unr(group, &v4, &t0);
+
+	/* c_2 = v4 + v3 + v1 - v0 - v2 = 2a_0a_2 + a_1^2. */
+	DV2_add(&r->f[2], &v4, &v3);
+	DV2_add(&r->f[2], &r->f[2], &v1);
+	DV2_sub(&r->f[2], &r->f[2], &v0);
+	DV2_sub(&r->f[2], &r->f[2], &v2);
+
+	/* c_0 = v0 + Ev1. */
+	DV2_mul_nor(&v1, &v1);
+	DV2_add(&r->f[0], &v0, &v1);
+
+	/* c_1 = v3 + Ev2. */
+	DV2_mul_nor(&v2, &v2);
+	DV2_add(&r->f[1], &v3, &v2);
+
+	return 1;
+}
+
+int FP6_rdc(const PAIRING_GROUP *group, FP6 *r, const DV6 *a) {
 	int ret = 0;
 
-	/* c_0 = t1 mod p. */
-	if (!FP2_rdc(group, &r->f[0], &a->f[0], ctx)) {
+	/* c_i = a_i * R^{-1} mod p. */
+	if (!FP2_rdc(group, &r->f[0], &a->f[0])) {
 		goto err;
 	}
-	if (!FP2_rdc(group, &r->f[1], &a->f[1], ctx)) {
+	if (!FP2_rdc(group, &r->f[1], &a->f[1])) {
 		goto err;
 	}
-	if (!FP2_rdc(group, &r->f[2], &a->f[2], ctx)) {
+	if (!FP2_rdc(group, &r->f[2], &a->f[2])) {
 		goto err;
 	}
 
@@ -447,14 +459,36 @@ err:
 	return ret;
 }
 
-int FP6_mul_art(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
+void DV6_add(DV6 *r, const DV6 *a, const DV6 *b) {
+	DV2_add(&r->f[0], &a->f[0], &b->f[0]);
+	DV2_add(&r->f[1], &a->f[1], &b->f[1]);
+	DV2_add(&r->f[2], &a->f[2], &b->f[2]);
+}
+
+void DV6_sub(DV6 *r, const DV6 *a, const DV6 *b) {
+	DV2_sub(&r->f[0], &a->f[0], &b->f[0]);
+	DV2_sub(&r->f[1], &a->f[1], &b->f[1]);
+	DV2_sub(&r->f[2], &a->f[2], &b->f[2]);
+}
+
+void DV6_mul_art(DV6 *r, const DV6 *a) {
+	DV2 t0;
+
+	/* (a_0 + a_1v + a_2v^2) * v = Ea_2 + a_0v + a_1v^2. */
+	t0 = a->f[0];
+	DV2_mul_nor(&r->f[0], &a->f[2]);
+	r->f[2] = a->f[1];
+	r->f[1] = t0;
+}
+
+int FP6_mul_art(const PAIRING_GROUP *group, FP6 *r, const FP6 *a) {
 	FP2 t0;
 	int ret = 0;
 
 	FP2_init(&t0);
 
 	FP2_copy(&t0, &a->f[0]);
-	if (!FP2_mul_nor(group, &r->f[0], &a->f[2], ctx)) {
+	if (!FP2_mul_nor(group, &r->f[0], &a->f[2])) {
 		goto err;
 	}
 	FP2_copy(&r->f[2], &a->f[1]);
@@ -467,7 +501,7 @@ err:
 	return ret;
 }
 
-int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
+int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a) {
 	FP2 t0, t1, t2, t3, t4;
 	int ret = 0;
 
@@ -478,12 +512,12 @@ int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	FP2_init(&t4);
 
 	/* t0 = a_0^2 */
-	if (!FP2_sqr(group, &t0, &a->f[0], ctx)) {
+	if (!FP2_sqr(group, &t0, &a->f[0])) {
 		goto err;
 	}
 
 	/* t1 = 2 * a_1 * a_2 */
-	if (!FP2_mul(group, &t1, &a->f[1], &a->f[2], ctx)) {
+	if (!FP2_mul(group, &t1, &a->f[1], &a->f[2])) {
 		goto err;
 	}
 	if (!FP2_add(group, &t1, &t1, &t1)) {
@@ -491,7 +525,7 @@ int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	}
 
 	/* t2 = a_2^2. */
-	if (!FP2_sqr(group, &t2, &a->f[2], ctx)) {
+	if (!FP2_sqr(group, &t2, &a->f[2])) {
 		goto err;
 	}
 
@@ -504,7 +538,7 @@ int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	if (!FP2_add(group, &t3, &r->f[2], &a->f[1])) {
 		goto err;
 	}
-	if (!FP2_sqr(group, &t3, &t3, ctx)) {
+	if (!FP2_sqr(group, &t3, &t3)) {
 		goto err;
 	}
 
@@ -512,7 +546,7 @@ int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	if (!FP2_sub(group, &r->f[2], &r->f[2], &a->f[1])) {
 		goto err;
 	}
-	if (!FP2_sqr(group, &r->f[2], &r->f[2], ctx)) {
+	if (!FP2_sqr(group, &r->f[2], &r->f[2])) {
 		goto err;
 	}
 
@@ -520,20 +554,7 @@ int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	if (!FP2_add(group, &r->f[2], &r->f[2], &t3)) {
 		goto err;
 	}
-	if (BN_is_bit_set(&r->f[2].f[0], 0)) {
-		if (!BN_add(&r->f[2].f[0], &r->f[2].f[0], group->field)) {
-			goto err;
-		}
-	}
-	if (!BN_rshift1(&r->f[2].f[0], &r->f[2].f[0])) {
-		goto err;
-	}
-	if (BN_is_bit_set(&r->f[2].f[1], 0)) {
-		if (!BN_add(&r->f[2].f[1], &r->f[2].f[1], group->field)) {
-			goto err;
-		}
-	}
-	if (!BN_rshift1(&r->f[2].f[1], &r->f[2].f[1])) {
+	if (!FP2_hlv(group, &r->f[2], &r->f[2])) {
 		goto err;
 	}
 
@@ -554,7 +575,7 @@ int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	}
 
 	/* c0 = t0 + t1 * E. */
-	if (!FP2_mul_nor(group, &t4, &t1, ctx)) {
+	if (!FP2_mul_nor(group, &t4, &t1)) {
 		goto err;
 	}
 	if (!FP2_add(group, &r->f[0], &t0, &t4)) {
@@ -562,7 +583,7 @@ int FP6_sqr(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	}
 
 	/* c1 = t3 + t2 * E. */
-	if (!FP2_mul_nor(group, &t4, &t2, ctx)) {
+	if (!FP2_mul_nor(group, &t4, &t2)) {
 		goto err;
 	}
 	if (!FP2_add(group, &r->f[1], &t3, &t4)) {
@@ -579,7 +600,7 @@ err:
 	return ret;
 }
 
-int FP6_sqr2(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
+int FP6_sqr2(const PAIRING_GROUP *group, FP6 *r, const FP6 *a) {
 	FP2 t0, t1, t2, t3, t4;
 	int ret = 0;
 
@@ -590,12 +611,12 @@ int FP6_sqr2(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	FP2_init(&t4);
 
 	/* t0 = a_0^2 */
-	if (!FP2_sqr(group, &t0, &a->f[0], ctx)) {
+	if (!FP2_sqr(group, &t0, &a->f[0])) {
 		goto err;
 	}
 
 	/* t1 = 2 * a_0 * a_1 */
-	if (!FP2_mul(group, &t1, &a->f[0], &a->f[1], ctx)) {
+	if (!FP2_mul(group, &t1, &a->f[0], &a->f[1])) {
 		goto err;
 	}
 	if (!FP2_add(group, &t1, &t1, &t1)) {
@@ -609,12 +630,12 @@ int FP6_sqr2(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	if (!FP2_add(group, &t2, &t2, &a->f[2])) {
 		goto err;
 	}
-	if (!FP2_sqr(group, &t2, &t2, ctx)) {
+	if (!FP2_sqr(group, &t2, &t2)) {
 		goto err;
 	}
 
 	/* t3 = 2 * a_1 * a_2 */
-	if (!FP2_mul(group, &t3, &a->f[1], &a->f[2], ctx)) {
+	if (!FP2_mul(group, &t3, &a->f[1], &a->f[2])) {
 		goto err;
 	}
 	if (!FP2_add(group, &t3, &t3, &t3)) {
@@ -622,12 +643,12 @@ int FP6_sqr2(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	}
 
 	/* t4 = a_2^2 */
-	if (!FP2_sqr(group, &t4, &a->f[2], ctx)) {
+	if (!FP2_sqr(group, &t4, &a->f[2])) {
 		goto err;
 	}
 
 	/* c_0 = t0 + E * t3 */
-	if (!FP2_mul_nor(group, &r->f[0], &t3, ctx)) {
+	if (!FP2_mul_nor(group, &r->f[0], &t3)) {
 		goto err;
 	}
 	if (!FP2_add(group, &r->f[0], &r->f[0], &t0)) {
@@ -635,7 +656,7 @@ int FP6_sqr2(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	}
 
 	/* c_1 = t1 + E * t4 */
-	if (!FP2_mul_nor(group, &r->f[1], &t4, ctx)) {
+	if (!FP2_mul_nor(group, &r->f[1], &t4)) {
 		goto err;
 	}
 	if (!FP2_add(group, &r->f[1], &r->f[1], &t1)) {
@@ -667,23 +688,24 @@ err:
 	return ret;
 }
 
-int FP6_inv(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
-	FP2 v0, v1, v2, t0;
-	int ret;
+int FP6_inv_adj(const PAIRING_GROUP *group, FP6 *r, FP2 *t, const FP6 *a) {
+	FP2 v0, v1, v2, t0, t1;
+	int ret = 0;
 
 	FP2_init(&v0);
 	FP2_init(&v1);
 	FP2_init(&v2);
 	FP2_init(&t0);
+	FP2_init(&t1);
 
 	/* v0 = a_0^2 - E * a_1 * a_2. */
-	if (!FP2_sqr(group, &t0, &a->f[0], ctx)) {
+	if (!FP2_sqr(group, &t0, &a->f[0])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &v0, &a->f[1], &a->f[2], ctx)) {
+	if (!FP2_mul(group, &v0, &a->f[1], &a->f[2])) {
 		goto err;
 	}
-	if (!FP2_mul_nor(group, &v2, &v0, ctx)) {
+	if (!FP2_mul_nor(group, &v2, &v0)) {
 		goto err;
 	}
 	if (!FP2_sub(group, &v0, &t0, &v2)) {
@@ -691,13 +713,13 @@ int FP6_inv(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	}
 
 	/* v1 = E * a_2^2 - a_0 * a_1. */
-	if (!FP2_sqr(group, &t0, &a->f[2], ctx)) {
+	if (!FP2_sqr(group, &t0, &a->f[2])) {
 		goto err;
 	}
-	if (!FP2_mul_nor(group, &v2, &t0, ctx)) {
+	if (!FP2_mul_nor(group, &v2, &t0)) {
 		goto err;
 	}
-	if (!FP2_mul(group, &v1, &a->f[0], &a->f[1], ctx)) {
+	if (!FP2_mul(group, &v1, &a->f[0], &a->f[1])) {
 		goto err;
 	}
 	if (!FP2_sub(group, &v1, &v2, &v1)) {
@@ -705,59 +727,69 @@ int FP6_inv(const PAIRING_GROUP *group, FP6 *r, const FP6 *a, BN_CTX *ctx) {
 	}
 
 	/* v2 = a_1^2 - a_0 * a_2. */
-	if (!FP2_sqr(group, &t0, &a->f[1], ctx)) {
+	if (!FP2_sqr(group, &t0, &a->f[1])) {
 		goto err;
 	}
-	if (!FP2_mul(group, &v2, &a->f[0], &a->f[2], ctx)) {
+	if (!FP2_mul(group, &v2, &a->f[0], &a->f[2])) {
 		goto err;
 	}
 	if (!FP2_sub(group, &v2, &t0, &v2)) {
 		goto err;
 	}
 
-	if (!FP2_mul(group, &t0, &a->f[1], &v2, ctx)) {
+	/* t = a_0 * v0 + E * (a_1 * v2 + a_2 * v1), so that a^-1 = (v0, v1, v2) / t. */
+	if (!FP2_mul(group, &t0, &a->f[1], &v2)) {
 		goto err;
 	}
-	if (!FP2_mul_nor(group, &r->f[1], &t0, ctx)) {
+	if (!FP2_mul(group, &t1, &a->f[2], &v1)) {
 		goto err;
 	}
-
-	if (!FP2_mul(group, &r->f[0], &a->f[0], &v0, ctx)) {
+	if (!FP2_add(group, &t0, &t0, &t1)) {
 		goto err;
 	}
-
-	if (!FP2_mul(group, &t0, &a->f[2], &v1, ctx)) {
+	if (!FP2_mul_nor(group, &t0, &t0)) {
 		goto err;
 	}
-	if (!FP2_mul_nor(group, &r->f[2], &t0, ctx)) {
+	if (!FP2_mul(group, &t1, &a->f[0], &v0)) {
 		goto err;
 	}
-
-	if (!FP2_add(group, &t0, &r->f[0], &r->f[1])) {
-		goto err;
-	}
-	if (!FP2_add(group, &t0, &t0, &r->f[2])) {
-		goto err;
-	}
-	if (!FP2_inv(group, &t0, &t0, ctx)) {
+	if (!FP2_add(group, t, &t0, &t1)) {
 		goto err;
 	}
+	FP2_copy(&r->f[0], &v0);
+	FP2_copy(&r->f[1], &v1);
+	FP2_copy(&r->f[2], &v2);
 
-	if (!FP2_mul(group, &r->f[0], &v0, &t0, ctx)) {
+	ret = 1;
+err:
+	FP2_free(&v0);
+	FP2_free(&v1);
+	FP2_free(&v2);
+	FP2_free(&t0);
+	FP2_free(&t1);
+	return ret;
+}
+
+int FP6_inv(const PAIRING_GROUP *group, FP6 *r, const FP6 *a) {
+	FP2 t;
+	int i, ret = 0;
+
+	FP2_init(&t);
+
+	if (!FP6_inv_adj(group, r, &t, a)) {
 		goto err;
 	}
-	if (!FP2_mul(group, &r->f[1], &v1, &t0, ctx)) {
+	if (!FP2_inv(group, &t, &t)) {
 		goto err;
 	}
-	if (!FP2_mul(group, &r->f[2], &v2, &t0, ctx)) {
-		goto err;
+	for (i = 0; i < 3; i++) {
+		if (!FP2_mul(group, &r->f[i], &r->f[i], &t)) {
+			goto err;
+		}
 	}
 
 	ret = 1;
 err:
-	FP2_free(&v0);
-	FP2_free(&v1);
-	FP2_free(&v2);
-	FP2_free(&t0);
+	FP2_free(&t);
 	return ret;
 }
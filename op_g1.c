@@ -0,0 +1,714 @@
+/*
+ * OpenPairing is an implementation of a bilinear pairing over OpenSSL
+ * Copyright (C) 2015 OpenPairing Authors
+ *
+ * This file is part of OpenPairing. OpenPairing is legal property of its
+ * developers, whose names are not listed here. Please refer to the COPYRIGHT
+ * file for contact information.
+ *
+ * OpenPairing is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OpenPairing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenPairing. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "op.h"
+
+/* Window width of the w-NAF digits used by G1_mul_glv. */
+#define G1_WIN		5
+
+/* Odd multiples of each base point kept by G1_mul_glv. */
+#define G1_TAB		(1 << (G1_WIN - 2))
+
+/* Fewest buckets for which G1_msm accumulates them in batched affine form. */
+#define G1_AFF		64
+
+/* Largest batch of affine bucket additions sharing one inversion. */
+#define G1_BATCH	256
+
+/*
+ * The public interface takes OpenSSL points on group.ec, but the arithmetic
+ * runs on our own field elements: points on y^2 = x^3 + 2 in Jacobian
+ * coordinates, with Z = 0 at infinity, using the same formulas as G2.
+ */
+typedef struct {
+	FP x, y, z;
+} g1_point;
+
+/*
+ * GLV lattice for (x, y) -> (beta * x, y), which acts on G1 as
+ * lambda = 36x^3 + 18x^2 + 6x + 1. See op_decomp for the layout.
+ */
+static const int g1_basis[4][4] = {
+	{ 1, 4, 6 }, { 1, 2 }, { -1, -2 }, { 0, 2, 6 }
+};
+
+static const int g1_dual[2][4] = {
+	{ 0, 2, 6 }, { -1, -2 }
+};
+
+static void g1_set_infty(g1_point *p) {
+	FP_zero(&p->x);
+	FP_zero(&p->y);
+	FP_zero(&p->z);
+}
+
+static int g1_is_infty(const g1_point *p) {
+	return FP_is_zero(&p->z);
+}
+
+static void g1_dbl(g1_point *r, const g1_point *a) {
+	FP t0, t1, t2, t3, t4;
+
+	if (g1_is_infty(a)) {
+		g1_set_infty(r);
+		return;
+	}
+
+	/* dbl-2009-l, as in G2_dbl. */
+	FP_mul(&t4, &a->y, &a->z);
+	FP_sqr(&t0, &a->x);
+	FP_sqr(&t1, &a->y);
+	FP_sqr(&t2, &t1);
+	FP_add(&t1, &t1, &a->x);
+	FP_sqr(&t1, &t1);
+	FP_sub(&t1, &t1, &t0);
+	FP_sub(&t1, &t1, &t2);
+	FP_dbl(&t1, &t1);
+	FP_dbl(&t3, &t0);
+	FP_add(&t0, &t3, &t0);
+	FP_sqr(&t3, &t0);
+	FP_sub(&t3, &t3, &t1);
+	FP_sub(&r->x, &t3, &t1);
+	FP_sub(&t1, &t1, &r->x);
+	FP_mul(&t1, &t1, &t0);
+	FP_dbl(&t2, &t2);
+	FP_dbl(&t2, &t2);
+	FP_dbl(&t2, &t2);
+	FP_sub(&r->y, &t1, &t2);
+	FP_dbl(&r->z, &t4);
+}
+
+/* Adds a to b, where b has Z = 1 (madd-2007-bl, as in G2_add). */
+static void g1_add_mix(g1_point *r, const g1_point *a, const g1_point *b) {
+	FP t0, t1, t2, t3, t4, t5;
+
+	if (g1_is_infty(a)) {
+		*r = *b;
+		return;
+	}
+
+	FP_sqr(&t0, &a->z);
+	FP_mul(&t1, &b->x, &t0);
+	FP_mul(&t2, &b->y, &a->z);
+	FP_mul(&t2, &t2, &t0);
+	FP_sub(&t1, &t1, &a->x);
+	FP_sub(&t2, &t2, &a->y);
+	if (FP_is_zero(&t1)) {
+		if (FP_is_zero(&t2)) {
+			g1_dbl(r, b);
+		} else {
+			g1_set_infty(r);
+		}
+		return;
+	}
+	FP_dbl(&t2, &t2);
+	FP_sqr(&t3, &t1);
+	FP_add(&t4, &a->z, &t1);
+	FP_sqr(&t4, &t4);
+	FP_sub(&t4, &t4, &t0);
+	FP_sub(&r->z, &t4, &t3);
+	FP_dbl(&t3, &t3);
+	FP_dbl(&t3, &t3);
+	FP_mul(&t1, &t1, &t3);
+	FP_mul(&t3, &a->x, &t3);
+	FP_mul(&t5, &a->y, &t1);
+	FP_dbl(&t5, &t5);
+	FP_sqr(&t4, &t2);
+	FP_sub(&t4, &t4, &t1);
+	FP_sub(&t4, &t4, &t3);
+	FP_sub(&r->x, &t4, &t3);
+	FP_sub(&t3, &t3, &r->x);
+	FP_mul(&t3, &t3, &t2);
+	FP_sub(&r->y, &t3, &t5);
+}
+
+/* Adds two points with arbitrary Z (add-2007-bl, as in G2_add). */
+static void g1_add(g1_point *r, const g1_point *a, const g1_point *b) {
+	FP z1, z2, u1, u2, s1, s2, t;
+
+	if (g1_is_infty(a)) {
+		*r = *b;
+		return;
+	}
+	if (g1_is_infty(b)) {
+		*r = *a;
+		return;
+	}
+
+	FP_sqr(&z1, &a->z);
+	FP_sqr(&z2, &b->z);
+	FP_mul(&u1, &a->x, &z2);
+	FP_mul(&u2, &b->x, &z1);
+	FP_mul(&s1, &a->y, &b->z);
+	FP_mul(&s1, &s1, &z2);
+	FP_mul(&s2, &b->y, &a->z);
+	FP_mul(&s2, &s2, &z1);
+	FP_sub(&u2, &u2, &u1);
+	FP_sub(&s2, &s2, &s1);
+	if (FP_is_zero(&u2)) {
+		if (FP_is_zero(&s2)) {
+			g1_dbl(r, a);
+		} else {
+			g1_set_infty(r);
+		}
+		return;
+	}
+	FP_dbl(&s2, &s2);
+	FP_add(&t, &a->z, &b->z);
+	FP_sqr(&t, &t);
+	FP_sub(&t, &t, &z1);
+	FP_sub(&t, &t, &z2);
+	FP_mul(&r->z, &t, &u2);
+	FP_dbl(&t, &u2);
+	FP_sqr(&t, &t);
+	FP_mul(&u2, &u2, &t);
+	FP_mul(&u1, &u1, &t);
+	FP_sqr(&t, &s2);
+	FP_sub(&t, &t, &u2);
+	FP_sub(&t, &t, &u1);
+	FP_sub(&r->x, &t, &u1);
+	FP_sub(&u1, &u1, &r->x);
+	FP_mul(&u1, &u1, &s2);
+	FP_mul(&s1, &s1, &u2);
+	FP_dbl(&s1, &s1);
+	FP_sub(&r->y, &u1, &s1);
+}
+
+/* Brings n points to Z = 1 (or leaves them at infinity) with one inversion. */
+static int g1_norm_sim(const PAIRING_GROUP *group, g1_point *p, int n) {
+	FP sz[INV_STACK], *z = NULL, t;
+	int i, ret = 0;
+
+	if (n <= INV_STACK) {
+		z = sz;
+	} else if ((z = OPENSSL_malloc(n * sizeof(FP))) == NULL) {
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		FP_copy(&z[i], &p[i].z);
+	}
+	if (!FP_inv_batch(z, z, n)) {
+		goto err;
+	}
+	for (i = 0; i < n; i++) {
+		if (!g1_is_infty(&p[i])) {
+			FP_sqr(&t, &z[i]);
+			FP_mul(&p[i].x, &p[i].x, &t);
+			FP_mul(&t, &t, &z[i]);
+			FP_mul(&p[i].y, &p[i].y, &t);
+			FP_copy(&p[i].z, &group->one);
+		}
+	}
+	ret = 1;
+
+err:
+	if (z != sz) {
+		OPENSSL_free(z);
+	}
+	return ret;
+}
+
+/* Converts an OpenSSL point into a normalized g1_point. */
+static int g1_read(const PAIRING_GROUP *group, g1_point *r, const EC_POINT *a, BN_CTX *ctx) {
+	BIGNUM *x, *y;
+	int ret = 0;
+
+	if (EC_POINT_is_at_infinity(group->ec, a)) {
+		g1_set_infty(r);
+		return 1;
+	}
+
+	BN_CTX_start(ctx);
+	x = BN_CTX_get(ctx);
+	y = BN_CTX_get(ctx);
+	if (y == NULL || !EC_POINT_get_affine_coordinates_GFp(group->ec, a, x, y, ctx)) {
+		goto err;
+	}
+	if (!FP_read_bn(&r->x, x) || !FP_read_bn(&r->y, y)) {
+		goto err;
+	}
+	FP_copy(&r->z, &group->one);
+	ret = 1;
+
+err:
+	BN_CTX_end(ctx);
+	return ret;
+}
+
+/*
+ * Converts a g1_point back into an OpenSSL point. The affine coordinates go
+ * in with Z = 1, since the point is on the curve by construction and newer
+ * OpenSSL versions would check that again when setting affine coordinates.
+ */
+static int g1_write(const PAIRING_GROUP *group, EC_POINT *r, g1_point *a, BN_CTX *ctx) {
+	BIGNUM *x, *y;
+	int ret = 0;
+
+	if (g1_is_infty(a)) {
+		return EC_POINT_set_to_infinity(group->ec, r);
+	}
+	if (!g1_norm_sim(group, a, 1)) {
+		return 0;
+	}
+
+	BN_CTX_start(ctx);
+	x = BN_CTX_get(ctx);
+	y = BN_CTX_get(ctx);
+	if (y == NULL || !FP_write_bn(x, &a->x) || !FP_write_bn(y, &a->y)) {
+		goto err;
+	}
+	ret = EC_POINT_set_Jprojective_coordinates_GFp(group->ec, r, x, y, BN_value_one(), ctx);
+
+err:
+	BN_CTX_end(ctx);
+	return ret;
+}
+
+int G1_mul_glv(const PAIRING_GROUP *group, EC_POINT *r, const EC_POINT *a, const BIGNUM *k, BN_CTX *ctx) {
+	BN_CTX *new_ctx = NULL;
+	g1_point t[2 * G1_TAB], u, v;
+	signed char naf[2][GLV_DIGS];
+	BIGNUM *e[2];
+	int i, j, d, l, len[2], ret = 0;
+
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	e[0] = BN_CTX_get(ctx);
+	e[1] = BN_CTX_get(ctx);
+	if (e[1] == NULL || !g1_read(group, &u, a, ctx)) {
+		goto err;
+	}
+	if (g1_is_infty(&u)) {
+		ret = EC_POINT_set_to_infinity(group->ec, r);
+		goto err;
+	}
+	if (!op_decomp(group, e, k, g1_basis, g1_dual, 2, 0, ctx)) {
+		goto err;
+	}
+	for (i = 0; i < 2; i++) {
+		if ((len[i] = op_naf(naf[i], e[i], G1_WIN)) < 0) {
+			goto err;
+		}
+	}
+	l = (len[0] > len[1] ? len[0] : len[1]);
+
+	/* Odd multiples of a, then their images (beta * x, y), signed as e[i]. */
+	t[0] = u;
+	g1_dbl(&v, &u);
+	for (j = 1; j < G1_TAB; j++) {
+		g1_add(&t[j], &t[j - 1], &v);
+	}
+	if (!g1_norm_sim(group, t, G1_TAB)) {
+		goto err;
+	}
+	for (j = 0; j < G1_TAB; j++) {
+		t[G1_TAB + j] = t[j];
+		FP_mul(&t[G1_TAB + j].x, &t[j].x, &group->beta);
+	}
+	for (i = 0; i < 2; i++) {
+		if (BN_is_negative(e[i])) {
+			for (j = 0; j < G1_TAB; j++) {
+				FP_neg(&t[i * G1_TAB + j].y, &t[i * G1_TAB + j].y);
+			}
+		}
+	}
+
+	g1_set_infty(&u);
+	for (j = l - 1; j >= 0; j--) {
+		g1_dbl(&u, &u);
+		for (i = 0; i < 2; i++) {
+			d = (j < len[i] ? naf[i][j] : 0);
+			if (d > 0) {
+				g1_add_mix(&u, &u, &t[i * G1_TAB + d / 2]);
+			} else if (d < 0) {
+				v = t[i * G1_TAB - d / 2];
+				FP_neg(&v.y, &v.y);
+				g1_add_mix(&u, &u, &v);
+			}
+		}
+	}
+	ret = g1_write(group, r, &u, ctx);
+
+err:
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	return ret;
+}
+
+/* The windows of a G1_msm handled by one thread: w0, w0 + step, ... */
+typedef struct {
+	const PAIRING_GROUP *group;
+	const g1_point *p;
+	const uint64_t *s;
+	size_t n;
+	int c;
+	int w0;
+	int step;
+	g1_point *sum;
+	int ret;
+} g1_msm_job;
+
+/* Buckets of one thread and its pending affine additions, for op_msm_fill. */
+typedef struct {
+	const g1_msm_job *job;
+	g1_point *bk;
+	g1_point *add;
+	FP *den;
+	FP *pre;
+} g1_msm_buf;
+
+/* Signed point for digit d of point i, or zero if it contributes nothing. */
+static int g1_msm_pick(const g1_msm_job *job, size_t i, int w, g1_point *q) {
+	int d = op_msm_dig(job->s + i * FP_DIGS, w, job->c);
+
+	if (d == 0 || g1_is_infty(&job->p[i])) {
+		return 0;
+	}
+	*q = job->p[i];
+	if (d < 0) {
+		FP_neg(&q->y, &q->y);
+	}
+	return (d < 0 ? -d : d);
+}
+
+/* Queues bucket b += +-p[i] in slot k, unless the bucket or the point is empty. */
+static int g1_msm_put(void *arg, int b, size_t i, int neg, int k) {
+	g1_msm_buf *buf = (g1_msm_buf *)arg;
+	g1_point *t = &buf->bk[b], q = buf->job->p[i];
+	FP *den = &buf->den[k];
+
+	if (g1_is_infty(&q)) {
+		return 0;
+	}
+	if (neg) {
+		FP_neg(&q.y, &q.y);
+	}
+	if (g1_is_infty(t)) {
+		*t = q;
+		return 0;
+	}
+	if (FP_cmp(&t->x, &q.x) != 0) {
+		FP_sub(den, &q.x, &t->x);
+	} else if (FP_cmp(&t->y, &q.y) == 0) {
+		FP_dbl(den, &q.y);
+	} else {
+		/* q = -t, which empties the bucket. */
+		FP_zero(den);
+	}
+	buf->add[k] = q;
+	return 1;
+}
+
+/* Finishes the queued additions with a single inversion. */
+static int g1_msm_flush(void *arg, const int *idx, int k) {
+	g1_msm_buf *buf = (g1_msm_buf *)arg;
+	g1_point *t, *q;
+	FP l, u;
+	int j;
+
+	if (!FP_inv_batch_buf(buf->den, buf->den, k, buf->pre)) {
+		return 0;
+	}
+	for (j = 0; j < k; j++) {
+		t = &buf->bk[idx[j]];
+		q = &buf->add[j];
+		if (FP_is_zero(&buf->den[j])) {
+			g1_set_infty(t);
+			continue;
+		}
+		if (FP_cmp(&t->x, &q->x) == 0) {
+			FP_sqr(&u, &t->x);
+			FP_dbl(&l, &u);
+			FP_add(&l, &l, &u);
+		} else {
+			FP_sub(&l, &q->y, &t->y);
+		}
+		FP_mul(&l, &l, &buf->den[j]);
+		FP_sqr(&u, &l);
+		FP_sub(&u, &u, &t->x);
+		FP_sub(&u, &u, &q->x);
+		FP_sub(&t->x, &t->x, &u);
+		FP_mul(&l, &l, &t->x);
+		FP_sub(&t->y, &l, &t->y);
+		FP_copy(&t->x, &u);
+	}
+	return 1;
+}
+
+/*
+ * Fills the buckets of window w. With few buckets the points go straight in
+ * with mixed additions; otherwise op_msm_fill adds them in affine form, up to
+ * nb / 2 at a time under one inversion.
+ */
+static int g1_msm_fill(const g1_msm_job *job, g1_msm_buf *buf, OP_MSM *m, int w, int nb) {
+	size_t i;
+	int b, lim = (nb / 2 < G1_BATCH ? nb / 2 : G1_BATCH);
+	g1_point q;
+
+	for (b = 0; b < nb; b++) {
+		g1_set_infty(&buf->bk[b]);
+	}
+	if (nb >= G1_AFF) {
+		return op_msm_fill(m, job->s, job->n, w, job->c, lim);
+	}
+	for (i = 0; i < job->n; i++) {
+		if ((b = g1_msm_pick(job, i, w, &q)) != 0) {
+			g1_add_mix(&buf->bk[b - 1], &buf->bk[b - 1], &q);
+		}
+	}
+	return g1_norm_sim(job->group, buf->bk, nb);
+}
+
+static void *g1_msm_work(void *arg) {
+	g1_msm_job *job = (g1_msm_job *)arg;
+	g1_msm_buf buf;
+	OP_MSM m;
+	g1_point s, t;
+	int b, w, nb = 1 << (job->c - 1), nw = (ORD_BITS + job->c) / job->c;
+
+	job->ret = 0;
+	buf.job = job;
+	buf.bk = OPENSSL_malloc(nb * sizeof(g1_point));
+	buf.add = OPENSSL_malloc(G1_BATCH * sizeof(g1_point));
+	buf.den = OPENSSL_malloc(G1_BATCH * sizeof(FP));
+	buf.pre = OPENSSL_malloc(G1_BATCH * sizeof(FP));
+	m.put = g1_msm_put;
+	m.flush = g1_msm_flush;
+	m.arg = &buf;
+	if (!op_msm_init(&m, nb, G1_BATCH)) {
+		goto err;
+	}
+	if (buf.bk == NULL || buf.add == NULL || buf.den == NULL || buf.pre == NULL) {
+		goto err;
+	}
+
+	for (w = job->w0; w < nw; w += job->step) {
+		if (!g1_msm_fill(job, &buf, &m, w, nb)) {
+			goto err;
+		}
+		/* Running sums: bucket b ends up counted b + 1 times. */
+		g1_set_infty(&s);
+		g1_set_infty(&t);
+		for (b = nb - 1; b >= 0; b--) {
+			if (!g1_is_infty(&buf.bk[b])) {
+				g1_add_mix(&s, &s, &buf.bk[b]);
+			}
+			g1_add(&t, &t, &s);
+		}
+		job->sum[w] = t;
+	}
+	job->ret = 1;
+
+err:
+	op_msm_free(&m);
+	OPENSSL_free(buf.bk);
+	OPENSSL_free(buf.add);
+	OPENSSL_free(buf.den);
+	OPENSSL_free(buf.pre);
+	return NULL;
+}
+
+int G1_msm(const PAIRING_GROUP *group, EC_POINT *r, const EC_POINT **p, const BIGNUM **k,
+		size_t n, int threads, BN_CTX *ctx) {
+	BN_CTX *new_ctx = NULL;
+	g1_point *q = NULL, *sum = NULL, u;
+	g1_msm_job *job = NULL;
+	uint64_t *s = NULL;
+	BIGNUM *ord;
+	size_t i;
+	int c, j, w, nw, ret = 0;
+
+	if (n == 0) {
+		return EC_POINT_set_to_infinity(group->ec, r);
+	}
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	c = op_msm_win(n);
+	nw = (ORD_BITS + c) / c;
+	if (threads <= 0) {
+		threads = op_cpus();
+	}
+	if (threads > nw) {
+		threads = nw;
+	}
+
+	ord = BN_CTX_get(ctx);
+	q = OPENSSL_malloc(n * sizeof(g1_point));
+	s = OPENSSL_malloc(n * FP_DIGS * sizeof(uint64_t));
+	sum = OPENSSL_malloc(nw * sizeof(g1_point));
+	job = OPENSSL_malloc(threads * sizeof(g1_msm_job));
+	if (ord == NULL || q == NULL || s == NULL || sum == NULL || job == NULL) {
+		goto err;
+	}
+	if (!EC_GROUP_get_order(group->ec, ord, ctx)) {
+		goto err;
+	}
+	for (i = 0; i < n; i++) {
+		if (!g1_read(group, &q[i], p[i], ctx) || !op_msm_read(s + i * FP_DIGS, k[i], ord, ctx)) {
+			goto err;
+		}
+	}
+
+	/* Windows are dealt out round-robin, so every thread gets a similar share. */
+	for (j = 0; j < threads; j++) {
+		job[j].group = group;
+		job[j].p = q;
+		job[j].s = s;
+		job[j].n = n;
+		job[j].c = c;
+		job[j].w0 = j;
+		job[j].step = threads;
+		job[j].sum = sum;
+	}
+	op_parallel(g1_msm_work, job, sizeof(g1_msm_job), threads);
+	for (j = 0; j < threads; j++) {
+		if (!job[j].ret) {
+			goto err;
+		}
+	}
+
+	u = sum[nw - 1];
+	for (w = nw - 2; w >= 0; w--) {
+		for (j = 0; j < c; j++) {
+			g1_dbl(&u, &u);
+		}
+		g1_add(&u, &u, &sum[w]);
+	}
+	ret = g1_write(group, r, &u, ctx);
+
+err:
+	OPENSSL_free(q);
+	OPENSSL_free(s);
+	OPENSSL_free(sum);
+	OPENSSL_free(job);
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	return ret;
+}
+
+int G1_gen_table(PAIRING_GROUP *group, BN_CTX *ctx) {
+	g1_point *t = NULL, b, d;
+	FP (*tab)[2] = NULL;
+	int i, j, ret = 0;
+
+	t = OPENSSL_malloc(G1_GEN_DIGS * GEN_TAB * sizeof(g1_point));
+	tab = OPENSSL_malloc(G1_GEN_DIGS * GEN_TAB * sizeof(*tab));
+	if (t == NULL || tab == NULL) {
+		goto err;
+	}
+	if (!g1_read(group, &b, EC_GROUP_get0_generator(group->ec), ctx)) {
+		goto err;
+	}
+
+	/* Window j holds the odd multiples of b = 2^(GEN_WIN * j) * g1. */
+	for (j = 0; j < G1_GEN_DIGS; j++) {
+		t[j * GEN_TAB] = b;
+		g1_dbl(&d, &b);
+		for (i = 1; i < GEN_TAB; i++) {
+			g1_add(&t[j * GEN_TAB + i], &t[j * GEN_TAB + i - 1], &d);
+		}
+		for (i = 0; i < GEN_WIN; i++) {
+			g1_dbl(&b, &b);
+		}
+	}
+	if (!g1_norm_sim(group, t, G1_GEN_DIGS * GEN_TAB)) {
+		goto err;
+	}
+	for (i = 0; i < G1_GEN_DIGS * GEN_TAB; i++) {
+		FP_copy(&tab[i][0], &t[i].x);
+		FP_copy(&tab[i][1], &t[i].y);
+	}
+	OPENSSL_free(group->g1_tab);
+	group->g1_tab = tab;
+	tab = NULL;
+	ret = 1;
+
+err:
+	OPENSSL_free(t);
+	OPENSSL_free(tab);
+	return ret;
+}
+
+/* Sets q to d * 2^(GEN_WIN * j) * g1 for odd d, touching every entry of window j. */
+static void g1_gen_get(const PAIRING_GROUP *group, g1_point *q, int j, int d) {
+	FP (*tab)[2] = group->g1_tab + j * GEN_TAB;
+	int i, l, s = (d >> 31) & 1, e = (((d ^ -s) + s) - 1) >> 1;
+	uint64_t m, x[FP_DIGS] = { 0 }, y[FP_DIGS] = { 0 };
+	FP t;
+
+	/* Masks over local words, which the compiler can keep apart from the table. */
+	for (i = 0; i < GEN_TAB; i++) {
+		m = (uint64_t)0 - (uint64_t)(i == e);
+		for (l = 0; l < FP_DIGS; l++) {
+			x[l] |= m & tab[i][0].f[l];
+			y[l] |= m & tab[i][1].f[l];
+		}
+	}
+	for (l = 0; l < FP_DIGS; l++) {
+		q->x.f[l] = x[l];
+		q->y.f[l] = y[l];
+	}
+	FP_neg(&t, &q->y);
+	FP_copy_sec(&q->y, &t, s);
+	FP_copy(&q->z, &group->one);
+}
+
+int G1_mul_gen(const PAIRING_GROUP *group, EC_POINT *r, const BIGNUM *k, BN_CTX *ctx) {
+	BN_CTX *new_ctx = NULL;
+	signed char dig[2 * G1_GEN_DIGS];
+	g1_point u, v;
+	int i, j, ret = 0;
+
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	if (!op_gen_rec(group, dig, k, g1_basis, g1_dual, 2, G1_GEN_DIGS, ctx)) {
+		goto err;
+	}
+
+	/*
+	 * k = e[0] + e[1] * lambda, so u = e[1] * g1 goes through (x, y) ->
+	 * (beta * x, y), which also holds in Jacobian coordinates, before e[0] * g1
+	 * is added. All digits are odd, so every window contributes a point. The
+	 * partial sum stays apart from the next entry unless k is one of a handful
+	 * of values, for which the mixed addition falls back to doubling.
+	 */
+	g1_set_infty(&u);
+	for (i = 1; i >= 0; i--) {
+		FP_mul(&u.x, &u.x, &group->beta);
+		for (j = 0; j < G1_GEN_DIGS; j++) {
+			g1_gen_get(group, &v, j, dig[i * G1_GEN_DIGS + j]);
+			g1_add_mix(&u, &u, &v);
+		}
+	}
+	ret = g1_write(group, r, &u, ctx);
+
+err:
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	return ret;
+}
@@ -0,0 +1,870 @@
+/*
+ * OpenPairing is an implementation of a bilinear pairing over OpenSSL
+ * Copyright (C) 2015 OpenPairing Authors
+ *
+ * This file is part of OpenPairing. OpenPairing is legal property of its
+ * developers, whose names are not listed here. Please refer to the COPYRIGHT
+ * file for contact information.
+ *
+ * OpenPairing is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OpenPairing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenPairing. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "op.h"
+
+/* Window width of the w-NAF digits used by G2_mul_gls. */
+#define G2_WIN		4
+
+/* Odd multiples of each base point kept by G2_mul_gls. */
+#define G2_TAB		(1 << (G2_WIN - 2))
+
+/* Fewest buckets for which G2_msm accumulates them in batched affine form. */
+#define G2_AFF		64
+
+/* Largest batch of affine bucket additions sharing one inversion. */
+#define G2_BATCH	256
+
+/*
+ * Points on the sextic twist E'(Fp2): y^2 = x^3 + b', b' = 2/(1 + i) = 1 - i,
+ * in Jacobian coordinates (x, y) = (X/Z^2, Y/Z^3). The point at infinity has
+ * Z = 0. Formulas are the a = 0 ones of Bernstein and Lange; additions
+ * switch to the cheaper mixed formula when one operand has Z = 1.
+ */
+
+/* Sets b = 1 - i. */
+static void g2_twist_b(const PAIRING_GROUP *group, FP2 *b) {
+	FP_copy(&b->f[0], &group->one);
+	FP_neg(&b->f[1], &group->one);
+}
+
+/* Returns nonzero if z = 1. */
+static int g2_is_one(const PAIRING_GROUP *group, const FP2 *z) {
+	return FP_cmp(&z->f[0], &group->one) == 0 && FP_is_zero(&z->f[1]);
+}
+
+void G2_init(G2_POINT *p) {
+	FP2_init(&p->x);
+	FP2_init(&p->y);
+	FP2_init(&p->z);
+}
+
+void G2_free(G2_POINT *p) {
+	FP2_free(&p->x);
+	FP2_free(&p->y);
+	FP2_free(&p->z);
+}
+
+void G2_copy(G2_POINT *r, const G2_POINT *a) {
+	FP2_copy(&r->x, &a->x);
+	FP2_copy(&r->y, &a->y);
+	FP2_copy(&r->z, &a->z);
+}
+
+void G2_set_infty(G2_POINT *p) {
+	FP2_zero(&p->x);
+	FP2_zero(&p->y);
+	FP2_zero(&p->z);
+}
+
+int G2_is_infty(const G2_POINT *p) {
+	return FP2_is_zero(&p->z);
+}
+
+int G2_set_affine(const PAIRING_GROUP *group, G2_POINT *p, const FP2 *x, const FP2 *y) {
+	FP2_copy(&p->x, x);
+	FP2_copy(&p->y, y);
+	FP2_zero(&p->z);
+	FP_copy(&p->z.f[0], &group->one);
+	return 1;
+}
+
+int G2_get_affine(const PAIRING_GROUP *group, FP2 *x, FP2 *y, const G2_POINT *p) {
+	G2_POINT t;
+
+	if (!G2_norm(group, &t, p) || G2_is_infty(&t)) {
+		return 0;
+	}
+	FP2_copy(x, &t.x);
+	FP2_copy(y, &t.y);
+	return 1;
+}
+
+int G2_get_gen(const PAIRING_GROUP *group, G2_POINT *p) {
+	return G2_set_affine(group, p, group->g2x, group->g2y);
+}
+
+int G2_rand(const PAIRING_GROUP *group, G2_POINT *p, BN_CTX *ctx) {
+	BN_CTX *new_ctx = NULL;
+	BIGNUM *k, *n;
+	int ret = 0;
+
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	k = BN_CTX_get(ctx);
+	n = BN_CTX_get(ctx);
+	if (n == NULL) {
+		goto err;
+	}
+	/* The twist subgroup has the same prime order as G1. */
+	if (!EC_GROUP_get_order(group->ec, n, ctx) || !BN_rand_range(k, n)) {
+		goto err;
+	}
+	ret = G2_mul_gen(group, p, k, ctx);
+
+err:
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	return ret;
+}
+
+int G2_cmp(const PAIRING_GROUP *group, const G2_POINT *a, const G2_POINT *b) {
+	FP2 za, zb, s, t;
+
+	if (G2_is_infty(a) || G2_is_infty(b)) {
+		return G2_is_infty(a) != G2_is_infty(b);
+	}
+
+	/* Compare X_a Z_b^2 with X_b Z_a^2 and Y_a Z_b^3 with Y_b Z_a^3. */
+	FP2_sqr(group, &za, &a->z);
+	FP2_sqr(group, &zb, &b->z);
+	FP2_mul(group, &s, &a->x, &zb);
+	FP2_mul(group, &t, &b->x, &za);
+	if (FP2_cmp(&s, &t) != 0) {
+		return 1;
+	}
+	FP2_mul(group, &za, &za, &a->z);
+	FP2_mul(group, &zb, &zb, &b->z);
+	FP2_mul(group, &s, &a->y, &zb);
+	FP2_mul(group, &t, &b->y, &za);
+	return FP2_cmp(&s, &t) != 0;
+}
+
+int G2_is_on_curve(const PAIRING_GROUP *group, const G2_POINT *p) {
+	FP2 s, t, z;
+
+	if (G2_is_infty(p)) {
+		return 1;
+	}
+
+	/* Check Y^2 = X^3 + b' Z^6. */
+	FP2_sqr(group, &z, &p->z);
+	FP2_sqr(group, &s, &z);
+	FP2_mul(group, &z, &z, &s);
+	g2_twist_b(group, &t);
+	FP2_mul(group, &z, &z, &t);
+	FP2_sqr(group, &t, &p->x);
+	FP2_mul(group, &t, &t, &p->x);
+	FP2_add(group, &t, &t, &z);
+	FP2_sqr(group, &s, &p->y);
+	return FP2_cmp(&s, &t) == 0;
+}
+
+/* Sets r = |x| * a; x has three bits set, so double-and-add is short. */
+static void g2_mul_x(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a) {
+	G2_POINT t;
+	int i;
+
+	G2_copy(&t, a);
+	for (i = 61; i >= 0; i--) {
+		G2_dbl(group, &t, &t);
+		if ((X_ABS >> i) & 1) {
+			G2_add(group, &t, &t, a);
+		}
+	}
+	G2_copy(r, &t);
+}
+
+int G2_is_in_group(const PAIRING_GROUP *group, const G2_POINT *p) {
+	G2_POINT t, u;
+
+	if (!G2_is_on_curve(group, p)) {
+		return 0;
+	}
+	/* On BN curves Q is in G2 exactly when psi(Q) = [p]Q = [6x^2]Q, as p = r + 6x^2. */
+	g2_mul_x(group, &t, p);
+	g2_mul_x(group, &t, &t);
+	G2_dbl(group, &u, &t);
+	G2_add(group, &t, &t, &u);
+	G2_dbl(group, &t, &t);
+	G2_frb(group, &u, p);
+	return G2_cmp(group, &t, &u) == 0;
+}
+
+int G2_neg(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a) {
+	FP2_copy(&r->x, &a->x);
+	FP2_neg(group, &r->y, &a->y);
+	FP2_copy(&r->z, &a->z);
+	return 1;
+}
+
+int G2_dbl(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a) {
+	FP2 t0, t1, t2, t3, t4;
+
+	if (G2_is_infty(a)) {
+		G2_set_infty(r);
+		return 1;
+	}
+
+	/* dbl-2009-l: 2M + 5S. Z3 = 2 * Y1 * Z1 goes first, as r may alias a. */
+	FP2_mul(group, &t4, &a->y, &a->z);
+	/* A = X1^2, B = Y1^2, C = B^2. */
+	FP2_sqr(group, &t0, &a->x);
+	FP2_sqr(group, &t1, &a->y);
+	FP2_sqr(group, &t2, &t1);
+	/* D = 2 * ((X1 + B)^2 - A - C). */
+	FP2_add(group, &t1, &t1, &a->x);
+	FP2_sqr(group, &t1, &t1);
+	FP2_sub(group, &t1, &t1, &t0);
+	FP2_sub(group, &t1, &t1, &t2);
+	FP2_add(group, &t1, &t1, &t1);
+	/* E = 3 * A, F = E^2. */
+	FP2_add(group, &t3, &t0, &t0);
+	FP2_add(group, &t0, &t3, &t0);
+	FP2_sqr(group, &t3, &t0);
+	/* X3 = F - 2 * D. */
+	FP2_sub(group, &t3, &t3, &t1);
+	FP2_sub(group, &r->x, &t3, &t1);
+	/* Y3 = E * (D - X3) - 8 * C. */
+	FP2_sub(group, &t1, &t1, &r->x);
+	FP2_mul(group, &t1, &t1, &t0);
+	FP2_add(group, &t2, &t2, &t2);
+	FP2_add(group, &t2, &t2, &t2);
+	FP2_add(group, &t2, &t2, &t2);
+	FP2_sub(group, &r->y, &t1, &t2);
+	FP2_add(group, &r->z, &t4, &t4);
+	return 1;
+}
+
+/* Adds a to b, where b has Z = 1 (madd-2007-bl: 7M + 4S). */
+static int g2_add_mix(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const G2_POINT *b) {
+	FP2 t0, t1, t2, t3, t4, t5;
+
+	/* Z1Z1 = Z1^2, U2 = X2 * Z1Z1, S2 = Y2 * Z1 * Z1Z1. */
+	FP2_sqr(group, &t0, &a->z);
+	FP2_mul(group, &t1, &b->x, &t0);
+	FP2_mul(group, &t2, &b->y, &a->z);
+	FP2_mul(group, &t2, &t2, &t0);
+	/* H = U2 - X1, rr = 2 * (S2 - Y1). */
+	FP2_sub(group, &t1, &t1, &a->x);
+	FP2_sub(group, &t2, &t2, &a->y);
+	if (FP2_is_zero(&t1)) {
+		if (FP2_is_zero(&t2)) {
+			return G2_dbl(group, r, b);
+		}
+		G2_set_infty(r);
+		return 1;
+	}
+	FP2_add(group, &t2, &t2, &t2);
+	/* Z3 = (Z1 + H)^2 - Z1Z1 - HH. */
+	FP2_sqr(group, &t3, &t1);
+	FP2_add(group, &t4, &a->z, &t1);
+	FP2_sqr(group, &t4, &t4);
+	FP2_sub(group, &t4, &t4, &t0);
+	FP2_sub(group, &r->z, &t4, &t3);
+	/* I = 4 * HH, J = H * I, V = X1 * I. */
+	FP2_add(group, &t3, &t3, &t3);
+	FP2_add(group, &t3, &t3, &t3);
+	FP2_mul(group, &t1, &t1, &t3);
+	FP2_mul(group, &t3, &a->x, &t3);
+	/* t5 = 2 * Y1 * J, before Y1 may be overwritten. */
+	FP2_mul(group, &t5, &a->y, &t1);
+	FP2_add(group, &t5, &t5, &t5);
+	/* X3 = rr^2 - J - 2 * V. */
+	FP2_sqr(group, &t4, &t2);
+	FP2_sub(group, &t4, &t4, &t1);
+	FP2_sub(group, &t4, &t4, &t3);
+	FP2_sub(group, &r->x, &t4, &t3);
+	/* Y3 = rr * (V - X3) - 2 * Y1 * J. */
+	FP2_sub(group, &t3, &t3, &r->x);
+	FP2_mul(group, &t3, &t3, &t2);
+	FP2_sub(group, &r->y, &t3, &t5);
+	return 1;
+}
+
+int G2_add(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const G2_POINT *b) {
+	FP2 z1, z2, u1, u2, s1, s2, t;
+
+	if (G2_is_infty(a)) {
+		G2_copy(r, b);
+		return 1;
+	}
+	if (G2_is_infty(b)) {
+		G2_copy(r, a);
+		return 1;
+	}
+	if (g2_is_one(group, &b->z)) {
+		return g2_add_mix(group, r, a, b);
+	}
+	if (g2_is_one(group, &a->z)) {
+		return g2_add_mix(group, r, b, a);
+	}
+
+	/* add-2007-bl: 11M + 5S. */
+	FP2_sqr(group, &z1, &a->z);
+	FP2_sqr(group, &z2, &b->z);
+	FP2_mul(group, &u1, &a->x, &z2);
+	FP2_mul(group, &u2, &b->x, &z1);
+	FP2_mul(group, &s1, &a->y, &b->z);
+	FP2_mul(group, &s1, &s1, &z2);
+	FP2_mul(group, &s2, &b->y, &a->z);
+	FP2_mul(group, &s2, &s2, &z1);
+	/* H = U2 - U1, rr = 2 * (S2 - S1). */
+	FP2_sub(group, &u2, &u2, &u1);
+	FP2_sub(group, &s2, &s2, &s1);
+	if (FP2_is_zero(&u2)) {
+		if (FP2_is_zero(&s2)) {
+			return G2_dbl(group, r, a);
+		}
+		G2_set_infty(r);
+		return 1;
+	}
+	FP2_add(group, &s2, &s2, &s2);
+	/* Z3 = ((Z1 + Z2)^2 - Z1Z1 - Z2Z2) * H. */
+	FP2_add(group, &t, &a->z, &b->z);
+	FP2_sqr(group, &t, &t);
+	FP2_sub(group, &t, &t, &z1);
+	FP2_sub(group, &t, &t, &z2);
+	FP2_mul(group, &r->z, &t, &u2);
+	/* I = (2 * H)^2, J = H * I, V = U1 * I. */
+	FP2_add(group, &t, &u2, &u2);
+	FP2_sqr(group, &t, &t);
+	FP2_mul(group, &u2, &u2, &t);
+	FP2_mul(group, &u1, &u1, &t);
+	/* X3 = rr^2 - J - 2 * V. */
+	FP2_sqr(group, &t, &s2);
+	FP2_sub(group, &t, &t, &u2);
+	FP2_sub(group, &t, &t, &u1);
+	FP2_sub(group, &r->x, &t, &u1);
+	/* Y3 = rr * (V - X3) - 2 * S1 * J. */
+	FP2_sub(group, &u1, &u1, &r->x);
+	FP2_mul(group, &u1, &u1, &s2);
+	FP2_mul(group, &s1, &s1, &u2);
+	FP2_add(group, &s1, &s1, &s1);
+	FP2_sub(group, &r->y, &u1, &s1);
+	return 1;
+}
+
+int G2_sub(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const G2_POINT *b) {
+	G2_POINT t;
+
+	G2_neg(group, &t, b);
+	return G2_add(group, r, a, &t);
+}
+
+int G2_norm(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a) {
+	return G2_norm_sim(group, r, a, 1);
+}
+
+int G2_norm_sim(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, int n) {
+	FP2 sz[INV_STACK], *z = NULL, t;
+	int i, ret = 0;
+
+	if (n <= 0) {
+		return 1;
+	}
+	if (n <= INV_STACK) {
+		z = sz;
+	} else if ((z = OPENSSL_malloc(n * sizeof(FP2))) == NULL) {
+		return 0;
+	}
+
+	/* Points at infinity have Z = 0, which the batch inversion leaves alone. */
+	for (i = 0; i < n; i++) {
+		FP2_copy(&z[i], &a[i].z);
+	}
+	if (!FP2_inv_batch(group, z, z, n)) {
+		goto err;
+	}
+	for (i = 0; i < n; i++) {
+		if (G2_is_infty(&a[i])) {
+			G2_set_infty(&r[i]);
+			continue;
+		}
+		/* x = X / Z^2, y = Y / Z^3. */
+		FP2_sqr(group, &t, &z[i]);
+		FP2_mul(group, &r[i].x, &a[i].x, &t);
+		FP2_mul(group, &t, &t, &z[i]);
+		FP2_mul(group, &r[i].y, &a[i].y, &t);
+		FP2_zero(&r[i].z);
+		FP_copy(&r[i].z.f[0], &group->one);
+	}
+
+	ret = 1;
+err:
+	if (z != sz) {
+		OPENSSL_free(z);
+	}
+	return ret;
+}
+
+int G2_mul(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const BIGNUM *k) {
+	G2_POINT t, u;
+	int i;
+
+	/* Left-to-right double-and-add, adding a normalized copy of a. */
+	if (!G2_norm(group, &u, a)) {
+		return 0;
+	}
+	if (BN_is_negative(k)) {
+		G2_neg(group, &u, &u);
+	}
+	G2_set_infty(&t);
+	for (i = BN_num_bits(k) - 1; i >= 0; i--) {
+		G2_dbl(group, &t, &t);
+		if (BN_is_bit_set(k, i)) {
+			G2_add(group, &t, &t, &u);
+		}
+	}
+	G2_copy(r, &t);
+	return 1;
+}
+
+int G2_frb(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a) {
+	/* psi(X, Y, Z) = (X^p * xi^((p - 1)/3), Y^p * xi^((p - 1)/2), Z^p). */
+	FP2_inv_uni(group, &r->x, &a->x);
+	FP2_mul(group, &r->x, &r->x, &group->frb[0][1]);
+	FP2_inv_uni(group, &r->y, &a->y);
+	FP2_mul(group, &r->y, &r->y, &group->frb[0][2]);
+	FP2_inv_uni(group, &r->z, &a->z);
+	return 1;
+}
+
+int G2_mul_gls(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *a, const BIGNUM *k, BN_CTX *ctx) {
+	G2_POINT t[4 * G2_TAB], u;
+	signed char naf[4][GLV_DIGS];
+	BIGNUM *e[4];
+	BN_CTX *new_ctx = NULL;
+	int i, j, d, l = 0, len[4], ret = 0;
+
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	for (i = 0; i < 4; i++) {
+		e[i] = BN_CTX_get(ctx);
+	}
+	if (e[3] == NULL || !op_decomp(group, e, k, op_gls_basis, op_gls_dual, 4, 0, ctx)) {
+		goto err;
+	}
+	for (i = 0; i < 4; i++) {
+		if ((len[i] = op_naf(naf[i], e[i], G2_WIN)) < 0) {
+			goto err;
+		}
+		l = (len[i] > l ? len[i] : l);
+	}
+
+	/* Row i of t holds the odd multiples of psi^i(a), signed as e[i]. */
+	G2_copy(&t[0], a);
+	G2_dbl(group, &u, a);
+	for (j = 1; j < G2_TAB; j++) {
+		G2_add(group, &t[j], &t[j - 1], &u);
+	}
+	for (i = 1; i < 4; i++) {
+		for (j = 0; j < G2_TAB; j++) {
+			G2_frb(group, &t[i * G2_TAB + j], &t[(i - 1) * G2_TAB + j]);
+		}
+	}
+	for (i = 0; i < 4; i++) {
+		if (BN_is_negative(e[i])) {
+			for (j = 0; j < G2_TAB; j++) {
+				G2_neg(group, &t[i * G2_TAB + j], &t[i * G2_TAB + j]);
+			}
+		}
+	}
+	/* Normalize the table so that the main loop only does mixed additions. */
+	if (!G2_norm_sim(group, t, t, 4 * G2_TAB)) {
+		goto err;
+	}
+
+	G2_set_infty(&u);
+	for (j = l - 1; j >= 0; j--) {
+		G2_dbl(group, &u, &u);
+		for (i = 0; i < 4; i++) {
+			d = (j < len[i] ? naf[i][j] : 0);
+			if (d > 0) {
+				G2_add(group, &u, &u, &t[i * G2_TAB + d / 2]);
+			} else if (d < 0) {
+				G2_sub(group, &u, &u, &t[i * G2_TAB - d / 2]);
+			}
+		}
+	}
+	G2_copy(r, &u);
+
+	ret = 1;
+err:
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	return ret;
+}
+
+/* The windows of a G2_msm handled by one thread, as in G1_msm. */
+typedef struct {
+	const PAIRING_GROUP *group;
+	const G2_POINT *p;
+	const uint64_t *s;
+	size_t n;
+	int c;
+	int w0;
+	int step;
+	G2_POINT *sum;
+	int ret;
+} g2_msm_job;
+
+/* Buckets of one thread and its pending affine additions, as in G1_msm. */
+typedef struct {
+	const g2_msm_job *job;
+	G2_POINT *bk;
+	G2_POINT *add;
+	FP2 *den;
+	FP2 *pre;
+} g2_msm_buf;
+
+/* Signed point for digit d of point i, or zero if it contributes nothing. */
+static int g2_msm_pick(const g2_msm_job *job, size_t i, int w, G2_POINT *q) {
+	int d = op_msm_dig(job->s + i * FP_DIGS, w, job->c);
+
+	if (d == 0 || G2_is_infty(&job->p[i])) {
+		return 0;
+	}
+	if (d < 0) {
+		G2_neg(job->group, q, &job->p[i]);
+		return -d;
+	}
+	G2_copy(q, &job->p[i]);
+	return d;
+}
+
+/* Queues bucket b += +-p[i] in slot k, unless the bucket or the point is empty. */
+static int g2_msm_put(void *arg, int b, size_t i, int neg, int k) {
+	g2_msm_buf *buf = (g2_msm_buf *)arg;
+	const PAIRING_GROUP *group = buf->job->group;
+	G2_POINT *t = &buf->bk[b], *q = &buf->add[k];
+	FP2 *den = &buf->den[k];
+
+	if (G2_is_infty(&buf->job->p[i])) {
+		return 0;
+	}
+	if (neg) {
+		G2_neg(group, q, &buf->job->p[i]);
+	} else {
+		G2_copy(q, &buf->job->p[i]);
+	}
+	if (G2_is_infty(t)) {
+		G2_copy(t, q);
+		return 0;
+	}
+	if (FP2_cmp(&t->x, &q->x) != 0) {
+		FP2_sub(group, den, &q->x, &t->x);
+	} else if (FP2_cmp(&t->y, &q->y) == 0) {
+		FP2_add(group, den, &q->y, &q->y);
+	} else {
+		/* q = -t, which empties the bucket. */
+		FP2_zero(den);
+	}
+	return 1;
+}
+
+/* Finishes the queued additions with a single inversion. */
+static int g2_msm_flush(void *arg, const int *idx, int k) {
+	g2_msm_buf *buf = (g2_msm_buf *)arg;
+	const PAIRING_GROUP *group = buf->job->group;
+	G2_POINT *t, *q;
+	FP2 l, u;
+	int j;
+
+	if (!FP2_inv_batch_buf(group, buf->den, buf->den, k, buf->pre)) {
+		return 0;
+	}
+	for (j = 0; j < k; j++) {
+		t = &buf->bk[idx[j]];
+		q = &buf->add[j];
+		if (FP2_is_zero(&buf->den[j])) {
+			G2_set_infty(t);
+			continue;
+		}
+		if (FP2_cmp(&t->x, &q->x) == 0) {
+			FP2_sqr(group, &u, &t->x);
+			FP2_add(group, &l, &u, &u);
+			FP2_add(group, &l, &l, &u);
+		} else {
+			FP2_sub(group, &l, &q->y, &t->y);
+		}
+		FP2_mul(group, &l, &l, &buf->den[j]);
+		FP2_sqr(group, &u, &l);
+		FP2_sub(group, &u, &u, &t->x);
+		FP2_sub(group, &u, &u, &q->x);
+		FP2_sub(group, &t->x, &t->x, &u);
+		FP2_mul(group, &l, &l, &t->x);
+		FP2_sub(group, &t->y, &l, &t->y);
+		FP2_copy(&t->x, &u);
+	}
+	return 1;
+}
+
+/* Fills the buckets of window w, following g1_msm_fill. */
+static int g2_msm_fill(const g2_msm_job *job, g2_msm_buf *buf, OP_MSM *m, int w, int nb) {
+	size_t i;
+	int b, lim = (nb / 2 < G2_BATCH ? nb / 2 : G2_BATCH);
+	G2_POINT q;
+
+	for (b = 0; b < nb; b++) {
+		G2_set_infty(&buf->bk[b]);
+	}
+	if (nb >= G2_AFF) {
+		return op_msm_fill(m, job->s, job->n, w, job->c, lim);
+	}
+	for (i = 0; i < job->n; i++) {
+		if ((b = g2_msm_pick(job, i, w, &q)) != 0) {
+			G2_add(job->group, &buf->bk[b - 1], &buf->bk[b - 1], &q);
+		}
+	}
+	return G2_norm_sim(job->group, buf->bk, buf->bk, nb);
+}
+
+static void *g2_msm_work(void *arg) {
+	g2_msm_job *job = (g2_msm_job *)arg;
+	const PAIRING_GROUP *group = job->group;
+	g2_msm_buf buf;
+	OP_MSM m;
+	G2_POINT s, t;
+	int b, w, nb = 1 << (job->c - 1), nw = (ORD_BITS + job->c) / job->c;
+
+	job->ret = 0;
+	buf.job = job;
+	buf.bk = OPENSSL_malloc(nb * sizeof(G2_POINT));
+	buf.add = OPENSSL_malloc(G2_BATCH * sizeof(G2_POINT));
+	buf.den = OPENSSL_malloc(G2_BATCH * sizeof(FP2));
+	buf.pre = OPENSSL_malloc(G2_BATCH * sizeof(FP2));
+	m.put = g2_msm_put;
+	m.flush = g2_msm_flush;
+	m.arg = &buf;
+	if (!op_msm_init(&m, nb, G2_BATCH)) {
+		goto err;
+	}
+	if (buf.bk == NULL || buf.add == NULL || buf.den == NULL || buf.pre == NULL) {
+		goto err;
+	}
+
+	for (w = job->w0; w < nw; w += job->step) {
+		if (!g2_msm_fill(job, &buf, &m, w, nb)) {
+			goto err;
+		}
+		/* Running sums: bucket b ends up counted b + 1 times. */
+		G2_set_infty(&s);
+		G2_set_infty(&t);
+		for (b = nb - 1; b >= 0; b--) {
+			G2_add(group, &s, &s, &buf.bk[b]);
+			G2_add(group, &t, &t, &s);
+		}
+		G2_copy(&job->sum[w], &t);
+	}
+	job->ret = 1;
+
+err:
+	op_msm_free(&m);
+	OPENSSL_free(buf.bk);
+	OPENSSL_free(buf.add);
+	OPENSSL_free(buf.den);
+	OPENSSL_free(buf.pre);
+	return NULL;
+}
+
+int G2_msm(const PAIRING_GROUP *group, G2_POINT *r, const G2_POINT *p, const BIGNUM **k,
+		size_t n, int threads, BN_CTX *ctx) {
+	G2_POINT *q = NULL, *sum = NULL, u;
+	g2_msm_job *job = NULL;
+	uint64_t *s = NULL;
+	BIGNUM *ord;
+	BN_CTX *new_ctx = NULL;
+	size_t i;
+	int c, j, w, nw, ret = 0;
+
+	if (n == 0) {
+		G2_set_infty(r);
+		return 1;
+	}
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	c = op_msm_win(n);
+	nw = (ORD_BITS + c) / c;
+	if (threads <= 0) {
+		threads = op_cpus();
+	}
+	if (threads > nw) {
+		threads = nw;
+	}
+
+	ord = BN_CTX_get(ctx);
+	q = OPENSSL_malloc(n * sizeof(G2_POINT));
+	s = OPENSSL_malloc(n * FP_DIGS * sizeof(uint64_t));
+	sum = OPENSSL_malloc(nw * sizeof(G2_POINT));
+	job = OPENSSL_malloc(threads * sizeof(g2_msm_job));
+	if (ord == NULL || q == NULL || s == NULL || sum == NULL || job == NULL) {
+		goto err;
+	}
+	/* The twist subgroup has the same prime order as G1. */
+	if (!EC_GROUP_get_order(group->ec, ord, ctx) || !G2_norm_sim(group, q, p, (int)n)) {
+		goto err;
+	}
+	for (i = 0; i < n; i++) {
+		if (!op_msm_read(s + i * FP_DIGS, k[i], ord, ctx)) {
+			goto err;
+		}
+	}
+
+	for (j = 0; j < threads; j++) {
+		job[j].group = group;
+		job[j].p = q;
+		job[j].s = s;
+		job[j].n = n;
+		job[j].c = c;
+		job[j].w0 = j;
+		job[j].step = threads;
+		job[j].sum = sum;
+	}
+	op_parallel(g2_msm_work, job, sizeof(g2_msm_job), threads);
+	for (j = 0; j < threads; j++) {
+		if (!job[j].ret) {
+			goto err;
+		}
+	}
+
+	G2_copy(&u, &sum[nw - 1]);
+	for (w = nw - 2; w >= 0; w--) {
+		for (j = 0; j < c; j++) {
+			G2_dbl(group, &u, &u);
+		}
+		G2_add(group, &u, &u, &sum[w]);
+	}
+	G2_copy(r, &u);
+
+	ret = 1;
+err:
+	OPENSSL_free(q);
+	OPENSSL_free(s);
+	OPENSSL_free(sum);
+	OPENSSL_free(job);
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	return ret;
+}
+
+int G2_gen_table(PAIRING_GROUP *group) {
+	G2_POINT *t = NULL, b, d;
+	FP2 (*tab)[2] = NULL;
+	int i, j, ret = 0;
+
+	t = OPENSSL_malloc(G2_GEN_DIGS * GEN_TAB * sizeof(G2_POINT));
+	tab = OPENSSL_malloc(G2_GEN_DIGS * GEN_TAB * sizeof(*tab));
+	if (t == NULL || tab == NULL) {
+		goto err;
+	}
+	G2_get_gen(group, &b);
+
+	/* As in G1_gen_table, over the twist. */
+	for (j = 0; j < G2_GEN_DIGS; j++) {
+		G2_copy(&t[j * GEN_TAB], &b);
+		G2_dbl(group, &d, &b);
+		for (i = 1; i < GEN_TAB; i++) {
+			G2_add(group, &t[j * GEN_TAB + i], &t[j * GEN_TAB + i - 1], &d);
+		}
+		for (i = 0; i < GEN_WIN; i++) {
+			G2_dbl(group, &b, &b);
+		}
+	}
+	if (!G2_norm_sim(group, t, t, G2_GEN_DIGS * GEN_TAB)) {
+		goto err;
+	}
+	for (i = 0; i < G2_GEN_DIGS * GEN_TAB; i++) {
+		FP2_copy(&tab[i][0], &t[i].x);
+		FP2_copy(&tab[i][1], &t[i].y);
+	}
+	OPENSSL_free(group->g2_tab);
+	group->g2_tab = tab;
+	tab = NULL;
+	ret = 1;
+
+err:
+	OPENSSL_free(t);
+	OPENSSL_free(tab);
+	return ret;
+}
+
+/* Sets q to d * 2^(GEN_WIN * j) * g2 for odd d, touching every entry of window j. */
+static void g2_gen_get(const PAIRING_GROUP *group, G2_POINT *q, int j, int d) {
+	FP2 (*tab)[2] = group->g2_tab + j * GEN_TAB;
+	int i, k, l, s = (d >> 31) & 1, e = (((d ^ -s) + s) - 1) >> 1;
+	uint64_t m, x[2][FP_DIGS] = { { 0 } }, y[2][FP_DIGS] = { { 0 } };
+	FP2 t;
+
+	/* Masks over local words, which the compiler can keep apart from the table. */
+	for (i = 0; i < GEN_TAB; i++) {
+		m = (uint64_t)0 - (uint64_t)(i == e);
+		for (k = 0; k < 2; k++) {
+			for (l = 0; l < FP_DIGS; l++) {
+				x[k][l] |= m & tab[i][0].f[k].f[l];
+				y[k][l] |= m & tab[i][1].f[k].f[l];
+			}
+		}
+	}
+	for (k = 0; k < 2; k++) {
+		for (l = 0; l < FP_DIGS; l++) {
+			q->x.f[k].f[l] = x[k][l];
+			q->y.f[k].f[l] = y[k][l];
+		}
+	}
+	FP2_neg(group, &t, &q->y);
+	FP_copy_sec(&q->y.f[0], &t.f[0], s);
+	FP_copy_sec(&q->y.f[1], &t.f[1], s);
+	FP2_zero(&q->z);
+	FP_copy(&q->z.f[0], &group->one);
+}
+
+int G2_mul_gen(const PAIRING_GROUP *group, G2_POINT *r, const BIGNUM *k, BN_CTX *ctx) {
+	signed char dig[4 * G2_GEN_DIGS];
+	G2_POINT u, v;
+	BN_CTX *new_ctx = NULL;
+	int i, j, ret = 0;
+
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	if (!op_gen_rec(group, dig, k, op_gls_basis, op_gls_dual, 4, G2_GEN_DIGS, ctx)) {
+		goto err;
+	}
+
+	/*
+	 * Horner's rule in psi, as in G1_mul_gen: psi acts as lambda on G2 and on
+	 * Jacobian coordinates alike, so every addition takes the mixed formula.
+	 */
+	G2_set_infty(&u);
+	for (i = 3; i >= 0; i--) {
+		G2_frb(group, &u, &u);
+		for (j = 0; j < G2_GEN_DIGS; j++) {
+			g2_gen_get(group, &v, j, dig[i * G2_GEN_DIGS + j]);
+			G2_add(group, &u, &u, &v);
+		}
+	}
+	G2_copy(r, &u);
+
+	ret = 1;
+err:
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	return ret;
+}
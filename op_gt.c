@@ -0,0 +1,127 @@
+/*
+ * OpenPairing is an implementation of a bilinear pairing over OpenSSL
+ * Copyright (C) 2015 OpenPairing Authors
+ *
+ * This file is part of OpenPairing. OpenPairing is legal property of its
+ * developers, whose names are not listed here. Please refer to the COPYRIGHT
+ * file for contact information.
+ *
+ * OpenPairing is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OpenPairing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with OpenPairing. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "op.h"
+
+/* Window width of the w-NAF digits used by GT_exp. */
+#define GT_WIN		5
+
+/* Odd powers of each base kept by GT_exp. */
+#define GT_TAB		(1 << (GT_WIN - 2))
+
+/*
+ * Elements of GT, the order-r subgroup of the cyclotomic subgroup of Fp12,
+ * as produced by op_map.
+ */
+
+int GT_get_gen(const PAIRING_GROUP *group, FP12 *r) {
+	FP12_copy(r, &group->gt);
+	return 1;
+}
+
+int GT_exp_gen(const PAIRING_GROUP *group, FP12 *r, const BIGNUM *k, BN_CTX *ctx) {
+	return GT_exp(group, r, &group->gt, k, ctx);
+}
+
+int GT_exp(const PAIRING_GROUP *group, FP12 *r, const FP12 *a, const BIGNUM *k, BN_CTX *ctx) {
+	FP12 t[4 * GT_TAB], u, v;
+	signed char naf[4][GLV_DIGS];
+	BIGNUM *e[4];
+	BN_CTX *new_ctx = NULL;
+	int i, j, d, l = 0, len[4], ret = 0;
+
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	for (i = 0; i < 4; i++) {
+		e[i] = BN_CTX_get(ctx);
+	}
+	/* On GT the Frobenius is a^p = a^lambda, so k splits as in G2_mul_gls. */
+	if (e[3] == NULL || !op_decomp(group, e, k, op_gls_basis, op_gls_dual, 4, 0, ctx)) {
+		goto err;
+	}
+	for (i = 0; i < 4; i++) {
+		if ((len[i] = op_naf(naf[i], e[i], GT_WIN)) < 0) {
+			goto err;
+		}
+		l = (len[i] > l ? len[i] : l);
+	}
+
+	/* Row i of t holds the odd powers of a^(p^i), conjugated if e[i] < 0. */
+	FP12_copy(&t[0], a);
+	if (!FP12_sqr_cyc(group, &u, a)) {
+		goto err;
+	}
+	for (j = 1; j < GT_TAB; j++) {
+		if (!FP12_mul_lzr(group, &t[j], &t[j - 1], &u)) {
+			goto err;
+		}
+	}
+	for (i = 1; i < 4; i++) {
+		for (j = 0; j < GT_TAB; j++) {
+			if (!FP12_frb(group, &t[i * GT_TAB + j], &t[(i - 1) * GT_TAB + j])) {
+				goto err;
+			}
+		}
+	}
+	for (i = 0; i < 4; i++) {
+		if (BN_is_negative(e[i])) {
+			for (j = 0; j < GT_TAB; j++) {
+				if (!FP12_inv_uni(group, &t[i * GT_TAB + j], &t[i * GT_TAB + j])) {
+					goto err;
+				}
+			}
+		}
+	}
+
+	FP12_zero(&u);
+	FP_copy(&u.f[0].f[0].f[0], &group->one);
+	for (j = l - 1; j >= 0; j--) {
+		if (!FP12_sqr_cyc(group, &u, &u)) {
+			goto err;
+		}
+		for (i = 0; i < 4; i++) {
+			d = (j < len[i] ? naf[i][j] : 0);
+			if (d > 0) {
+				if (!FP12_mul_lzr(group, &u, &u, &t[i * GT_TAB + d / 2])) {
+					goto err;
+				}
+			} else if (d < 0) {
+				/* Inversion is conjugation in the cyclotomic subgroup. */
+				if (!FP12_inv_uni(group, &v, &t[i * GT_TAB - d / 2])) {
+					goto err;
+				}
+				if (!FP12_mul_lzr(group, &u, &u, &v)) {
+					goto err;
+				}
+			}
+		}
+	}
+	FP12_copy(r, &u);
+
+	ret = 1;
+err:
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	return ret;
+}
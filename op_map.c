@@ -22,29 +22,10 @@
 
 #include "op.h"
 
-static void print(BIGNUM *r) {
-	BIGNUM *t = BN_CTX_get(group.bn);
-	group.ec->meth->field_decode(group.ec, t, r, group.bn);
-	BN_print_fp(stdout, t);
-	printf("\n");
-}
-
-static void print12(FP12 *r) {
-	print(&r->f[0].f[0].f[0]);
-	print(&r->f[0].f[0].f[1]);
-	print(&r->f[0].f[1].f[0]);
-	print(&r->f[0].f[1].f[1]);
-	print(&r->f[0].f[2].f[0]);
-	print(&r->f[0].f[2].f[1]);
-	print(&r->f[1].f[0].f[0]);
-	print(&r->f[1].f[0].f[1]);	
-	print(&r->f[1].f[1].f[0]);
-	print(&r->f[1].f[1].f[1]);
-	print(&r->f[1].f[2].f[0]);
-	print(&r->f[1].f[2].f[1]);	
-}
+/* Number of pairs whose Miller-loop state op_map_sim keeps on the stack. */
+#define SIM_STACK	8
 
-static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1, BIGNUM *xp, BIGNUM *yp) {
+static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1, const FP *xp, const FP *yp) {
 	FP2 t0, t1, t2, t3, t4, t5, t6, u0, u1;
 	int ret = 0;
 
@@ -59,11 +40,11 @@ static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1,
 	FP2_init(&u1);
 
 	/* C = z1^2. */
-	if (!FP2_sqr(&group, &t0, z1, group.bn)) {
+	if (!FP2_sqr(&group, &t0, z1)) {
 		goto err;
 	}
 	/* B = y1^2. */
-	if (!FP2_sqr(&group, &t1, y1, group.bn)) {
+	if (!FP2_sqr(&group, &t1, y1)) {
 		goto err;
 	}
 	/* t5 = B + C. */
@@ -78,36 +59,18 @@ static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1,
 		goto err;
 	}
 
-	if (!BN_mod_add(&t2.f[0], &t0.f[0], &t0.f[1], group.field, group.bn)) {
-		goto err;
-	}
-	if (!BN_mod_sub(&t2.f[1], &t0.f[1], &t0.f[0], group.field, group.bn)) {
-		goto err;
-	}
+	FP_add(&t2.f[0], &t0.f[0], &t0.f[1]);
+	FP_sub(&t2.f[1], &t0.f[1], &t0.f[0]);
 
 	/* t0 = x1^2. */
-	if (!FP2_sqr(&group, &t0, x1, group.bn)) {
+	if (!FP2_sqr(&group, &t0, x1)) {
 		goto err;
 	}
 	/* t4 = A = (x1 * y1)/2. */
-	if (!FP2_mul(&group, &t4, x1, y1, group.bn)) {
+	if (!FP2_mul(&group, &t4, x1, y1)) {
 		goto err;
 	}
-
-	if (BN_is_bit_set(&t4.f[0], 0)) {
-		if (!BN_add(&t4.f[0], &t4.f[0], group.field)) {
-			goto err;
-		}
-	}
-	if (!BN_rshift1(&t4.f[0], &t4.f[0])) {
-		goto err;
-	}
-	if (BN_is_bit_set(&t4.f[1], 0)) {
-		if (!BN_add(&t4.f[1], &t4.f[1], group.field)) {
-			goto err;
-		}
-	}
-	if (!BN_rshift1(&t4.f[1], &t4.f[1])) {
+	if (!FP2_hlv(&group, &t4, &t4)) {
 		goto err;
 	}
 
@@ -122,7 +85,7 @@ static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1,
 	if (!FP2_sub(&group, x3, &t1, &t3)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, x3, x3, &t4, group.bn)) {
+	if (!FP2_mul(&group, x3, x3, &t4)) {
 		goto err;
 	}
 
@@ -130,25 +93,12 @@ static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1,
 	if (!FP2_add(&group, &t3, &t1, &t3)) {
 		goto err;
 	}
-	if (BN_is_bit_set(&t3.f[0], 0)) {
-		if (!BN_add(&t3.f[0], &t3.f[0], group.field)) {
-			goto err;
-		}
-	}
-	if (!BN_rshift1(&t3.f[0], &t3.f[0])) {
-		goto err;
-	}
-	if (BN_is_bit_set(&t3.f[1], 0)) {
-		if (!BN_add(&t3.f[1], &t3.f[1], group.field)) {
-			goto err;
-		}
-	}
-	if (!BN_rshift1(&t3.f[1], &t3.f[1])) {
+	if (!FP2_hlv(&group, &t3, &t3)) {
 		goto err;
 	}
 
 	/* y3 = G^2 - 3E^2. */
-	if (!FP2_sqr(&group, &u0, &t2, group.bn)) {
+	if (!FP2_sqr(&group, &u0, &t2)) {
 		goto err;
 	}
 	if (!FP2_add(&group, &u1, &u0, &u0)) {
@@ -157,7 +107,7 @@ static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1,
 	if (!FP2_add(&group, &u1, &u1, &u0)) {
 		goto err;
 	}
-	if (!FP2_sqr(&group, &u0, &t3, group.bn)) {
+	if (!FP2_sqr(&group, &u0, &t3)) {
 		goto err;
 	}
 	if (!FP2_sub(&group, &u0, &u0, &u1)) {
@@ -168,7 +118,7 @@ static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1,
 	if (!FP2_add(&group, &t3, y1, z1)) {
 		goto err;
 	}
-	if (!FP2_sqr(&group, &t3, &t3, group.bn)) {
+	if (!FP2_sqr(&group, &t3, &t3)) {
 		goto err;
 	}
 	if (!FP2_sub(&group, &t3, &t3, &t5)) {
@@ -178,7 +128,7 @@ static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1,
 	FP2_copy(y3, &u0);
 
 	/* z3 = B * H. */
-	if (!FP2_mul(&group, z3, &t1, &t3, group.bn)) {
+	if (!FP2_mul(&group, z3, &t1, &t3)) {
 		goto err;
 	}
 
@@ -188,21 +138,13 @@ static int op_dbl(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, FP2 *z1,
 	}
 
 	/* l10 = (3 * xp) * t0. */
-	if (!group.ec->meth->field_mul(group.ec, &l->f[1].f[0].f[0], xp, &t0.f[0], group.bn)) {
-		goto err;
-	}
-	if (!group.ec->meth->field_mul(group.ec, &l->f[1].f[0].f[1], xp, &t0.f[1], group.bn)) {
-		goto err;
-	}
+	FP_mul(&l->f[1].f[0].f[0], xp, &t0.f[0]);
+	FP_mul(&l->f[1].f[0].f[1], xp, &t0.f[1]);
 
 
 	/* l01 = F * (-yp). */
-	if (!group.ec->meth->field_mul(group.ec, &l->f[0].f[0].f[0], &t3.f[0], yp, group.bn)) {
-		goto err;
-	}
-	if (!group.ec->meth->field_mul(group.ec, &l->f[0].f[0].f[1], &t3.f[1], yp, group.bn)) {
-		goto err;
-	}
+	FP_mul(&l->f[0].f[0].f[0], &t3.f[0], yp);
+	FP_mul(&l->f[0].f[0].f[1], &t3.f[1], yp);
 
 	ret = 1;
 
@@ -219,7 +161,7 @@ err:
 	return ret;
 }
 
-static int op_add(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, const BIGNUM *xp, BIGNUM *yp) {
+static int op_add(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, const FP2 *x1, const FP2 *y1, const FP *xp, const FP *yp) {
 	FP2 t1, t2, t3, t4, u1, u2;
 	int ret = 0;
 		
@@ -230,32 +172,32 @@ static int op_add(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, const BI
 	FP2_init(&u1);
 	FP2_init(&u2);
 
-	if (!FP2_mul(&group, &t1, z3, x1, group.bn)) {
+	if (!FP2_mul(&group, &t1, z3, x1)) {
 		goto err;
 	}
 	if (!FP2_sub(&group, &t1, x3, &t1)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, &t2, z3, y1, group.bn)) {
+	if (!FP2_mul(&group, &t2, z3, y1)) {
 		goto err;
 	}
 	if (!FP2_sub(&group, &t2, y3, &t2)) {
 		goto err;
 	}
 
-	if (!FP2_sqr(&group, &t3, &t1, group.bn)) {
+	if (!FP2_sqr(&group, &t3, &t1)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, x3, &t3, x3, group.bn)) {
+	if (!FP2_mul(&group, x3, &t3, x3)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, &t3, &t1, &t3, group.bn)) {
+	if (!FP2_mul(&group, &t3, &t1, &t3)) {
 		goto err;
 	}
-	if (!FP2_sqr(&group, &t4, &t2, group.bn)) {
+	if (!FP2_sqr(&group, &t4, &t2)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, &t4, &t4, z3, group.bn)) {
+	if (!FP2_mul(&group, &t4, &t4, z3)) {
 		goto err;
 	}
 	if (!FP2_add(&group, &t4, &t3, &t4)) {
@@ -271,49 +213,41 @@ static int op_add(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, const BI
 	if (!FP2_sub(&group, x3, x3, &t4)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, &u1, &t2, x3, group.bn)) {
+	if (!FP2_mul(&group, &u1, &t2, x3)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, &u2, &t3, y3, group.bn)) {
+	if (!FP2_mul(&group, &u2, &t3, y3)) {
 		goto err;
 	}
 	if (!FP2_sub(&group, y3, &u1, &u2)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, x3, &t1, &t4, group.bn)) {
+	if (!FP2_mul(&group, x3, &t1, &t4)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, z3, z3, &t3, group.bn)) {
+	if (!FP2_mul(&group, z3, z3, &t3)) {
 		goto err;
 	}
 
-	if (!group.ec->meth->field_mul(group.ec, &l->f[1].f[0].f[0], &t2.f[0], xp, group.bn)) {
-		goto err;
-	}
-	if (!group.ec->meth->field_mul(group.ec, &l->f[1].f[0].f[1], &t2.f[1], xp, group.bn)) {
-		goto err;
-	}
+	FP_mul(&l->f[1].f[0].f[0], &t2.f[0], xp);
+	FP_mul(&l->f[1].f[0].f[1], &t2.f[1], xp);
 
 	if (!FP2_neg(&group, &l->f[1].f[0], &l->f[1].f[0])) {
 		goto err;
 	}
 
-	if (!FP2_mul(&group, &u1, x1, &t2, group.bn)) {
+	if (!FP2_mul(&group, &u1, x1, &t2)) {
 		goto err;
 	}
-	if (!FP2_mul(&group, &u2, y1, &t1, group.bn)) {
+	if (!FP2_mul(&group, &u2, y1, &t1)) {
 		goto err;
 	}
 	if (!FP2_sub(&group, &l->f[1].f[1], &u1, &u2)) {
 		goto err;
 	}
 	
-	if (!group.ec->meth->field_mul(group.ec, &l->f[0].f[0].f[0], &t1.f[0], yp, group.bn)) {
-		goto err;
-	}
-	if (!group.ec->meth->field_mul(group.ec, &l->f[0].f[0].f[1], &t1.f[1], yp, group.bn)) {
-		goto err;
-	}
+	FP_mul(&l->f[0].f[0].f[0], &t1.f[0], yp);
+	FP_mul(&l->f[0].f[0].f[1], &t1.f[1], yp);
 
 	ret = 1;
 
@@ -327,56 +261,56 @@ err:
 	return ret;
 }
 
-static int op_fin(FP12 *r, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, BIGNUM *xp, BIGNUM *yp) {
+/* Applies the p-power Frobenius map to a point on the twist. */
+static int op_frb(FP2 *x2, FP2 *y2, const FP2 *x1, const FP2 *y1) {
+	if (!FP2_inv_uni(&group, x2, x1)) {
+		return 0;
+	}
+	if (!FP2_inv_uni(&group, y2, y1)) {
+		return 0;
+	}
+	if (!FP2_mul_frb(&group, x2, x2, 2)) {
+		return 0;
+	}
+	if (!FP2_mul_frb(&group, y2, y2, 3)) {
+		return 0;
+	}
+	return 1;
+}
+
+/* Computes the two lines through Q1 = pi(Q) and -Q2 = -pi^2(Q). */
+static int op_fin(FP12 *r, FP2 *x3, FP2 *y3, FP2 *z3, const FP2 *x1, const FP2 *y1, const FP *xp, const FP *yp) {
 	FP2 x2, y2;
-	FP12 l;
+	FP12 l0, l1;
 	int ret = 0;
 
 	FP2_init(&x2);
 	FP2_init(&y2);
-	FP12_init(&l);
+	FP12_init(&l0);
+	FP12_init(&l1);
 
-	FP12_zero(&l);
-
-	if (!FP2_inv_uni(&group, &x2, x1)) {
-		goto err;
-	}
-	if (!FP2_inv_uni(&group, &y2, y1)) {
-		goto err;
-	}
-	if (!FP2_mul_frb(&group, &x2, &x2, 2, group.bn)) {
-		goto err;
-	}
-	if (!FP2_mul_frb(&group, &y2, &y2, 3, group.bn)) {
-		goto err;
-	}
-	if (!op_add(&l, x3, y3, z3, &x2, &y2, xp, yp)) {
+	if (!op_frb(&x2, &y2, x1, y1)) {
 		goto err;
 	}
-	if (!FP12_mul_dxs(&group, r, r, &l, group.bn)) {
+	if (!op_add(&l0, x3, y3, z3, &x2, &y2, xp, yp)) {
 		goto err;
 	}
 
-	if (!FP2_inv_uni(&group, &x2, &x2)) {
-		goto err;
-	}
-	if (!FP2_inv_uni(&group, &y2, &y2)) {
-		goto err;
-	}
-	if (!FP2_mul_frb(&group, &x2, &x2, 2, group.bn)) {
-		goto err;
-	}
-	if (!FP2_mul_frb(&group, &y2, &y2, 3, group.bn)) {
+	if (!op_frb(&x2, &y2, &x2, &y2)) {
 		goto err;
 	}
 	if (!FP2_neg(&group, &y2, &y2)) {
 		goto err;
 	}
 
-	if (!op_add(&l, x3, y3, z3, &x2, &y2, xp, yp)) {
+	if (!op_add(&l1, x3, y3, z3, &x2, &y2, xp, yp)) {
+		goto err;
+	}
+	/* Multiply the two lines together before touching r. */
+	if (!FP12_mul_dxs_dxs(&group, &l0, &l0, &l1)) {
 		goto err;
 	}
-	if (!FP12_mul_dxs(&group, r, r, &l, group.bn)) {
+	if (!FP12_mul_dxd_lzr(&group, r, r, &l0)) {
 		goto err;
 	}
 
@@ -385,11 +319,30 @@ static int op_fin(FP12 *r, FP2 *x3, FP2 *y3, FP2 *z3, FP2 *x1, FP2 *y1, BIGNUM *
 err:
 	FP2_free(&x2);
 	FP2_free(&y2);
-	FP12_free(&l);
+	FP12_free(&l0);
+	FP12_free(&l1);
 	return ret;
 }
 
-static int op_exp(FP12 *r, FP12 *a) {
+/* Adds Q or -Q to the running point, following the sign of the digit d. */
+static int op_add_dig(FP12 *l, FP2 *x3, FP2 *y3, FP2 *z3, const FP2 *x1, const FP2 *y1, int d, const FP *xp, const FP *yp) {
+	FP2 t;
+
+	if (d > 0) {
+		return op_add(l, x3, y3, z3, x1, y1, xp, yp);
+	}
+	if (!FP2_neg(&group, &t, y1)) {
+		return 0;
+	}
+	return op_add(l, x3, y3, z3, x1, &t, xp, yp);
+}
+
+int op_exp_easy(FP12 *r, const FP12 *a) {
+	/* m = f^(p^6 - 1)(p^2 + 1). */
+	return FP12_cyc(&group, r, a);
+}
+
+int op_exp_hard(FP12 *r, const FP12 *a) {
 	int ret = 0;
 	FP12 t0, t1, t2, t3;
 
@@ -399,245 +352,434 @@ static int op_exp(FP12 *r, FP12 *a) {
 	FP12_init(&t3);
 
 	/*
-	/* First, compute m = f^(p^6 - 1)(p^2 + 1). */
-	if (!FP12_cyc(&group, r, a, group.bn)) {
+	 * Computes m^((p^4 - p^2 + 1) / r) as in Fuentes-Castaneda et al., with
+	 * three exponentiations by |x|. Since x < 0, those give m^(-x), and the
+	 * negative powers of x are collected in a single conjugation.
+	 */
+
+	/* t0 = m^(-2x), t1 = m^(-6x). */
+	if (!FP12_exp_cyc(&group, &t0, a)) {
 		goto err;
 	}
-	/* Now compute m^((p^4 - p^2 + 1) / r). */
-	/* t0 = m^2x. */
-	if (!FP12_exp_cyc(&group, &t0, r, group.bn)) {
+	if (!FP12_sqr_cyc(&group, &t0, &t0)) {
 		goto err;
 	}
-
-	if (!FP12_sqr(&group, &t0, &t0, group.bn)) {
+	if (!FP12_sqr_cyc(&group, &t1, &t0)) {
 		goto err;
 	}
-	/* t1 = m^6x. */
-	if (!FP12_sqr(&group, &t1, &t0, group.bn)) {
-		goto err;
-	}
-	if (!FP12_mul(&group, &t1, &t1, &t0, group.bn)) {
+	if (!FP12_mul_lzr(&group, &t1, &t1, &t0)) {
 		goto err;
 	}
 
-	/* t2 = m^6x^2. */
-	if (!FP12_exp_cyc(&group, &t2, &t1, group.bn)) {
+	/* t2 = m^(6x^2), t3 = m^(-12x^3). */
+	if (!FP12_exp_cyc(&group, &t2, &t1)) {
 		goto err;
 	}
-	/* t3 = m^12x^3. */
-	if (!FP12_sqr(&group, &t3, &t2, group.bn)) {
+	if (!FP12_sqr_cyc(&group, &t3, &t2)) {
 		goto err;
 	}
-	if (!FP12_exp_cyc(&group, &t3, &t3, group.bn)) {
+	if (!FP12_exp_cyc(&group, &t3, &t3)) {
 		goto err;
 	}
 
-	if (!FP12_inv_uni(&group, &t0, &t0, group.bn)) {
+	/* t3 = A = m^(12x^3) * m^(6x^2) * m^(6x) = conj(t3 * t1) * t2. */
+	if (!FP12_mul_lzr(&group, &t3, &t3, &t1)) {
 		goto err;
 	}
-	if (!FP12_inv_uni(&group, &t1, &t1, group.bn)) {
+	if (!FP12_inv_uni(&group, &t3, &t3)) {
 		goto err;
 	}
-	if (!FP12_inv_uni(&group, &t3, &t3, group.bn)) {
+	if (!FP12_mul_lzr(&group, &t3, &t3, &t2)) {
 		goto err;
 	}
 
-	/* t3 = a = m^12x^3 * m^6x^2 * m^6x. */
-	if (!FP12_mul(&group, &t3, &t3, &t2, group.bn)) {
-		goto err;
-	}
-	if (!FP12_mul(&group, &t3, &t3, &t1, group.bn)) {
+	/* t0 = B = A * m^(-2x). */
+	if (!FP12_mul_lzr(&group, &t0, &t0, &t3)) {
 		goto err;
 	}
 
-	/* t0 = b = 1/(m^2x) * t3. */
-	if (!FP12_inv_uni(&group, &t0, &t0, group.bn)) {
+	/* r = A * m^(6x^2) * m * B^p * A^(p^2) * (B / m)^(p^3). */
+	if (!FP12_mul_lzr(&group, &t2, &t2, &t3)) {
 		goto err;
 	}
-	if (!FP12_mul(&group, &t0, &t0, &t3, group.bn)) {
+	if (!FP12_mul_lzr(&group, &t2, &t2, a)) {
 		goto err;
 	}
-
-	/* Compute t2 * t3 * m * b^p * a^p^2 * [b * 1/m]^p^3. */
-	if (!FP12_mul(&group, &t2, &t2, &t3, group.bn)) {
+	if (!FP12_inv_uni(&group, r, a)) {
 		goto err;
 	}
-	if (!FP12_mul(&group, &t2, &t2, r, group.bn)) {
+	if (!FP12_mul_lzr(&group, r, r, &t0)) {
 		goto err;
 	}
-	if (!FP12_inv_uni(&group, r, r, group.bn)) {
-		goto err;
-	}	
-	if (!FP12_mul(&group, r, r, &t0, group.bn)) {
+	if (!FP12_frb3(&group, r, r)) {
 		goto err;
 	}
-	if (!FP12_frb(&group, r, r, group.bn)) {
+	if (!FP12_mul_lzr(&group, r, r, &t2)) {
 		goto err;
 	}
-	if (!FP12_frb(&group, r, r, group.bn)) {
+	if (!FP12_frb(&group, &t0, &t0)) {
 		goto err;
 	}
-	if (!FP12_frb(&group, r, r, group.bn)) {
+	if (!FP12_mul_lzr(&group, r, r, &t0)) {
 		goto err;
 	}
-	if (!FP12_mul(&group, r, r, &t2, group.bn)) {
+	if (!FP12_frb2(&group, &t3, &t3)) {
 		goto err;
 	}
-	if (!FP12_frb(&group, &t0, &t0, group.bn)) {
+	if (!FP12_mul_lzr(&group, r, r, &t3)) {
 		goto err;
 	}
-	if (!FP12_mul(&group, r, r, &t0, group.bn)) {
+
+	ret = 1;
+err:
+	FP12_free(&t0);
+	FP12_free(&t1);
+	FP12_free(&t2);
+	FP12_free(&t3);
+	return ret;
+}
+
+static int op_exp(FP12 *r, const FP12 *a) {
+	return op_exp_easy(r, a) && op_exp_hard(r, r);
+}
+
+int op_map_sim(FP12 *r, const EC_POINT **g, const FP2 **x, const FP2 **y, int n, BN_CTX *ctx) {
+	BN_CTX *new_ctx = NULL;
+	BIGNUM *a, *b;
+	FP sp[4 * SIM_STACK], *xp = NULL, *yp = NULL, *s = NULL, *t = NULL;
+	FP2 sq[3 * SIM_STACK], *xq = NULL, *yq = NULL, *zq = NULL;
+	FP12 l, m;
+	int i, j, ret = 0;
+
+	if (n <= 0) {
+		return 0;
+	}
+
+	FP12_init(&l);
+	FP12_init(&m);
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
+	}
+	BN_CTX_start(ctx);
+	a = BN_CTX_get(ctx);
+	b = BN_CTX_get(ctx);
+	if (b == NULL) {
 		goto err;
 	}
-	if (!FP12_frb(&group, &t3, &t3, group.bn)) {
+
+	/* Each pair keeps its own G1 coordinates and running G2 point. */
+	if (n <= SIM_STACK) {
+		xp = sp;
+		xq = sq;
+	} else {
+		xp = OPENSSL_malloc(4 * n * sizeof(FP));
+		xq = OPENSSL_malloc(3 * n * sizeof(FP2));
+		if (xp == NULL || xq == NULL) {
+			goto err;
+		}
+	}
+	yp = xp + n;
+	s = yp + n;
+	t = s + n;
+	yq = xq + n;
+	zq = yq + n;
+
+	for (j = 0; j < n; j++) {
+		if (!EC_POINT_get_affine_coordinates_GFp(group.ec, g[j], a, b, ctx)) {
+			goto err;
+		}
+		if (!FP_read_bn(&xp[j], a) || !FP_read_bn(&yp[j], b)) {
+			goto err;
+		}
+		/* s = 3 * xp, t = -yp. */
+		FP_add(&s[j], &xp[j], &xp[j]);
+		FP_add(&s[j], &s[j], &xp[j]);
+		FP_neg(&t[j], &yp[j]);
+
+		FP2_copy(&xq[j], x[j]);
+		FP2_copy(&yq[j], y[j]);
+		FP2_zero(&zq[j]);
+		FP_copy(&zq[j].f[0], &group.one);
+	}
+
+	/* The first line only fills sparse positions, so clear the rest. */
+	FP12_zero(r);
+	if (!op_dbl(r, &xq[0], &yq[0], &zq[0], &xq[0], &yq[0], &zq[0], &s[0], &t[0])) {
 		goto err;
 	}
-	if (!FP12_frb(&group, &t3, &t3, group.bn)) {
+	for (j = 1; j < n; j++) {
+		if (!op_dbl(&l, &xq[j], &yq[j], &zq[j], &xq[j], &yq[j], &zq[j], &s[j], &t[j])) {
+			goto err;
+		}
+		if (!FP12_mul_dxs_lzr(&group, r, r, &l)) {
+			goto err;
+		}
+	}
+	if (group.par[1] != 0) {
+		for (j = 0; j < n; j++) {
+			if (!op_add_dig(&l, &xq[j], &yq[j], &zq[j], x[j], y[j], group.par[1], &xp[j], &yp[j])) {
+				goto err;
+			}
+			if (!FP12_mul_dxs_lzr(&group, r, r, &l)) {
+				goto err;
+			}
+		}
+	}
+	/* All pairs share a single squaring of the accumulator per digit. */
+	for (i = 2; i < group.par_len; i++) {
+		if (!FP12_sqr_lzr(&group, r, r)) {
+			goto err;
+		}
+		for (j = 0; j < n; j++) {
+			if (!op_dbl(&l, &xq[j], &yq[j], &zq[j], &xq[j], &yq[j], &zq[j], &s[j], &t[j])) {
+				goto err;
+			}
+			if (group.par[i] == 0) {
+				if (!FP12_mul_dxs_lzr(&group, r, r, &l)) {
+					goto err;
+				}
+				continue;
+			}
+			/* Merge the doubling and addition lines into one product. */
+			if (!op_add_dig(&m, &xq[j], &yq[j], &zq[j], x[j], y[j], group.par[i], &xp[j], &yp[j])) {
+				goto err;
+			}
+			if (!FP12_mul_dxs_dxs(&group, &m, &l, &m)) {
+				goto err;
+			}
+			if (!FP12_mul_dxd_lzr(&group, r, r, &m)) {
+				goto err;
+			}
+		}
+	}
+
+	if (!FP12_inv_uni(&group, r, r)) {
 		goto err;
 	}
-	if (!FP12_mul(&group, r, r, &t3, group.bn)) {
+	for (j = 0; j < n; j++) {
+		if (!FP2_neg(&group, &yq[j], &yq[j])) {
+			goto err;
+		}
+		if (!op_fin(r, &xq[j], &yq[j], &zq[j], x[j], y[j], &xp[j], &yp[j])) {
+			goto err;
+		}
+	}
+	if (!op_exp(r, r)) {
 		goto err;
 	}
 
 	ret = 1;
+
 err:
-	FP12_free(&t0);
-	FP12_free(&t1);
-	FP12_free(&t2);
-	FP12_free(&t3);
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
+	if (xp != NULL) {
+		OPENSSL_cleanse(xp, 4 * n * sizeof(FP));
+		if (xp != sp) {
+			OPENSSL_free(xp);
+		}
+	}
+	if (xq != NULL) {
+		OPENSSL_cleanse(xq, 3 * n * sizeof(FP2));
+		if (xq != sq) {
+			OPENSSL_free(xq);
+		}
+	}
+	FP12_free(&l);
+	FP12_free(&m);
 	return ret;
 }
 
-int op_map(FP12 *r, const EC_POINT *g, const FP2 *x, const FP2 *y) {
-	BIGNUM *u, *xp, *yp, *s, *t;
-	FP2 xq, yq, zq;
-	FP12 l;
-	int i, ret = 0;
+int op_map(FP12 *r, const EC_POINT *g, const FP2 *x, const FP2 *y, BN_CTX *ctx) {
+	return op_map_sim(r, &g, &x, &y, 1, ctx);
+}
 
-	u = BN_CTX_get(group.bn);
-	xp = BN_CTX_get(group.bn);
-	yp = BN_CTX_get(group.bn);
-	s = BN_CTX_get(group.bn);
-	t = BN_CTX_get(group.bn);
-	if (u == NULL || xp == NULL || yp == NULL || s == NULL || t == NULL) {
-		goto err;
+void G2_PRE_init(G2_PRE *t) {
+	t->l = NULL;
+	t->n = 0;
+}
+
+void G2_PRE_free(G2_PRE *t) {
+	if (t->l != NULL) {
+		OPENSSL_free(t->l);
 	}
+	t->l = NULL;
+	t->n = 0;
+}
+
+/* Stores the P-dependent and constant coefficients of a sparse line. */
+static void op_put(G2_PRE *t, const FP12 *l) {
+	FP2_copy(&t->l[3 * t->n], &l->f[1].f[0]);
+	FP2_copy(&t->l[3 * t->n + 1], &l->f[0].f[0]);
+	FP2_copy(&t->l[3 * t->n + 2], &l->f[1].f[1]);
+	t->n++;
+}
+
+/* Evaluates the next stored line at P. */
+static void op_get(FP12 *l, const G2_PRE *t, int *k, const FP *xp, const FP *yp) {
+	const FP2 *c = &t->l[3 * (*k)];
+
+	FP_mul(&l->f[1].f[0].f[0], &c[0].f[0], xp);
+	FP_mul(&l->f[1].f[0].f[1], &c[0].f[1], xp);
+	FP_mul(&l->f[0].f[0].f[0], &c[1].f[0], yp);
+	FP_mul(&l->f[0].f[0].f[1], &c[1].f[1], yp);
+	FP2_copy(&l->f[1].f[1], &c[2]);
+	(*k)++;
+}
+
+/* Multiplies the next line, or the product of the next two, into r. */
+static int op_get_mul(FP12 *r, FP12 *l, FP12 *m, const G2_PRE *t, int *k, int two, const FP *xp, const FP *yp) {
+	op_get(l, t, k, xp, yp);
+	if (!two) {
+		return FP12_mul_dxs_lzr(&group, r, r, l);
+	}
+	op_get(m, t, k, xp, yp);
+	if (!FP12_mul_dxs_dxs(&group, m, l, m)) {
+		return 0;
+	}
+	return FP12_mul_dxd_lzr(&group, r, r, m);
+}
+
+int op_precompute_g2(G2_PRE *t, const FP2 *x, const FP2 *y) {
+	FP s, v;
+	FP2 xq, yq, zq, x2, y2;
+	FP12 l;
+	int i, n, ret = 0;
+
 	FP2_init(&xq);
 	FP2_init(&yq);
 	FP2_init(&zq);
+	FP2_init(&x2);
+	FP2_init(&y2);
 	FP12_init(&l);
+	FP12_zero(&l);
+	G2_PRE_free(t);
 
-	if (!EC_POINT_get_affine_coordinates_GFp(group.ec, g, xp, yp, group.bn)) {
-		goto err;
+	/* One doubling per digit after the first, one addition per nonzero digit, two final lines. */
+	n = group.par_len - 1 + 2;
+	for (i = 1; i < group.par_len; i++) {
+		n += (group.par[i] != 0);
 	}
-
-	if (!BN_set_bit(u, 62) || !BN_set_bit(u, 55) || !BN_set_bit(u, 0)) {
+	t->l = OPENSSL_malloc(3 * n * sizeof(FP2));
+	if (t->l == NULL) {
 		goto err;
 	}
-	if (!BN_mul_word(u, 6) || !BN_sub_word(u, 2)) {
-		goto err;
+
+	/*
+	 * Run the loop with P = (1, 1) so that each line keeps the coefficients
+	 * of xp and yp. Doubling lines use 3xp and -yp, so fold those in too.
+	 */
+	FP_add(&s, &group.one, &group.one);
+	FP_add(&s, &s, &group.one);
+	FP_neg(&v, &group.one);
+
+	FP2_copy(&xq, x);
+	FP2_copy(&yq, y);
+	FP2_zero(&zq);
+	FP_copy(&zq.f[0], &group.one);
+
+	for (i = 1; i < group.par_len; i++) {
+		if (!op_dbl(&l, &xq, &yq, &zq, &xq, &yq, &zq, &s, &v)) {
+			goto err;
+		}
+		op_put(t, &l);
+		if (group.par[i] != 0) {
+			if (!op_add_dig(&l, &xq, &yq, &zq, x, y, group.par[i], &group.one, &group.one)) {
+				goto err;
+			}
+			op_put(t, &l);
+		}
 	}
 
-	if (!group.ec->meth->field_encode(group.ec, xp, xp, group.bn)) {
+	/* The accumulator is conjugated here, which negates the running point. */
+	if (!FP2_neg(&group, &yq, &yq)) {
 		goto err;
 	}
-	if (!group.ec->meth->field_encode(group.ec, yp, yp, group.bn)) {
+	if (!op_frb(&x2, &y2, x, y)) {
 		goto err;
 	}
-	if (!BN_mod_add_quick(s, xp, xp, group.field)) {
+	if (!op_add(&l, &xq, &yq, &zq, &x2, &y2, &group.one, &group.one)) {
 		goto err;
 	}
-	if (!BN_mod_add_quick(s, s, xp, group.field)) {
+	op_put(t, &l);
+	if (!op_frb(&x2, &y2, &x2, &y2)) {
 		goto err;
 	}
-	if (!BN_sub(t, group.field, yp)) {
-		goto err;
-	}	
-
-	if (!group.ec->meth->field_encode(group.ec, &x->f[0], &x->f[0], group.bn) ||
-			!group.ec->meth->field_encode(group.ec, &x->f[1], &x->f[1], group.bn)) {
+	if (!FP2_neg(&group, &y2, &y2)) {
 		goto err;
 	}
-	if (!group.ec->meth->field_encode(group.ec, &y->f[0], &y->f[0], group.bn) ||
-			!group.ec->meth->field_encode(group.ec, &y->f[1], &y->f[1], group.bn)) {
+	if (!op_add(&l, &xq, &yq, &zq, &x2, &y2, &group.one, &group.one)) {
 		goto err;
 	}
+	op_put(t, &l);
 
-	FP2_copy(&xq, x);
-	FP2_copy(&yq, y);	
-	FP2_zero(&zq);
-	if (!BN_set_word(&zq.f[0], 1)) {
-		goto err;
+	ret = 1;
+
+err:
+	FP2_free(&xq);
+	FP2_free(&yq);
+	FP2_free(&zq);
+	FP2_free(&x2);
+	FP2_free(&y2);
+	FP12_free(&l);
+	return ret;
+}
+
+int op_map_pre(FP12 *r, const EC_POINT *g, const G2_PRE *t, BN_CTX *ctx) {
+	BN_CTX *new_ctx = NULL;
+	BIGNUM *a, *b;
+	FP xp, yp;
+	FP12 l, m;
+	int i, k = 0, ret = 0;
+
+	FP12_init(&l);
+	FP12_zero(&l);
+	FP12_init(&m);
+	FP12_zero(&m);
+	if (ctx == NULL && (ctx = new_ctx = BN_CTX_new()) == NULL) {
+		return 0;
 	}
 
-	if (!group.ec->meth->field_encode(group.ec, &zq.f[0], &zq.f[0], group.bn) ||
-			!group.ec->meth->field_encode(group.ec, &zq.f[1], &zq.f[1], group.bn)) {
+	BN_CTX_start(ctx);
+	a = BN_CTX_get(ctx);
+	b = BN_CTX_get(ctx);
+	if (b == NULL || t->l == NULL) {
 		goto err;
 	}
 
-	if (!op_dbl(r, &xq, &yq, &zq, &xq, &yq, &zq, s, t)) {
+	if (!EC_POINT_get_affine_coordinates_GFp(group.ec, g, a, b, ctx)) {
 		goto err;
 	}
-	if (BN_is_bit_set(u, BN_num_bits(u) - 2)) {
-		if (!op_add(&l, &xq, &yq, &zq, x, y, xp, yp)) {
-			goto err;
-		}
-		if (!FP12_mul_dxs(&group, r, r, &l, group.bn)) {
-			goto err;
-		}		
+	if (!FP_read_bn(&xp, a) || !FP_read_bn(&yp, b)) {
+		goto err;
 	}
-	for (i = BN_num_bits(u) - 3; i >= 0; i--) {
-		if (!FP12_sqr(&group, r, r, group.bn)) {
-			goto err;
-		}		
-		if (!op_dbl(&l, &xq, &yq, &zq, &xq, &yq, &zq, s, t)) {
+	FP12_zero(r);
+	FP_copy(&r->f[0].f[0].f[0], &group.one);
+	for (i = 1; i < group.par_len; i++) {
+		if (i > 1 && !FP12_sqr_lzr(&group, r, r)) {
 			goto err;
 		}
-		if (!FP12_mul_dxs(&group, r, r, &l, group.bn)) {
+		if (!op_get_mul(r, &l, &m, t, &k, group.par[i] != 0, &xp, &yp)) {
 			goto err;
-		}		
-		if (BN_is_bit_set(u, i)) {
-			if (!op_add(&l, &xq, &yq, &zq, x, y, xp, yp)) {
-				goto err;
-			}			
-			if (!FP12_mul_dxs(&group, r, r, &l, group.bn)) {
-				goto err;
-			}
 		}
 	}
 
-	if (!FP12_inv_uni(&group, r, r, group.bn)) {
+	if (!FP12_inv_uni(&group, r, r)) {
 		goto err;
 	}
-	if (!FP2_neg(&group, &yq, &yq)) {
+	if (!op_get_mul(r, &l, &m, t, &k, 1, &xp, &yp)) {
 		goto err;
 	}
-
-	if (!op_fin(r, &xq, &yq, &zq, x, y, xp, yp)) {
-		goto err;
-	}
-	if (!op_exp(r, r)) {
+	if (k != t->n || !op_exp(r, r)) {
 		goto err;
 	}
 
-	if (!group.ec->meth->field_decode(group.ec, &x->f[0], &x->f[0], group.bn) ||
-			!group.ec->meth->field_decode(group.ec, &x->f[1], &x->f[1], group.bn)) {
-		goto err;
-	}
-	if (!group.ec->meth->field_decode(group.ec, &y->f[0], &y->f[0], group.bn) ||
-			!group.ec->meth->field_decode(group.ec, &y->f[1], &y->f[1], group.bn)) {
-		goto err;
-	}
-	
+	ret = 1;
+
 err:
-	BN_free(u);
-	BN_free(xp);
-	BN_free(yp);
-	BN_free(s);
-	BN_free(t);
-	FP2_free(&xq);
-	FP2_free(&yq);
-	FP2_free(&zq);
+	BN_CTX_end(ctx);
+	BN_CTX_free(new_ctx);
 	FP12_free(&l);
+	FP12_free(&m);
 	return ret;
 }
@@ -20,10 +20,210 @@
  * along with OpenPairing. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <time.h>
+#include <unistd.h>
+#include <openssl/err.h>
+
 #include "op.h"
 #include "op_test.h"
 #include "op_bench.h"
 
+/* Enough points for the multi-scalar multiplications to use affine buckets. */
+#define MSM_TEST	700
+
+/* Number of points in the multi-scalar multiplication benchmarks. */
+#define MSM_BENCH	1024
+
+static int addition1(void) {
+	int code = 0;
+	FP a, b, c, d, e;
+
+	TEST_BEGIN("addition is commutative") {
+		FP_rand(&a);
+		FP_rand(&b);
+		FP_add(&d, &a, &b);
+		FP_add(&e, &b, &a);
+		TEST_ASSERT(FP_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("addition is associative") {
+		FP_rand(&a);
+		FP_rand(&b);
+		FP_rand(&c);
+		FP_add(&d, &a, &b);
+		FP_add(&d, &d, &c);
+		FP_add(&e, &b, &c);
+		FP_add(&e, &a, &e);
+		TEST_ASSERT(FP_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("addition has inverse") {
+		FP_rand(&a);
+		FP_neg(&d, &a);
+		FP_add(&e, &a, &d);
+		TEST_ASSERT(FP_is_zero(&e), end);
+	} TEST_END;
+
+	TEST_BEGIN("halving is the inverse of doubling") {
+		FP_rand(&a);
+		FP_dbl(&d, &a);
+		FP_hlv(&e, &d);
+		TEST_ASSERT(FP_cmp(&e, &a) == 0, end);
+	} TEST_END;
+
+	code = 1;
+
+  end:
+	return code;
+}
+
+static int multiplication1(void) {
+	int code = 0;
+	FP a, b, c, d, e, f, v[INV_STACK + 4], w[INV_STACK + 4];
+	DV t, u;
+	int j, n;
+
+	TEST_BEGIN("multiplication is commutative") {
+		FP_rand(&a);
+		FP_rand(&b);
+		FP_mul(&d, &a, &b);
+		FP_mul(&e, &b, &a);
+		TEST_ASSERT(FP_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("multiplication is associative") {
+		FP_rand(&a);
+		FP_rand(&b);
+		FP_rand(&c);
+		FP_mul(&d, &a, &b);
+		FP_mul(&d, &d, &c);
+		FP_mul(&e, &b, &c);
+		FP_mul(&e, &a, &e);
+		TEST_ASSERT(FP_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("multiplication is distributive") {
+		FP_rand(&a);
+		FP_rand(&b);
+		FP_rand(&c);
+		FP_add(&d, &a, &b);
+		FP_mul(&d, &c, &d);
+		FP_mul(&e, &c, &a);
+		FP_mul(&f, &c, &b);
+		FP_add(&e, &e, &f);
+		TEST_ASSERT(FP_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("lazy-reduced and basic multiplication are compatible") {
+		FP_rand(&a);
+		FP_rand(&b);
+		FP_mul(&d, &a, &b);
+		FP_mul_unr(&t, &a, &b);
+		FP_rdc(&e, &t);
+		TEST_ASSERT(FP_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("squaring and multiplication are compatible") {
+		FP_rand(&a);
+		FP_mul(&d, &a, &a);
+		FP_sqr(&e, &a);
+		TEST_ASSERT(FP_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("inversion is correct") {
+		FP_rand(&a);
+		FP_inv(&b, &a);
+		FP_mul(&c, &a, &b);
+		TEST_ASSERT(FP_cmp(&c, &group.one) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("batch inversion is correct") {
+		/* Cover the stack and heap paths, aliasing and a zero entry. */
+		n = (i & 1) ? INV_STACK + 4 : 5;
+		for (j = 0; j < n; j++) {
+			FP_rand(&v[j]);
+		}
+		FP_zero(&v[n / 2]);
+		FP_inv_batch(w, v, n);
+		for (j = 0; j < n; j++) {
+			FP_zero(&a);
+			FP_inv(&a, &v[j]);
+			TEST_ASSERT(FP_cmp(&a, &w[j]) == 0, end);
+		}
+		FP_inv_batch(v, v, n);
+		for (j = 0; j < n; j++) {
+			TEST_ASSERT(FP_cmp(&v[j], &w[j]) == 0, end);
+		}
+	} TEST_END;
+
+	if (ARCH_has_adx()) {
+		TEST_BEGIN("assembly and portable multiplication are compatible") {
+			FP_rand(&a);
+			FP_rand(&b);
+			FP_select(0);
+			FP_mul(&c, &a, &b);
+			FP_sqr(&d, &a);
+			FP_select(1);
+			FP_mul(&e, &a, &b);
+			FP_sqr(&f, &a);
+			TEST_ASSERT(FP_cmp(&c, &e) == 0 && FP_cmp(&d, &f) == 0, end);
+		} TEST_END;
+
+		TEST_BEGIN("assembly and portable lazy reduction are compatible") {
+			FP_rand(&a);
+			FP_rand(&b);
+			FP_select(0);
+			FP_mul_unr(&t, &a, &b);
+			DV_add(&t, &t, &t);
+			FP_mul_unr(&u, &b, &b);
+			DV_sub(&t, &t, &u);
+			FP_rdc(&c, &t);
+			FP_select(1);
+			FP_mul_unr(&t, &a, &b);
+			DV_add(&t, &t, &t);
+			FP_mul_unr(&u, &b, &b);
+			DV_sub(&t, &t, &u);
+			FP_rdc(&d, &t);
+			TEST_ASSERT(FP_cmp(&c, &d) == 0, end);
+		} TEST_END;
+	}
+
+	code = 1;
+
+  end:
+	return code;
+}
+
+static int conversion1(void) {
+	int code = 0;
+	BIGNUM *t = BN_new();
+	FP a, b, c;
+
+	TEST_BEGIN("reading and writing are compatible") {
+		FP_rand(&a);
+		FP_write_bn(t, &a);
+		FP_read_bn(&b, t);
+		TEST_ASSERT(FP_cmp(&a, &b) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("conditional copy is correct") {
+		FP_rand(&a);
+		FP_rand(&b);
+		FP_write_bn(t, &b);
+		FP_copy_sec(&b, &a, 0);
+		FP_read_bn(&c, t);
+		TEST_ASSERT(FP_cmp(&b, &c) == 0, end);
+		FP_copy_sec(&b, &a, i + 1);
+		TEST_ASSERT(FP_cmp(&a, &b) == 0, end);
+	} TEST_END;
+
+	code = 1;
+
+  end:
+	BN_free(t);
+	return code;
+}
+
 static int addition2(void) {
 	int code = 0;
 	FP2 a, b, c, d, e;
@@ -136,8 +336,8 @@ static int multiplication2(void) {
 	TEST_BEGIN("multiplication is commutative") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		FP2_mul(&group, &d, &a, &b, group.bn);
-		FP2_mul(&group, &e, &b, &a, group.bn);
+		FP2_mul(&group, &d, &a, &b);
+		FP2_mul(&group, &e, &b, &a);
 		TEST_ASSERT(FP2_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
@@ -145,10 +345,10 @@ static int multiplication2(void) {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
 		FP2_rand(&group, &c);
-		FP2_mul(&group, &d, &a, &b, group.bn);
-		FP2_mul(&group, &d, &d, &c, group.bn);
-		FP2_mul(&group, &e, &b, &c, group.bn);
-		FP2_mul(&group, &e, &a, &e, group.bn);
+		FP2_mul(&group, &d, &a, &b);
+		FP2_mul(&group, &d, &d, &c);
+		FP2_mul(&group, &e, &b, &c);
+		FP2_mul(&group, &e, &a, &e);
 		TEST_ASSERT(FP2_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
@@ -157,9 +357,9 @@ static int multiplication2(void) {
 		FP2_rand(&group, &b);
 		FP2_rand(&group, &c);
 		FP2_add(&group, &d, &a, &b);
-		FP2_mul(&group, &d, &c, &d, group.bn);
-		FP2_mul(&group, &e, &c, &a, group.bn);
-		FP2_mul(&group, &f, &c, &b, group.bn);
+		FP2_mul(&group, &d, &c, &d);
+		FP2_mul(&group, &e, &c, &a);
+		FP2_mul(&group, &f, &c, &b);
 		FP2_add(&group, &e, &e, &f);
 		TEST_ASSERT(FP2_cmp(&d, &e) == 0, end);
 	} TEST_END;
@@ -167,16 +367,26 @@ static int multiplication2(void) {
 	TEST_BEGIN("lazy-reduced and basic multiplication are compatible") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		FP2_mul(&group, &d, &a, &b, group.bn);
-		FP2_mul2(&group, &e, &a, &b, group.bn);
+		FP2_mul(&group, &d, &a, &b);
+		FP2_mul2(&group, &e, &a, &b);
 		TEST_ASSERT(FP2_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
 	TEST_BEGIN("squaring and multiplication are compatible") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		FP2_mul(&group, &d, &a, &a, group.bn);
-		FP2_sqr(&group, &e, &a, group.bn);
+		FP2_mul(&group, &d, &a, &a);
+		FP2_sqr(&group, &e, &a);
+		TEST_ASSERT(FP2_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("lazy-reduced and basic squaring are compatible") {
+		DV2 t;
+
+		FP2_rand(&group, &a);
+		FP2_sqr(&group, &d, &a);
+		FP2_sqr_unr(&group, &t, &a);
+		FP2_rdc(&group, &e, &t);
 		TEST_ASSERT(FP2_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
@@ -194,7 +404,8 @@ static int multiplication2(void) {
 
 static int inversion2(void) {
 	int code = 0;
-	FP2 a, b, c, d, e;
+	FP2 a, b, c, d, e, v[INV_STACK + 4], w[INV_STACK + 4];
+	int j, n;
 
 	FP2_init(&a);
 	FP2_init(&b);
@@ -204,11 +415,10 @@ static int inversion2(void) {
 
 	TEST_BEGIN("inversion is correct") {
 		FP2_rand(&group, &a);
-		FP2_inv(&group, &b, &a, group.bn);
-		FP2_mul(&group, &c, &a, &b, group.bn);
+		FP2_inv(&group, &b, &a);
+		FP2_mul(&group, &c, &a, &b);
 		FP2_zero(&b);
-		BN_set_word(&b.f[0], 1);
-		group.ec->meth->field_encode(group.ec, &b.f[0], &b.f[0], group.bn);
+		FP_copy(&b.f[0], &group.one);
 		TEST_ASSERT(FP2_cmp(&c, &b) == 0, end);
 	} TEST_END;
 
@@ -217,12 +427,30 @@ static int inversion2(void) {
 		FP2_rand(&group, &b);
 		FP2_copy(&d, &a);
 		FP2_copy(&e, &b);
-		FP2_inv(&group, &a, &a, group.bn);
-		FP2_inv(&group, &b, &b, group.bn);
-		FP2_inv_sim(&group, &d, &e, &d, &e, group.bn);
+		FP2_inv(&group, &a, &a);
+		FP2_inv(&group, &b, &b);
+		FP2_inv_sim(&group, &d, &e, &d, &e);
 		TEST_ASSERT(FP2_cmp(&d, &a) == 0 && FP2_cmp(&e, &b) == 0, end);
 	} TEST_END;
 
+	TEST_BEGIN("batch inversion is correct") {
+		n = (i & 1) ? INV_STACK + 4 : 5;
+		for (j = 0; j < n; j++) {
+			FP2_rand(&group, &v[j]);
+		}
+		FP2_zero(&v[n / 2]);
+		FP2_inv_batch(&group, w, v, n);
+		for (j = 0; j < n; j++) {
+			FP2_zero(&a);
+			FP2_inv(&group, &a, &v[j]);
+			TEST_ASSERT(FP2_cmp(&a, &w[j]) == 0, end);
+		}
+		FP2_inv_batch(&group, v, v, n);
+		for (j = 0; j < n; j++) {
+			TEST_ASSERT(FP2_cmp(&v[j], &w[j]) == 0, end);
+		}
+	} TEST_END;
+
 	code = 1;
 
   end:
@@ -346,8 +574,8 @@ static int multiplication6(void) {
 	TEST_BEGIN("multiplication is commutative") {
 		FP6_rand(&group, &a);
 		FP6_rand(&group, &b);
-		FP6_mul(&group, &d, &a, &b, group.bn);
-		FP6_mul(&group, &e, &b, &a, group.bn);
+		FP6_mul(&group, &d, &a, &b);
+		FP6_mul(&group, &e, &b, &a);
 		TEST_ASSERT(FP6_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
@@ -355,10 +583,10 @@ static int multiplication6(void) {
 		FP6_rand(&group, &a);
 		FP6_rand(&group, &b);
 		FP6_rand(&group, &c);
-		FP6_mul(&group, &d, &a, &b, group.bn);
-		FP6_mul(&group, &d, &d, &c, group.bn);
-		FP6_mul(&group, &e, &b, &c, group.bn);
-		FP6_mul(&group, &e, &a, &e, group.bn);
+		FP6_mul(&group, &d, &a, &b);
+		FP6_mul(&group, &d, &d, &c);
+		FP6_mul(&group, &e, &b, &c);
+		FP6_mul(&group, &e, &a, &e);
 		TEST_ASSERT(FP6_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
@@ -367,9 +595,9 @@ static int multiplication6(void) {
 		FP6_rand(&group, &b);
 		FP6_rand(&group, &c);
 		FP6_add(&group, &d, &a, &b);		
-		FP6_mul(&group, &d, &c, &d, group.bn);
-		FP6_mul(&group, &e, &c, &a, group.bn);
-		FP6_mul(&group, &f, &c, &b, group.bn);
+		FP6_mul(&group, &d, &c, &d);
+		FP6_mul(&group, &e, &c, &a);
+		FP6_mul(&group, &f, &c, &b);
 		FP6_add(&group, &e, &e, &f);
 		TEST_ASSERT(FP6_cmp(&d, &e) == 0, end);
 	} TEST_END;
@@ -377,11 +605,44 @@ static int multiplication6(void) {
 	TEST_BEGIN("squaring and multiplication are compatible") {
 		FP6_rand(&group, &a);
 		FP6_rand(&group, &b);
-		FP6_mul(&group, &d, &a, &a, group.bn);
-		FP6_sqr(&group, &e, &a, group.bn);
+		FP6_mul(&group, &d, &a, &a);
+		FP6_sqr(&group, &e, &a);
 		TEST_ASSERT(FP6_cmp(&d, &e) == 0, end);
 	} TEST_END;	
 
+	TEST_BEGIN("lazy-reduced and basic multiplication are compatible") {
+		DV6 t;
+
+		FP6_rand(&group, &a);
+		FP6_rand(&group, &b);
+		FP6_mul(&group, &d, &a, &b);
+		FP6_mul_unr(&group, &t, &a, &b);
+		FP6_rdc(&group, &e, &t);
+		TEST_ASSERT(FP6_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("lazy-reduced and basic sparse multiplication are compatible") {
+		DV6 t;
+
+		FP6_rand(&group, &a);
+		FP6_rand(&group, &b);
+		FP2_zero(&b.f[2]);
+		FP6_mul_dxs(&group, &d, &a, &b);
+		FP6_mul_dxs_unr(&group, &t, &a, &b);
+		FP6_rdc(&group, &e, &t);
+		TEST_ASSERT(FP6_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("lazy-reduced and basic squaring are compatible") {
+		DV6 t;
+
+		FP6_rand(&group, &a);
+		FP6_sqr(&group, &d, &a);
+		FP6_sqr_unr(&group, &t, &a);
+		FP6_rdc(&group, &e, &t);
+		TEST_ASSERT(FP6_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
 	code = 1;
 
   end:
@@ -404,11 +665,10 @@ static int inversion6(void) {
 
 	TEST_BEGIN("inversion is correct") {
 		FP6_rand(&group, &a);
-		FP6_inv(&group, &b, &a, group.bn);
-		FP6_mul(&group, &c, &a, &b, group.bn);
+		FP6_inv(&group, &b, &a);
+		FP6_mul(&group, &c, &a, &b);
 		FP6_zero(&b);
-		BN_set_word(&b.f[0].f[0], 1);
-		group.ec->meth->field_encode(group.ec, &b.f[0].f[0], &b.f[0].f[0], group.bn);
+		FP_copy(&b.f[0].f[0], &group.one);
 		TEST_ASSERT(FP6_cmp(&c, &b) == 0, end);
 	} TEST_END;
 
@@ -533,8 +793,8 @@ static int multiplication12(void) {
 	TEST_BEGIN("multiplication is commutative") {
 		FP12_rand(&group, &a);
 		FP12_rand(&group, &b);
-		FP12_mul(&group, &d, &a, &b, group.bn);
-		FP12_mul(&group, &e, &b, &a, group.bn);
+		FP12_mul(&group, &d, &a, &b);
+		FP12_mul(&group, &e, &b, &a);
 		TEST_ASSERT(FP12_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
@@ -542,10 +802,10 @@ static int multiplication12(void) {
 		FP12_rand(&group, &a);
 		FP12_rand(&group, &b);
 		FP12_rand(&group, &c);
-		FP12_mul(&group, &d, &a, &b, group.bn);
-		FP12_mul(&group, &d, &d, &c, group.bn);
-		FP12_mul(&group, &e, &b, &c, group.bn);
-		FP12_mul(&group, &e, &a, &e, group.bn);
+		FP12_mul(&group, &d, &a, &b);
+		FP12_mul(&group, &d, &d, &c);
+		FP12_mul(&group, &e, &b, &c);
+		FP12_mul(&group, &e, &a, &e);
 		TEST_ASSERT(FP12_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
@@ -554,9 +814,9 @@ static int multiplication12(void) {
 		FP12_rand(&group, &b);
 		FP12_rand(&group, &c);
 		FP12_add(&group, &d, &a, &b);
-		FP12_mul(&group, &d, &c, &d, group.bn);
-		FP12_mul(&group, &e, &c, &a, group.bn);
-		FP12_mul(&group, &f, &c, &b, group.bn);
+		FP12_mul(&group, &d, &c, &d);
+		FP12_mul(&group, &e, &c, &a);
+		FP12_mul(&group, &f, &c, &b);
 		FP12_add(&group, &e, &e, &f);
 		TEST_ASSERT(FP12_cmp(&d, &e) == 0, end);
 	} TEST_END;
@@ -564,8 +824,53 @@ static int multiplication12(void) {
 	TEST_BEGIN("squaring and multiplication are compatible") {
 		FP12_rand(&group, &a);
 		FP12_rand(&group, &b);
-		FP12_mul(&group, &d, &a, &a, group.bn);
-		FP12_sqr(&group, &e, &a, group.bn);
+		FP12_mul(&group, &d, &a, &a);
+		FP12_sqr(&group, &e, &a);
+		TEST_ASSERT(FP12_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("lazy-reduced and basic multiplication are compatible") {
+		FP12_rand(&group, &a);
+		FP12_rand(&group, &b);
+		FP12_mul(&group, &d, &a, &b);
+		FP12_mul_lzr(&group, &e, &a, &b);
+		TEST_ASSERT(FP12_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("lazy-reduced and basic sparse multiplication are compatible") {
+		FP12_rand(&group, &a);
+		FP12_rand(&group, &b);
+		FP2_zero(&b.f[0].f[1]);
+		FP2_zero(&b.f[0].f[2]);
+		FP2_zero(&b.f[1].f[2]);
+		FP12_mul_dxs(&group, &d, &a, &b);
+		FP12_mul_dxs_lzr(&group, &e, &a, &b);
+		TEST_ASSERT(FP12_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("lazy-reduced and basic squaring are compatible") {
+		FP12_rand(&group, &a);
+		FP12_sqr(&group, &d, &a);
+		FP12_sqr_lzr(&group, &e, &a);
+		TEST_ASSERT(FP12_cmp(&d, &e) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("merging two sparse multiplications is correct") {
+		FP12_rand(&group, &a);
+		FP12_rand(&group, &b);
+		FP12_rand(&group, &c);
+		FP2_zero(&b.f[0].f[1]);
+		FP2_zero(&b.f[0].f[2]);
+		FP2_zero(&b.f[1].f[2]);
+		FP2_zero(&c.f[0].f[1]);
+		FP2_zero(&c.f[0].f[2]);
+		FP2_zero(&c.f[1].f[2]);
+		FP12_mul_dxs(&group, &d, &a, &b);
+		FP12_mul_dxs(&group, &d, &d, &c);
+		FP12_mul_dxs_dxs(&group, &f, &b, &c);
+		FP12_mul(&group, &e, &b, &c);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+		FP12_mul_dxd_lzr(&group, &e, &a, &f);
 		TEST_ASSERT(FP12_cmp(&d, &e) == 0, end);
 	} TEST_END;
 
@@ -583,7 +888,8 @@ static int multiplication12(void) {
 
 static int inversion12(void) {
 	int code = 0;
-	FP12 a, b, c;
+	FP12 a, b, c, v[INV_STACK + 4], w[INV_STACK + 4];
+	int j, n;
 
 	FP12_init(&a);
 	FP12_init(&b);
@@ -591,14 +897,33 @@ static int inversion12(void) {
 
 	TEST_BEGIN("inversion is correct") {
 		FP12_rand(&group, &a);
-		FP12_inv(&group, &b, &a, group.bn);
-		FP12_mul(&group, &c, &a, &b, group.bn);
+		FP12_inv(&group, &b, &a);
+		FP12_mul(&group, &c, &a, &b);
 		FP12_zero(&b);
-		BN_set_word(&b.f[0].f[0].f[0], 1);
-		group.ec->meth->field_encode(group.ec, &b.f[0].f[0].f[0], &b.f[0].f[0].f[0], group.bn);
+		FP_copy(&b.f[0].f[0].f[0], &group.one);
 		TEST_ASSERT(FP12_cmp(&c, &b) == 0, end);
 	} TEST_END;
 
+	TEST_BEGIN("batch inversion is correct") {
+		n = (i & 1) ? INV_STACK + 4 : 5;
+		for (j = 0; j < n; j++) {
+			FP12_rand(&group, &v[j]);
+		}
+		FP12_zero(&v[n / 2]);
+		FP12_inv_batch(&group, w, v, n);
+		for (j = 0; j < n; j++) {
+			FP12_zero(&a);
+			if (j != n / 2) {
+				FP12_inv(&group, &a, &v[j]);
+			}
+			TEST_ASSERT(FP12_cmp(&a, &w[j]) == 0, end);
+		}
+		FP12_inv_batch(&group, v, v, n);
+		for (j = 0; j < n; j++) {
+			TEST_ASSERT(FP12_cmp(&v[j], &w[j]) == 0, end);
+		}
+	} TEST_END;
+
 	code = 1;
 
   end:
@@ -608,21 +933,650 @@ static int inversion12(void) {
 	return code;
 }
 
+static int frobenius12(void) {
+	int code = 0;
+	FP12 a, b, c;
+
+	FP12_init(&a);
+	FP12_init(&b);
+	FP12_init(&c);
+
+	TEST_BEGIN("Frobenius is a multiplicative map") {
+		FP12_rand(&group, &a);
+		FP12_rand(&group, &b);
+		FP12_mul(&group, &c, &a, &b);
+		FP12_frb(&group, &c, &c);
+		FP12_frb(&group, &a, &a);
+		FP12_frb(&group, &b, &b);
+		FP12_mul(&group, &a, &a, &b);
+		TEST_ASSERT(FP12_cmp(&a, &c) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("squared Frobenius is correct") {
+		FP12_rand(&group, &a);
+		FP12_frb(&group, &b, &a);
+		FP12_frb(&group, &b, &b);
+		FP12_frb2(&group, &c, &a);
+		TEST_ASSERT(FP12_cmp(&b, &c) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("cubed Frobenius is correct") {
+		FP12_rand(&group, &a);
+		FP12_frb(&group, &b, &a);
+		FP12_frb(&group, &b, &b);
+		FP12_frb(&group, &b, &b);
+		FP12_frb3(&group, &c, &a);
+		TEST_ASSERT(FP12_cmp(&b, &c) == 0, end);
+	} TEST_END;
+
+	code = 1;
+
+  end:
+  	FP12_free(&a);
+  	FP12_free(&b);
+  	FP12_free(&c);
+	return code;
+}
+
+static int cyclotomic12(void) {
+	int code = 0, j;
+	FP12 a, b, c, d[3];
+	BIGNUM *e = BN_new();
+
+	FP12_init(&a);
+	FP12_init(&b);
+	FP12_init(&c);
+
+	TEST_BEGIN("batched decompression is correct") {
+		for (j = 0; j < 3; j++) {
+			FP12_rand(&group, &d[j]);
+			op_exp_easy(&d[j], &d[j]);
+		}
+		/* A cyclotomic element equals the decompression of its own g2..g5. */
+		FP12_copy(&a, &d[0]);
+		FP12_copy(&c, &d[2]);
+		FP12_zero(&b);
+		FP12_copy(&d[1], &b);
+		FP_copy(&d[1].f[0].f[0].f[0], &group.one);
+		FP2_zero(&d[0].f[0].f[0]);
+		FP2_zero(&d[0].f[1].f[1]);
+		FP2_zero(&d[2].f[0].f[0]);
+		FP2_zero(&d[2].f[1].f[1]);
+		FP2_zero(&d[1].f[0].f[0]);
+		FP12_back_sim(&group, d, d, 3);
+		TEST_ASSERT(FP12_cmp(&a, &d[0]) == 0 && FP12_cmp(&c, &d[2]) == 0, end);
+		FP_copy(&b.f[0].f[0].f[0], &group.one);
+		TEST_ASSERT(FP12_cmp(&b, &d[1]) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("cyclotomic squaring is correct") {
+		FP12_rand(&group, &a);
+		op_exp_easy(&a, &a);
+		FP12_sqr(&group, &b, &a);
+		FP12_sqr_cyc(&group, &c, &a);
+		TEST_ASSERT(FP12_cmp(&b, &c) == 0, end);
+		FP12_sqr_cyc(&group, &a, &a);
+		TEST_ASSERT(FP12_cmp(&a, &c) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("sparse cyclotomic exponentiation is correct") {
+		FP12_rand(&group, &a);
+		op_exp_easy(&a, &a);
+		BN_zero(e);
+		BN_set_bit(e, 62);
+		BN_set_bit(e, 55);
+		BN_set_bit(e, 0);
+		FP12_exp_cyc(&group, &b, &a);
+		FP12_exp_cyc_gen(&group, &c, &a, e);
+		TEST_ASSERT(FP12_cmp(&b, &c) == 0, end);
+		BN_clear_bit(e, 0);
+		BN_set_bit(e, 3);
+		FP12_copy(&b, &a);
+		for (j = 61; j >= 0; j--) {
+			FP12_sqr(&group, &b, &b);
+			if (BN_is_bit_set(e, j)) {
+				FP12_mul(&group, &b, &b, &a);
+			}
+		}
+		FP12_exp_cyc_gen(&group, &c, &a, e);
+		TEST_ASSERT(FP12_cmp(&b, &c) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("dense cyclotomic exponentiation is correct") {
+		FP12_rand(&group, &a);
+		op_exp_easy(&a, &a);
+		BN_rand(e, 254, 0, 0);
+		FP12_exp_cyc_gen(&group, &b, &a, e);
+		BN_set_negative(e, 1);
+		FP12_exp_cyc_gen(&group, &c, &a, e);
+		FP12_mul(&group, &b, &b, &c);
+		FP12_zero(&c);
+		FP_copy(&c.f[0].f[0].f[0], &group.one);
+		TEST_ASSERT(FP12_cmp(&b, &c) == 0, end);
+		BN_set_negative(e, 0);
+		BN_sub_word(e, 1);
+		FP12_exp_cyc_gen(&group, &b, &a, e);
+		FP12_mul(&group, &b, &b, &a);
+		BN_add_word(e, 1);
+		FP12_exp_cyc_gen(&group, &c, &a, e);
+		TEST_ASSERT(FP12_cmp(&b, &c) == 0, end);
+	} TEST_END;
+
+	code = 1;
+
+  end:
+  	FP12_free(&a);
+  	FP12_free(&b);
+  	FP12_free(&c);
+	BN_free(e);
+	return code;
+}
+
+/*
+ * Sets k to a random scalar modulo n for the i-th test iteration, replacing it
+ * by 0, 1 or 2, by n - 1, by its negative or by k + n on some iterations.
+ */
+static void test_scalar(BIGNUM *k, const BIGNUM *n, int i) {
+	BN_rand_range(k, n);
+	if (i < 3) {
+		BN_set_word(k, i);
+	} else if (i == 3) {
+		BN_sub(k, n, BN_value_one());
+	} else if (i % 3 == 1) {
+		BN_set_negative(k, 1);
+	} else if (i % 3 == 2) {
+		BN_add(k, k, n);
+	}
+}
+
+/* How test_msm asks for each point to be set. */
+enum { MSM_RAND, MSM_COPY, MSM_NEG, MSM_INFTY };
+
+/*
+ * Sets up the scalars of the i-th multi-scalar test and returns their number.
+ * Repeated and opposite points meet in a bucket, so kind[j] asks for a copy
+ * of point j - 1 or the negative of point j - 2, with the same scalar, as
+ * well as for points at infinity. Scalars are also zero or negative.
+ */
+static int test_msm(BIGNUM **ks, char *kind, const BIGNUM *n, int i) {
+	int j, m = (i < 2 ? MSM_TEST : 1 + i % 9);
+
+	for (j = 0; j < m; j++) {
+		BN_rand_range(ks[j], n);
+		kind[j] = MSM_RAND;
+		if (j % 5 == 1) {
+			kind[j] = MSM_COPY;
+			BN_copy(ks[j], ks[j - 1]);
+		} else if (j % 5 == 2) {
+			kind[j] = MSM_NEG;
+			BN_copy(ks[j], ks[j - 2]);
+		} else if (j % 5 == 3) {
+			kind[j] = MSM_INFTY;
+		} else if (j % 5 == 4) {
+			BN_set_negative(ks[j], 1);
+		}
+	}
+	if (m > 4) {
+		BN_zero(ks[4]);
+	}
+	return m;
+}
+
+static int curve1(void) {
+	int code = 0, j, m;
+	BN_CTX *ctx = BN_CTX_new();
+	BIGNUM *k = BN_new(), *n = BN_new(), *ks[MSM_TEST];
+	EC_POINT *a = EC_POINT_new(group.ec), *b = EC_POINT_new(group.ec);
+	EC_POINT *c = EC_POINT_new(group.ec), *ps[MSM_TEST];
+	char kind[MSM_TEST];
+
+	EC_GROUP_get_order(group.ec, n, ctx);
+	for (j = 0; j < MSM_TEST; j++) {
+		ks[j] = BN_new();
+		ps[j] = EC_POINT_new(group.ec);
+	}
+
+	TEST_BEGIN("GLV multiplication agrees with generic multiplication") {
+		BN_rand_range(k, n);
+		EC_POINT_mul(group.ec, a, k, NULL, NULL, ctx);
+		test_scalar(k, n, i);
+		EC_POINT_mul(group.ec, b, NULL, a, k, ctx);
+		G1_mul_glv(&group, c, a, k, ctx);
+		TEST_ASSERT(EC_POINT_cmp(group.ec, b, c, ctx) == 0, end);
+	} TEST_END;
+
+	TEST_ONCE("GLV multiplication handles the point at infinity") {
+		EC_POINT_set_to_infinity(group.ec, a);
+		BN_rand_range(k, n);
+		G1_mul_glv(&group, c, a, k, NULL);
+		TEST_ASSERT(EC_POINT_is_at_infinity(group.ec, c), end);
+	} TEST_END;
+
+	TEST_BEGIN("fixed-base multiplication agrees with generic multiplication") {
+		test_scalar(k, n, i);
+		EC_POINT_mul(group.ec, b, k, NULL, NULL, ctx);
+		G1_mul_gen(&group, c, k, i & 1 ? NULL : ctx);
+		TEST_ASSERT(EC_POINT_cmp(group.ec, b, c, ctx) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("multi-scalar multiplication agrees with a sum of products") {
+		m = test_msm(ks, kind, n, i);
+		for (j = 0; j < m; j++) {
+			if (kind[j] == MSM_COPY) {
+				EC_POINT_copy(ps[j], ps[j - 1]);
+			} else if (kind[j] == MSM_NEG) {
+				EC_POINT_copy(ps[j], ps[j - 2]);
+				EC_POINT_invert(group.ec, ps[j], ctx);
+			} else if (kind[j] == MSM_INFTY) {
+				EC_POINT_set_to_infinity(group.ec, ps[j]);
+			} else {
+				BN_rand_range(k, n);
+				EC_POINT_mul(group.ec, ps[j], k, NULL, NULL, ctx);
+			}
+		}
+		EC_POINT_set_to_infinity(group.ec, b);
+		for (j = 0; j < m; j++) {
+			G1_mul_glv(&group, c, ps[j], ks[j], ctx);
+			EC_POINT_add(group.ec, b, b, c, ctx);
+		}
+		G1_msm(&group, c, (const EC_POINT **)ps, (const BIGNUM **)ks, m, i % 3, ctx);
+		TEST_ASSERT(EC_POINT_cmp(group.ec, b, c, ctx) == 0, end);
+	} TEST_END;
+
+	code = 1;
+
+  end:
+	for (j = 0; j < MSM_TEST; j++) {
+		BN_free(ks[j]);
+		EC_POINT_free(ps[j]);
+	}
+	EC_POINT_free(a);
+	EC_POINT_free(b);
+	EC_POINT_free(c);
+	BN_free(k);
+	BN_free(n);
+	BN_CTX_free(ctx);
+	return code;
+}
+
+/* Sets r to a square root of a in Fp2 = Fp[u]/(u^2 + 1), or returns 0 if none. */
+static int fp2_sqrt(FP2 *r, const FP2 *a, BN_CTX *ctx) {
+	const BIGNUM *p = group.field;
+	BIGNUM *a0, *a1, *s, *t, *y;
+	int ret = 0;
+
+	BN_CTX_start(ctx);
+	a0 = BN_CTX_get(ctx);
+	a1 = BN_CTX_get(ctx);
+	s = BN_CTX_get(ctx);
+	t = BN_CTX_get(ctx);
+	y = BN_CTX_get(ctx);
+	if (y == NULL || !FP_write_bn(a0, &a->f[0]) || !FP_write_bn(a1, &a->f[1])) {
+		goto end;
+	}
+	/* a is a square exactly when its norm s^2 = a0^2 + a1^2 is. */
+	BN_mod_sqr(s, a0, p, ctx);
+	BN_mod_sqr(t, a1, p, ctx);
+	BN_mod_add(t, s, t, p, ctx);
+	if (BN_mod_sqrt(s, t, p, ctx) == NULL) {
+		goto end;
+	}
+	/* Then r0^2 = (a0 + s) / 2 or (a0 - s) / 2, and r1 = a1 / (2 * r0). */
+	BN_mod_add(t, a0, s, p, ctx);
+	if (BN_is_odd(t)) {
+		BN_add(t, t, p);
+	}
+	BN_rshift1(t, t);
+	if (BN_mod_sqrt(y, t, p, ctx) == NULL) {
+		BN_mod_sub(t, a0, s, p, ctx);
+		if (BN_is_odd(t)) {
+			BN_add(t, t, p);
+		}
+		BN_rshift1(t, t);
+		if (BN_mod_sqrt(y, t, p, ctx) == NULL) {
+			goto end;
+		}
+	}
+	BN_mod_lshift1(t, y, p, ctx);
+	if (BN_mod_inverse(t, t, p, ctx) == NULL) {
+		goto end;
+	}
+	BN_mod_mul(t, t, a1, p, ctx);
+	ret = FP_read_bn(&r->f[0], y) && FP_read_bn(&r->f[1], t);
+
+  end:
+	ERR_clear_error();
+	BN_CTX_end(ctx);
+	return ret;
+}
+
+static int curve2(void) {
+	int code = 0, j, m;
+	BN_CTX *ctx = BN_CTX_new();
+	G2_POINT a, b, c, d, v[INV_STACK + 4], w[INV_STACK + 4], ps[MSM_TEST];
+	BIGNUM *n = BN_new(), *k = BN_new(), *ks[MSM_TEST];
+	char kind[MSM_TEST];
+
+	G2_init(&a);
+	G2_init(&b);
+	G2_init(&c);
+	G2_init(&d);
+	for (j = 0; j < MSM_TEST; j++) {
+		ks[j] = BN_new();
+	}
+
+	TEST_ONCE("generator is on the curve and has prime order") {
+		EC_GROUP_get_order(group.ec, n, ctx);
+		G2_get_gen(&group, &a);
+		TEST_ASSERT(G2_is_on_curve(&group, &a), end);
+		G2_mul(&group, &b, &a, n);
+		TEST_ASSERT(G2_is_infty(&b), end);
+	} TEST_END;
+
+	TEST_BEGIN("addition is commutative") {
+		G2_rand(&group, &a, ctx);
+		G2_rand(&group, &b, ctx);
+		G2_add(&group, &c, &a, &b);
+		G2_add(&group, &d, &b, &a);
+		TEST_ASSERT(G2_cmp(&group, &c, &d) == 0, end);
+		TEST_ASSERT(G2_is_on_curve(&group, &c), end);
+	} TEST_END;
+
+	TEST_BEGIN("addition is associative") {
+		G2_rand(&group, &a, ctx);
+		G2_rand(&group, &b, ctx);
+		G2_rand(&group, &c, ctx);
+		G2_add(&group, &d, &a, &b);
+		G2_add(&group, &d, &d, &c);
+		G2_add(&group, &b, &b, &c);
+		G2_add(&group, &a, &a, &b);
+		TEST_ASSERT(G2_cmp(&group, &a, &d) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("addition has identity and inverse") {
+		G2_rand(&group, &a, ctx);
+		G2_set_infty(&b);
+		G2_add(&group, &c, &a, &b);
+		TEST_ASSERT(G2_cmp(&group, &a, &c) == 0, end);
+		G2_neg(&group, &b, &a);
+		G2_add(&group, &c, &a, &b);
+		TEST_ASSERT(G2_is_infty(&c), end);
+		G2_sub(&group, &c, &a, &a);
+		TEST_ASSERT(G2_is_infty(&c), end);
+	} TEST_END;
+
+	TEST_BEGIN("mixed and projective addition are compatible") {
+		G2_rand(&group, &a, ctx);
+		G2_rand(&group, &b, ctx);
+		G2_dbl(&group, &b, &b);
+		G2_norm(&group, &d, &b);
+		G2_add(&group, &c, &a, &b);
+		G2_add(&group, &d, &a, &d);
+		TEST_ASSERT(G2_cmp(&group, &c, &d) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("doubling is consistent with addition") {
+		G2_rand(&group, &a, ctx);
+		G2_dbl(&group, &a, &a);
+		G2_dbl(&group, &b, &a);
+		G2_copy(&c, &a);
+		G2_add(&group, &c, &c, &a);
+		TEST_ASSERT(G2_cmp(&group, &b, &c) == 0, end);
+		G2_norm(&group, &d, &a);
+		G2_add(&group, &c, &a, &d);
+		TEST_ASSERT(G2_cmp(&group, &b, &c) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("endomorphism acts as multiplication by p") {
+		G2_rand(&group, &a, ctx);
+		G2_frb(&group, &b, &a);
+		G2_mul(&group, &c, &a, group.field);
+		TEST_ASSERT(G2_cmp(&group, &b, &c) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("GLS multiplication agrees with double-and-add") {
+		G2_rand(&group, &a, ctx);
+		test_scalar(k, n, i);
+		G2_mul(&group, &b, &a, k);
+		G2_mul_gls(&group, &c, &a, k, ctx);
+		TEST_ASSERT(G2_cmp(&group, &b, &c) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("fixed-base multiplication agrees with GLS multiplication") {
+		G2_get_gen(&group, &a);
+		test_scalar(k, n, i);
+		G2_mul_gls(&group, &b, &a, k, ctx);
+		G2_mul_gen(&group, &c, k, i & 1 ? NULL : ctx);
+		TEST_ASSERT(G2_cmp(&group, &b, &c) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("batch normalization is correct") {
+		for (j = 0; j < INV_STACK + 4; j++) {
+			G2_rand(&group, &v[j], ctx);
+			G2_dbl(&group, &v[j], &v[j]);
+		}
+		G2_set_infty(&v[1]);
+		G2_norm_sim(&group, w, v, INV_STACK + 4);
+		for (j = 0; j < INV_STACK + 4; j++) {
+			TEST_ASSERT(G2_cmp(&group, &v[j], &w[j]) == 0, end);
+			if (j != 1) {
+				TEST_ASSERT(FP_cmp(&w[j].z.f[0], &group.one) == 0, end);
+			}
+		}
+	} TEST_END;
+
+	TEST_BEGIN("subgroup membership is detected") {
+		G2_rand(&group, &a, ctx);
+		TEST_ASSERT(G2_is_in_group(&group, &a), end);
+		G2_set_infty(&a);
+		TEST_ASSERT(G2_is_in_group(&group, &a), end);
+		/* b' = y^2 - x^3 from the generator, then a random point of the twist. */
+		FP2_sqr(&group, &c.x, group.g2x);
+		FP2_mul(&group, &c.x, &c.x, group.g2x);
+		FP2_sqr(&group, &c.y, group.g2y);
+		FP2_sub(&group, &c.z, &c.y, &c.x);
+		do {
+			FP2_rand(&group, &a.x);
+			FP2_sqr(&group, &c.x, &a.x);
+			FP2_mul(&group, &c.x, &c.x, &a.x);
+			FP2_add(&group, &c.x, &c.x, &c.z);
+		} while (!fp2_sqrt(&a.y, &c.x, ctx));
+		FP2_zero(&a.z);
+		FP_copy(&a.z.f[0], &group.one);
+		TEST_ASSERT(G2_is_on_curve(&group, &a), end);
+		/* It lies in G2 only with probability 1/h for the cofactor h ~ p. */
+		TEST_ASSERT(!G2_is_in_group(&group, &a), end);
+		/* Clearing the cofactor h = 2p - r moves it into G2. */
+		EC_GROUP_get_order(group.ec, n, ctx);
+		BN_lshift1(k, group.field);
+		BN_sub(k, k, n);
+		G2_mul(&group, &b, &a, k);
+		TEST_ASSERT(G2_is_in_group(&group, &b), end);
+	} TEST_END;
+
+	TEST_BEGIN("multi-scalar multiplication agrees with a sum of products") {
+		m = test_msm(ks, kind, n, i);
+		for (j = 0; j < m; j++) {
+			if (kind[j] == MSM_COPY) {
+				G2_copy(&ps[j], &ps[j - 1]);
+			} else if (kind[j] == MSM_NEG) {
+				G2_neg(&group, &ps[j], &ps[j - 2]);
+			} else if (kind[j] == MSM_INFTY) {
+				G2_set_infty(&ps[j]);
+			} else {
+				G2_rand(&group, &ps[j], ctx);
+			}
+		}
+		G2_set_infty(&b);
+		for (j = 0; j < m; j++) {
+			G2_mul_gls(&group, &c, &ps[j], ks[j], ctx);
+			G2_add(&group, &b, &b, &c);
+		}
+		G2_msm(&group, &c, ps, (const BIGNUM **)ks, m, i % 3, ctx);
+		TEST_ASSERT(G2_cmp(&group, &b, &c) == 0, end);
+	} TEST_END;
+
+	code = 1;
+
+  end:
+	for (j = 0; j < MSM_TEST; j++) {
+		BN_free(ks[j]);
+	}
+	G2_free(&a);
+	G2_free(&b);
+	G2_free(&c);
+	G2_free(&d);
+	BN_free(n);
+	BN_free(k);
+	BN_CTX_free(ctx);
+	return code;
+}
+
 static int pairing(void) {
 	int code = 0;
 	FP12 e, f;
+	G2_PRE t;
+	BN_CTX *ctx = BN_CTX_new();
 	const EC_POINT *g1 = EC_GROUP_get0_generator(group.ec);
 	EC_POINT *p = EC_POINT_dup(g1, group.ec);
+	BIGNUM *k = BN_new(), *n = BN_new();
+	FP12 g;
 
 	FP12_init(&e);
 	FP12_init(&f);
+	FP12_init(&g);
+	G2_PRE_init(&t);
+	EC_GROUP_get_order(group.ec, n, ctx);
+
+	TEST_ONCE("loop parameter schedule encodes |6x + 2|") {
+		BIGNUM *u = BN_new(), *v = NULL;
+		int i, ok;
+
+		ok = (u != NULL && BN_hex2bn(&v, "18300000000000004") != 0);
+		BN_zero(u);
+		for (i = 0; ok && i < group.par_len; i++) {
+			ok = BN_lshift1(u, u);
+			if (group.par[i] > 0) {
+				ok = ok && BN_add_word(u, 1);
+			}
+			if (group.par[i] < 0) {
+				ok = ok && BN_sub_word(u, 1);
+			}
+		}
+		ok = ok && group.par[0] == 1 && BN_cmp(u, v) == 0;
+		BN_free(u);
+		BN_free(v);
+		TEST_ASSERT(ok, end);
+	} TEST_END;
 
 	TEST_ONCE("pairing is linear in the first argument") {
 		/* Notice that pairing returns field elements in Montgomery rep. */
-		op_map(&e, g1, group.g2x, group.g2y);
-		EC_POINT_dbl(group.ec, p, g1, group.bn);
-		FP12_sqr(&group, &e, &e, group.bn);
-		op_map(&f, p, group.g2x, group.g2y);
+		op_map(&e, g1, group.g2x, group.g2y, ctx);
+		EC_POINT_dbl(group.ec, p, g1, ctx);
+		FP12_sqr(&group, &e, &e);
+		op_map(&f, p, group.g2x, group.g2y, ctx);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+	} TEST_END;
+
+	TEST_ONCE("pairing is linear in the second argument") {
+		G2_POINT q;
+		FP2 x, y;
+
+		G2_get_gen(&group, &q);
+		G2_dbl(&group, &q, &q);
+		G2_get_affine(&group, &x, &y, &q);
+		op_map(&e, g1, group.g2x, group.g2y, ctx);
+		FP12_sqr(&group, &e, &e);
+		op_map(&f, g1, &x, &y, ctx);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+	} TEST_END;
+
+	TEST_ONCE("multi-pairing is the product of pairings") {
+		const EC_POINT *g[2];
+		const FP2 *x[2], *y[2];
+
+		g[0] = g1;
+		g[1] = p;
+		x[0] = x[1] = group.g2x;
+		y[0] = y[1] = group.g2y;
+		op_map(&e, g1, group.g2x, group.g2y, ctx);
+		op_map(&f, p, group.g2x, group.g2y, ctx);
+		FP12_mul(&group, &e, &e, &f);
+		op_map_sim(&f, g, x, y, 2, ctx);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+	} TEST_END;
+
+	TEST_ONCE("pairing with precomputed lines is correct") {
+		op_precompute_g2(&t, group.g2x, group.g2y);
+		op_map(&e, p, group.g2x, group.g2y, ctx);
+		op_map_pre(&f, p, &t, ctx);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+	} TEST_END;
+
+	TEST_ONCE("batch pairing is consistent with pairing") {
+		const EC_POINT *g[5];
+		const FP2 *x[5], *y[5];
+		EC_POINT *q[5] = { NULL };
+		FP12 out[5];
+		int i, ok = 1;
+
+		for (i = 0; i < 5; i++) {
+			q[i] = EC_POINT_new(group.ec);
+			if (q[i] == NULL) {
+				ok = 0;
+				break;
+			}
+			if (i == 0) {
+				EC_POINT_copy(q[i], g1);
+			} else {
+				EC_POINT_add(group.ec, q[i], q[i - 1], g1, ctx);
+			}
+			g[i] = q[i];
+			x[i] = group.g2x;
+			y[i] = group.g2y;
+		}
+		if (ok && !op_map_batch(out, g, x, y, 5, 3)) {
+			ok = 0;
+		}
+		for (i = 0; ok && i < 5; i++) {
+			op_map(&e, g[i], x[i], y[i], ctx);
+			ok = (FP12_cmp(&e, &out[i]) == 0);
+		}
+		for (i = 0; i < 5; i++) {
+			EC_POINT_free(q[i]);
+		}
+		TEST_ASSERT(ok, end);
+	} TEST_END;
+
+	TEST_ONCE("pairing allocates its own context when none is given") {
+		op_map(&e, p, group.g2x, group.g2y, ctx);
+		op_map(&f, p, group.g2x, group.g2y, NULL);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+	} TEST_END;
+
+	TEST_ONCE("cached generator of GT is the pairing of the generators") {
+		op_map(&e, g1, group.g2x, group.g2y, ctx);
+		GT_get_gen(&group, &f);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+		FP12_exp_cyc_gen(&group, &e, &f, n);
+		FP12_zero(&f);
+		FP_copy(&f.f[0].f[0].f[0], &group.one);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("fixed-base exponentiation in GT is correct") {
+		test_scalar(k, n, i);
+		FP12_exp_cyc_gen(&group, &e, &group.gt, k);
+		GT_exp_gen(&group, &f, k, ctx);
+		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
+	} TEST_END;
+
+	TEST_BEGIN("exponentiation in GT is correct") {
+		BN_rand_range(k, n);
+		GT_exp_gen(&group, &g, k, ctx);
+		test_scalar(k, n, i);
+		FP12_exp_cyc_gen(&group, &e, &g, k);
+		GT_exp(&group, &f, &g, k, i & 1 ? NULL : ctx);
 		TEST_ASSERT(FP12_cmp(&e, &f) == 0, end);
 	} TEST_END;
 
@@ -631,13 +1585,98 @@ static int pairing(void) {
   end:
   	FP12_free(&e);
   	FP12_free(&f);
+	FP12_free(&g);
+	G2_PRE_free(&t);
+	BN_CTX_free(ctx);
+	BN_free(k);
+	BN_free(n);
 	EC_POINT_clear_free(p);
 	return code;
 }
 
+static int bench1(void) {
+	int code = 0;
+	FP a, b, c, v[16];
+	DV d;
+	int j;
+
+	BENCH_BEGIN("FP_add") {
+		FP_rand(&a);
+		FP_rand(&b);
+		BENCH_ADD(FP_add(&c, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP_mul_unr") {
+		FP_rand(&a);
+		FP_rand(&b);
+		BENCH_ADD(FP_mul_unr(&d, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP_rdc") {
+		FP_rand(&a);
+		FP_rand(&b);
+		FP_mul_unr(&d, &a, &b);
+		BENCH_ADD(FP_rdc(&c, &d));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP_mul") {
+		FP_rand(&a);
+		FP_rand(&b);
+		BENCH_ADD(FP_mul(&c, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP_sqr") {
+		FP_rand(&a);
+		BENCH_ADD(FP_sqr(&c, &a));
+	}
+	BENCH_END;
+
+	FP_select(0);
+
+	BENCH_BEGIN("FP_mul (portable)") {
+		FP_rand(&a);
+		FP_rand(&b);
+		BENCH_ADD(FP_mul(&c, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP_sqr (portable)") {
+		FP_rand(&a);
+		BENCH_ADD(FP_sqr(&c, &a));
+	}
+	BENCH_END;
+
+	FP_select(ARCH_has_adx());
+
+	BENCH_BEGIN("FP_inv") {
+		FP_rand(&a);
+		BENCH_ADD(FP_inv(&c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP_inv_batch (16 elements)") {
+		for (j = 0; j < 16; j++) {
+			FP_rand(&v[j]);
+		}
+		BENCH_ADD(FP_inv_batch(v, v, 16));
+	}
+	BENCH_END;
+
+	code = 1;
+
+  end:
+	return code;
+}
+
 static int bench2(void) {
 	int code = 0;
-	FP2 a, b, c;
+	FP2 a, b, c, v[16];
+	DV2 d;
+	int j;
 
 	FP2_init(&a);
 	FP2_init(&b);
@@ -653,56 +1692,64 @@ static int bench2(void) {
 	BENCH_BEGIN("FP2_mul_unr") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		BENCH_ADD(FP2_mul_unr(&group, &c, &a, &b, group.bn));
+		BENCH_ADD(FP2_mul_unr(&group, &d, &a, &b));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP2_mul_nor") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		BENCH_ADD(FP2_mul_nor(&group, &c, &a, group.bn));
+		BENCH_ADD(FP2_mul_nor(&group, &c, &a));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP2_mul_art") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		BENCH_ADD(FP2_mul_art(&group, &c, &a, group.bn));
+		BENCH_ADD(FP2_mul_art(&group, &c, &a));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP2_rdc") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		FP2_mul_unr(&group, &c, &a, &b, group.bn);
-		BENCH_ADD(FP2_rdc(&group, &c, &c, group.bn));
+		FP2_mul_unr(&group, &d, &a, &b);
+		BENCH_ADD(FP2_rdc(&group, &c, &d));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP2_mul") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		BENCH_ADD(FP2_mul(&group, &c, &a, &b, group.bn));
+		BENCH_ADD(FP2_mul(&group, &c, &a, &b));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP2_mul2") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		BENCH_ADD(FP2_mul2(&group, &c, &a, &b, group.bn));
+		BENCH_ADD(FP2_mul2(&group, &c, &a, &b));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP2_sqr") {
 		FP2_rand(&group, &a);
-		BENCH_ADD(FP2_sqr(&group, &c, &a, group.bn));
+		BENCH_ADD(FP2_sqr(&group, &c, &a));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP2_inv") {
 		FP2_rand(&group, &a);
 		FP2_rand(&group, &b);
-		BENCH_ADD(FP2_inv(&group, &c, &a, group.bn));
+		BENCH_ADD(FP2_inv(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP2_inv_batch (16 elements)") {
+		for (j = 0; j < 16; j++) {
+			FP2_rand(&group, &v[j]);
+		}
+		BENCH_ADD(FP2_inv_batch(&group, v, v, 16));
 	}
 	BENCH_END;
 
@@ -718,6 +1765,7 @@ static int bench2(void) {
 static int bench6(void) {
 	int code = 0;
 	FP6 a, b, c;
+	DV6 d;
 
 	FP6_init(&a);
 	FP6_init(&b);
@@ -733,41 +1781,41 @@ static int bench6(void) {
 	BENCH_BEGIN("FP6_mul_unr") {
 		FP6_rand(&group, &a);
 		FP6_rand(&group, &b);
-		BENCH_ADD(FP6_mul_unr(&group, &c, &a, &b, group.bn));
+		BENCH_ADD(FP6_mul_unr(&group, &d, &a, &b));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP6_rdc") {
 		FP6_rand(&group, &a);
 		FP6_rand(&group, &b);
-		FP6_mul_unr(&group, &c, &a, &b, group.bn);
-		BENCH_ADD(FP6_rdc(&group, &c, &c, group.bn));
+		FP6_mul_unr(&group, &d, &a, &b);
+		BENCH_ADD(FP6_rdc(&group, &c, &d));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP6_mul") {
 		FP6_rand(&group, &a);
 		FP6_rand(&group, &b);
-		BENCH_ADD(FP6_mul(&group, &c, &a, &b, group.bn));
+		BENCH_ADD(FP6_mul(&group, &c, &a, &b));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP6_sqr") {
 		FP6_rand(&group, &a);
-		BENCH_ADD(FP6_sqr(&group, &c, &a, group.bn));
+		BENCH_ADD(FP6_sqr(&group, &c, &a));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP6_sqr2") {
 		FP6_rand(&group, &a);
-		BENCH_ADD(FP6_sqr2(&group, &c, &a, group.bn));
+		BENCH_ADD(FP6_sqr2(&group, &c, &a));
 	}
 	BENCH_END;	
 
 	BENCH_BEGIN("FP6_inv") {
 		FP6_rand(&group, &a);
 		FP6_rand(&group, &b);
-		BENCH_ADD(FP6_inv(&group, &c, &a, group.bn));
+		BENCH_ADD(FP6_inv(&group, &c, &a));
 	}
 	BENCH_END;
 
@@ -782,7 +1830,8 @@ static int bench6(void) {
 
 static int bench12(void) {
 	int code = 0;
-	FP12 a, b, c;
+	FP12 a, b, c, v[16];
+	int j;
 
 	FP12_init(&a);
 	FP12_init(&b);
@@ -798,27 +1847,101 @@ static int bench12(void) {
 	BENCH_BEGIN("FP12_mul") {
 		FP12_rand(&group, &a);
 		FP12_rand(&group, &b);
-		BENCH_ADD(FP12_mul(&group, &c, &a, &b, group.bn));
+		BENCH_ADD(FP12_mul(&group, &c, &a, &b));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP12_mul_dxs") {
 		FP12_rand(&group, &a);
 		FP12_rand(&group, &b);
-		BENCH_ADD(FP12_mul_dxs(&group, &c, &a, &b, group.bn));
+		BENCH_ADD(FP12_mul_dxs(&group, &c, &a, &b));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP12_sqr") {
 		FP12_rand(&group, &a);
-		BENCH_ADD(FP12_sqr(&group, &c, &a, group.bn));
+		BENCH_ADD(FP12_sqr(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_mul_lzr") {
+		FP12_rand(&group, &a);
+		FP12_rand(&group, &b);
+		BENCH_ADD(FP12_mul_lzr(&group, &c, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_mul_dxs_lzr") {
+		FP12_rand(&group, &a);
+		FP12_rand(&group, &b);
+		BENCH_ADD(FP12_mul_dxs_lzr(&group, &c, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_sqr_lzr") {
+		FP12_rand(&group, &a);
+		BENCH_ADD(FP12_sqr_lzr(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_sqr_cyc") {
+		FP12_rand(&group, &a);
+		op_exp_easy(&a, &a);
+		BENCH_ADD(FP12_sqr_cyc(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_sqr_pck") {
+		FP12_rand(&group, &a);
+		op_exp_easy(&a, &a);
+		BENCH_ADD(FP12_sqr_pck(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_mul_dxs_dxs") {
+		FP12_rand(&group, &a);
+		FP12_rand(&group, &b);
+		BENCH_ADD(FP12_mul_dxs_dxs(&group, &c, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_mul_dxd_lzr") {
+		FP12_rand(&group, &a);
+		FP12_rand(&group, &b);
+		BENCH_ADD(FP12_mul_dxd_lzr(&group, &c, &a, &b));
 	}
 	BENCH_END;
 
 	BENCH_BEGIN("FP12_inv") {
 		FP12_rand(&group, &a);
 		FP12_rand(&group, &b);
-		BENCH_ADD(FP12_inv(&group, &c, &a, group.bn));
+		BENCH_ADD(FP12_inv(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_inv_batch (16 elements)") {
+		for (j = 0; j < 16; j++) {
+			FP12_rand(&group, &v[j]);
+		}
+		BENCH_ADD(FP12_inv_batch(&group, v, v, 16));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_frb") {
+		FP12_rand(&group, &a);
+		BENCH_ADD(FP12_frb(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_frb2") {
+		FP12_rand(&group, &a);
+		BENCH_ADD(FP12_frb2(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_frb3") {
+		FP12_rand(&group, &a);
+		BENCH_ADD(FP12_frb3(&group, &c, &a));
 	}
 	BENCH_END;
 
@@ -831,14 +1954,311 @@ static int bench12(void) {
 	return code;	
 }
 
+/* Reports throughput of op_map_batch for a growing number of threads. */
+static int batch(void) {
+	const EC_POINT *g[64];
+	const FP2 *x[64], *y[64];
+	FP12 out[64];
+	struct timespec t0, t1;
+	double s;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, threads;
+
+	/* Workers inherit the affinity of the calling thread. */
+	BENCH_pin(-1);
+
+	for (i = 0; i < 64; i++) {
+		g[i] = EC_GROUP_get0_generator(group.ec);
+		x[i] = group.g2x;
+		y[i] = group.g2y;
+	}
+
+	for (threads = 1; threads == 1 || threads <= cpus; threads *= 2) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		if (!op_map_batch(out, g, x, y, 64, threads)) {
+			return 0;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+		printf("BENCH: op_map_batch (threads = %3d)   = %.1f pairings/s\n", threads, 64 / s);
+	}
+
+	BENCH_pin(0);
+	return 1;
+}
+
+static int bench_g1(void) {
+	int code = 0, j;
+	BN_CTX *ctx = BN_CTX_new();
+	BIGNUM *k = BN_new(), *n = BN_new(), *ks[MSM_BENCH];
+	EC_POINT *a = EC_POINT_new(group.ec), *c = EC_POINT_new(group.ec), *ps[MSM_BENCH];
+
+	EC_GROUP_get_order(group.ec, n, ctx);
+
+	BENCH_BEGIN("EC_POINT_mul") {
+		BN_rand_range(k, n);
+		EC_POINT_mul(group.ec, a, k, NULL, NULL, ctx);
+		BN_rand_range(k, n);
+		BENCH_ADD(EC_POINT_mul(group.ec, c, NULL, a, k, ctx));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G1_mul_glv") {
+		BN_rand_range(k, n);
+		EC_POINT_mul(group.ec, a, k, NULL, NULL, ctx);
+		BN_rand_range(k, n);
+		BENCH_ADD(G1_mul_glv(&group, c, a, k, ctx));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G1_mul_gen") {
+		BN_rand_range(k, n);
+		BENCH_ADD(G1_mul_gen(&group, c, k, ctx));
+	}
+	BENCH_END;
+
+	for (j = 0; j < MSM_BENCH; j++) {
+		ks[j] = BN_new();
+		ps[j] = EC_POINT_new(group.ec);
+		BN_rand_range(k, n);
+		EC_POINT_mul(group.ec, ps[j], k, NULL, NULL, ctx);
+	}
+
+	BENCH_BEGIN("G1_msm (1024 points, 1 thread)") {
+		for (j = 0; j < MSM_BENCH; j++) {
+			BN_rand_range(ks[j], n);
+		}
+		BENCH_ADD(G1_msm(&group, c, (const EC_POINT **)ps, (const BIGNUM **)ks, MSM_BENCH, 1, ctx));
+	}
+	BENCH_END;
+
+	/* Unpin so that the workers can spread over all CPUs, as in batch(). */
+	BENCH_pin(-1);
+	BENCH_BEGIN("G1_msm (1024 points, all threads)") {
+		for (j = 0; j < MSM_BENCH; j++) {
+			BN_rand_range(ks[j], n);
+		}
+		BENCH_ADD(G1_msm(&group, c, (const EC_POINT **)ps, (const BIGNUM **)ks, MSM_BENCH, 0, ctx));
+	}
+	BENCH_END;
+	BENCH_pin(0);
+
+	for (j = 0; j < MSM_BENCH; j++) {
+		BN_free(ks[j]);
+		EC_POINT_free(ps[j]);
+	}
+
+	code = 1;
+
+	EC_POINT_free(a);
+	EC_POINT_free(c);
+	BN_free(k);
+	BN_free(n);
+	BN_CTX_free(ctx);
+	return code;
+}
+
+static int bench_g2(void) {
+	int code = 0, j;
+	BN_CTX *ctx = BN_CTX_new();
+	G2_POINT a, b, c, v[64], *ps;
+	BIGNUM *k = BN_new(), *n = BN_new(), *ks[MSM_BENCH];
+
+	G2_init(&a);
+	G2_init(&b);
+	G2_init(&c);
+	EC_GROUP_get_order(group.ec, n, ctx);
+
+	BENCH_BEGIN("G2_add") {
+		G2_rand(&group, &a, ctx);
+		G2_rand(&group, &b, ctx);
+		BENCH_ADD(G2_add(&group, &c, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G2_add (mixed)") {
+		G2_rand(&group, &a, ctx);
+		G2_rand(&group, &b, ctx);
+		G2_norm(&group, &b, &b);
+		BENCH_ADD(G2_add(&group, &c, &a, &b));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G2_dbl") {
+		G2_rand(&group, &a, ctx);
+		BENCH_ADD(G2_dbl(&group, &c, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G2_norm_sim (64 points)") {
+		for (j = 0; j < 64; j++) {
+			G2_rand(&group, &v[j], ctx);
+		}
+		BENCH_ADD(G2_norm_sim(&group, v, v, 64));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G2_is_in_group") {
+		G2_rand(&group, &a, ctx);
+		BENCH_ADD(G2_is_in_group(&group, &a));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G2_mul") {
+		G2_rand(&group, &a, ctx);
+		BN_rand_range(k, n);
+		BENCH_ADD(G2_mul(&group, &c, &a, k));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G2_mul_gls") {
+		G2_rand(&group, &a, ctx);
+		BN_rand_range(k, n);
+		BENCH_ADD(G2_mul_gls(&group, &c, &a, k, ctx));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("G2_mul_gen") {
+		BN_rand_range(k, n);
+		BENCH_ADD(G2_mul_gen(&group, &c, k, ctx));
+	}
+	BENCH_END;
+
+	ps = OPENSSL_malloc(MSM_BENCH * sizeof(G2_POINT));
+	for (j = 0; j < MSM_BENCH; j++) {
+		ks[j] = BN_new();
+		G2_rand(&group, &ps[j], ctx);
+	}
+
+	BENCH_BEGIN("G2_msm (1024 points, 1 thread)") {
+		for (j = 0; j < MSM_BENCH; j++) {
+			BN_rand_range(ks[j], n);
+		}
+		BENCH_ADD(G2_msm(&group, &c, ps, (const BIGNUM **)ks, MSM_BENCH, 1, ctx));
+	}
+	BENCH_END;
+
+	BENCH_pin(-1);
+	BENCH_BEGIN("G2_msm (1024 points, all threads)") {
+		for (j = 0; j < MSM_BENCH; j++) {
+			BN_rand_range(ks[j], n);
+		}
+		BENCH_ADD(G2_msm(&group, &c, ps, (const BIGNUM **)ks, MSM_BENCH, 0, ctx));
+	}
+	BENCH_END;
+	BENCH_pin(0);
+
+	for (j = 0; j < MSM_BENCH; j++) {
+		BN_free(ks[j]);
+	}
+	OPENSSL_free(ps);
+
+	code = 1;
+
+	G2_free(&a);
+	G2_free(&b);
+	G2_free(&c);
+	BN_free(k);
+	BN_free(n);
+	BN_CTX_free(ctx);
+	return code;
+}
+
 static int bench(void) {
-	int code = 0;
-	FP12 e;
+	unsigned long long n;
+	int i, code = 0;
+	const EC_POINT *g[4];
+	const FP2 *x[4], *y[4];
+	G2_PRE t;
+	BN_CTX *ctx = BN_CTX_new();
+	BIGNUM *k = BN_new();
+	FP12 e, f;
 
 	FP12_init(&e);
+	FP12_init(&f);
+	G2_PRE_init(&t);
 
 	BENCH_BEGIN("op_map") {
-		BENCH_ADD(op_map(&e, EC_GROUP_get0_generator(group.ec), group.g2x, group.g2y););
+		BENCH_ADD(op_map(&e, EC_GROUP_get0_generator(group.ec), group.g2x, group.g2y, ctx););
+	}
+	BENCH_END;
+
+	/* Breakdown of the final exponentiation, on an element of the right shape. */
+	BENCH_BEGIN("op_exp_easy") {
+		FP12_rand(&group, &f);
+		BENCH_ADD(op_exp_easy(&e, &f));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("op_exp_hard") {
+		FP12_rand(&group, &f);
+		op_exp_easy(&f, &f);
+		BENCH_ADD(op_exp_hard(&e, &f));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("op_exp_hard: FP12_exp_cyc") {
+		FP12_rand(&group, &f);
+		op_exp_easy(&f, &f);
+		BENCH_ADD(FP12_exp_cyc(&group, &e, &f));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("FP12_exp_cyc_gen (254 bits)") {
+		BN_rand(k, 254, 0, 0);
+		FP12_rand(&group, &f);
+		op_exp_easy(&f, &f);
+		BENCH_ADD(FP12_exp_cyc_gen(&group, &e, &f, k));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("GT_exp_gen") {
+		BN_rand(k, 254, 0, 0);
+		BENCH_ADD(GT_exp_gen(&group, &e, k, ctx));
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("GT_exp") {
+		BN_rand(k, 254, 0, 0);
+		GT_exp_gen(&group, &f, k, ctx);
+		BN_rand(k, 254, 0, 0);
+		BENCH_ADD(GT_exp(&group, &e, &f, k, ctx));
+	}
+	BENCH_END;
+
+	for (i = 0; i < 4; i++) {
+		g[i] = EC_GROUP_get0_generator(group.ec);
+		x[i] = group.g2x;
+		y[i] = group.g2y;
+	}
+
+	BENCH_BEGIN("op_map_sim (n = 4)") {
+		BENCH_ADD(op_map_sim(&e, g, x, y, 4, ctx););
+	}
+	BENCH_END;
+
+	if (batch() == 0) {
+		goto end;
+	}
+
+	/* Once the context has grown to size, a pairing should not touch the heap. */
+	n = BENCH_allocs();
+	op_map(&e, EC_GROUP_get0_generator(group.ec), group.g2x, group.g2y, ctx);
+	printf("BENCH: %-32s = %llu allocations\n", "op_map", BENCH_allocs() - n);
+	n = BENCH_allocs();
+	op_map_sim(&e, g, x, y, 4, ctx);
+	printf("BENCH: %-32s = %llu allocations\n", "op_map_sim (n = 4)", BENCH_allocs() - n);
+	n = BENCH_allocs();
+	op_map(&e, EC_GROUP_get0_generator(group.ec), group.g2x, group.g2y, NULL);
+	printf("BENCH: %-32s = %llu allocations\n", "op_map (no context)", BENCH_allocs() - n);
+
+	BENCH_BEGIN("op_precompute_g2") {
+		BENCH_ADD(op_precompute_g2(&t, group.g2x, group.g2y););
+	}
+	BENCH_END;
+
+	BENCH_BEGIN("op_map_pre") {
+		BENCH_ADD(op_map_pre(&e, EC_GROUP_get0_generator(group.ec), &t, ctx););
 	}
 	BENCH_END;
 
@@ -846,12 +2266,67 @@ static int bench(void) {
 
   end:
   	FP12_free(&e);
+	FP12_free(&f);
+	G2_PRE_free(&t);
+	BN_free(k);
+	BN_CTX_free(ctx);
 	return code;
 }
 
+/*
+ * Usage: test-bench [--csv FILE | --json FILE] [--compare FILE] [--threshold PCT]
+ *
+ * Records of every benchmark go to FILE, and benchmarks whose median is more
+ * than PCT percent (10 by default) slower than in the baseline FILE are
+ * flagged and make the program exit with a non-zero status.
+ */
 int main(int argc, char *argv[]) {
+	const char *base = NULL;
+	double threshold = 10;
+	int i;
+
+	/* Hook allocations before OpenSSL makes any. */
+	BENCH_alloc_init();
+
+	for (i = 1; i < argc; i++) {
+		if (i + 1 < argc && strcmp(argv[i], "--csv") == 0) {
+			if (!BENCH_output(argv[++i], BENCH_CSV)) {
+				return 1;
+			}
+		} else if (i + 1 < argc && strcmp(argv[i], "--json") == 0) {
+			if (!BENCH_output(argv[++i], BENCH_JSON)) {
+				return 1;
+			}
+		} else if (i + 1 < argc && strcmp(argv[i], "--compare") == 0) {
+			base = argv[++i];
+		} else if (i + 1 < argc && strcmp(argv[i], "--threshold") == 0) {
+			threshold = atof(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--csv FILE | --json FILE] [--compare FILE] [--threshold PCT]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (base != NULL && !BENCH_baseline(base, threshold)) {
+		fprintf(stderr, "cannot read baseline %s\n", base);
+		return 1;
+	}
+
 	op_init();
 
+	printf("\n** Prime field\n\n");
+
+	if (addition1() == 0) {
+		return 0;
+	}
+
+	if (multiplication1() == 0) {
+		return 0;
+	}
+
+	if (conversion1() == 0) {
+		return 0;
+	}
+
 	printf("\n** Quadratic extension\n\n");
 
 	if (addition2() == 0) {
@@ -906,6 +2381,26 @@ int main(int argc, char *argv[]) {
 		return 0;
 	}
 
+	if (frobenius12() == 0) {
+		return 0;
+	}
+
+	if (cyclotomic12() == 0) {
+		return 0;
+	}
+
+	printf("\n** Base curve\n\n");
+
+	if (curve1() == 0) {
+		return 0;
+	}
+
+	printf("\n** Twist curve\n\n");
+
+	if (curve2() == 0) {
+		return 0;
+	}
+
 	printf("\n** Pairing\n\n");
 
 	if (pairing() == 0) {
@@ -914,6 +2409,14 @@ int main(int argc, char *argv[]) {
 
 	printf("\n** Benchmarks\n\n");
 
+	/* Keep the timer on a single core and measure its own cost first. */
+	BENCH_pin(0);
+	BENCH_overhead();
+
+	if (bench1() == 0) {
+		return 0;
+	}
+
 	if (bench2() == 0) {
 		return 0;
 	}
@@ -926,9 +2429,23 @@ int main(int argc, char *argv[]) {
 		return 0;
 	}
 
+	if (bench_g1() == 0) {
+		return 0;
+	}
+
+	if (bench_g2() == 0) {
+		return 0;
+	}
+
 	if (bench() == 0) {
 		return 0;
 	}
 
-	op_free();	
+	op_free();
+
+	if (BENCH_finish() > 0) {
+		printf("\n** Performance regressions against %s\n", base);
+		return 1;
+	}
+	return 0;
 }